@@ -0,0 +1,107 @@
+/*
+  \program topKinFitterCostTable
+
+  \brief   Predicted number of fits per event as a function of the jet and b-tag multiplicity
+
+  Prints for TtSemiLepKinFitProducer and TtFullHadKinFitProducer the number of jet combinations
+  to be fitted per event for each number of jets and of b-tagged jets, as predicted by
+  TopKinFitterCost for a given configuration (maxNJets, useBTagging, bTags). Multiplied with
+  the wall time per fit reported by the producers (parameter 'costReport') it gives the fit
+  time per event, e.g. to size batch slots or to estimate the cost of a looser jet selection.
+  The prediction refers to the full enumeration without pruning or budget.
+
+  usage: topKinFitterCostTable [--maxJets n] [--maxNJets n] [--useBTagging 0|1] [--bTags n]
+                               [--timePerFit ms]
+
+**/
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+
+/// parse a single value
+template <typename T>
+T parse(const std::string& item)
+{
+  std::stringstream value(item);
+  T val;
+  if(!(value >> val))
+    throw std::invalid_argument("cannot parse '"+item+"'");
+  return val;
+}
+
+/// print the predicted fits per event for the given channel
+void printTable(const std::string& label, const bool fullHad, const unsigned int maxJets, const int maxNJets,
+		const bool useBTagging, const unsigned int bTags, const double timePerFit)
+{
+  std::cout << "\n"
+	    << "+++++++++++ Predicted fits per event: " << label << " ++++++++++++ \n"
+	    << "  maxNJets = " << maxNJets << ", useBTagging = " << useBTagging;
+  if(fullHad) std::cout << ", bTags = " << bTags;
+  if(timePerFit>0.) std::cout << ", " << timePerFit << " ms per fit (entries in ms)";
+  std::cout << "\n"
+	    << "  jets \\ b-tags";
+  for(unsigned int nBTags=0; nBTags<=maxJets; ++nBTags)
+    std::cout << std::setw(10) << nBTags;
+  std::cout << "\n";
+  const unsigned int minJets = (fullHad ? TtFullHadTopology::nPartons : TtSemiLepTopology::nPartons);
+  for(unsigned int nJets=minJets; nJets<=maxJets; ++nJets){
+    std::cout << std::setw(14) << nJets;
+    for(unsigned int nBTags=0; nBTags<=maxJets; ++nBTags){
+      if(nBTags>nJets){
+	std::cout << std::setw(10) << "";
+	continue;
+      }
+      const unsigned long nFits = (fullHad ?
+				   TopKinFitterCost::fullHadFits(nJets, nBTags, maxNJets, useBTagging, bTags) :
+				   TopKinFitterCost::semiLepFits(nJets, nBTags, maxNJets, useBTagging));
+      if(timePerFit>0.) std::cout << std::setw(10) << std::setprecision(4) << nFits*timePerFit;
+      else std::cout << std::setw(10) << nFits;
+    }
+    std::cout << "\n";
+  }
+  std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
+
+void usage()
+{
+  std::cerr << "usage: topKinFitterCostTable [--maxJets n] [--maxNJets n] [--useBTagging 0|1] [--bTags n]\n"
+	    << "                             [--timePerFit ms]\n";
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int maxJets     = 10;
+  int          maxNJets    = -1;
+  bool         useBTagging = false;
+  unsigned int bTags       = 2;
+  double       timePerFit  = 0.;
+  try{
+    for(int arg=1; arg<argc; arg+=2){
+      const std::string option = argv[arg];
+      if(arg+1>=argc) throw std::invalid_argument("missing value for option "+option);
+      const std::string value = argv[arg+1];
+      if     (option=="--maxJets"    ) maxJets     = parse<unsigned int>(value);
+      else if(option=="--maxNJets"   ) maxNJets    = parse<int>         (value);
+      else if(option=="--useBTagging") useBTagging = parse<bool>        (value);
+      else if(option=="--bTags"      ) bTags       = parse<unsigned int>(value);
+      else if(option=="--timePerFit" ) timePerFit  = parse<double>      (value);
+      else throw std::invalid_argument("unknown option "+option);
+    }
+    if(bTags>2) throw std::invalid_argument("bTags has to be 0, 1 or 2");
+  }
+  catch(std::exception& e){
+    std::cerr << "ERROR: " << e.what() << "\n";
+    usage();
+    return 1;
+  }
+
+  printTable("TtSemiLepKinFitProducer", false, maxJets, maxNJets, useBTagging, bTags, timePerFit);
+  printTable("TtFullHadKinFitProducer", true , maxJets, maxNJets, useBTagging, bTags, timePerFit);
+  return 0;
+}
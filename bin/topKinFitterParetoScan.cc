@@ -0,0 +1,379 @@
+/*
+  \program topKinFitterParetoScan
+
+  \brief   Scan of the convergence parameters of the kinematic fits
+
+  Replays the fit inputs recorded by the kinematic fit producers (parameter 'fitInputDump')
+  through TtSemiLepKinFitter, TtFullHadKinFitter and StKinFitter for a grid of settings of
+  maxNrIter, maxDeltaS, maxF and the parametrisation. For each setting the throughput is
+  compared to the agreement of the best jet combination and its chi2 with a reference fit
+  with tight convergence criteria. Settings which are not dominated by any other setting
+  in throughput, agreement and chi2 difference are flagged as members of the Pareto front.
+  The constraints, masses, jet energy resolution scale factors and (unless scanned) the
+  parametrisations are the ones recorded with the events; the fits use the default object
+  resolutions, as the configured ones are not recorded.
+
+  usage: topKinFitterParetoScan <records> [--maxNrIter n1,n2,...] [--maxDeltaS d1,d2,...]
+                                [--maxF f1,f2,...] [--param p1,p2,...] [--refParam p]
+                                [--maxEvents n]
+         parametrisation -1 (default) stands for the recorded one
+
+**/
+
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+
+#include "AnalysisDataFormats/TopObjects/interface/TtSemiLepEvtPartons.h"
+#include "AnalysisDataFormats/TopObjects/interface/TtFullHadEvtPartons.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/StKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TtSemiLepKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TtFullHadKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterRecord.h"
+
+/// convergence criteria of the reference fit
+static const int    refMaxNrIter = 5000;
+static const double refMaxDeltaS = 1e-7;
+static const double refMaxF      = 1e-6;
+
+/// settings of the kinematic fit
+struct Setting {
+  int maxNrIter;
+  double maxDeltaS;
+  double maxF;
+  /// parametrisation of all objects (-1 for the recorded ones)
+  int param;
+};
+
+/// best jet combination of an event (empty if no fit converged)
+struct BestFit {
+  std::vector<int> combi;
+  double chi2;
+};
+
+/// performance of a setting w.r.t. the reference
+struct Summary {
+  Setting setting;
+  /// fits per second
+  double throughput;
+  /// fraction of converged fits
+  double converged;
+  /// fraction of events with the same best combination as the reference
+  double agreement;
+  /// mean absolute chi2 difference of the best combination w.r.t. the reference
+  double deltaChi2;
+  /// member of the Pareto front
+  bool pareto;
+};
+
+/// replays the recorded fits of one channel with a given setting
+class Replay {
+
+ public:
+  /// constructor with the setting and a record holding the fitter configuration
+  Replay(const Setting& setting, const TopKinFitterRecord& config);
+  /// destructor
+  ~Replay();
+
+  /// fit a single jet combination and return the fit status
+  int fit(const TopKinFitterRecord& record, const std::vector<int>& combi);
+  /// return chi2 of the last fit
+  double chi2() const;
+
+ private:
+  TopKinFitterRecord::Channel channel_;
+  /// empty resolutions (the default resolutions are used)
+  std::vector<edm::ParameterSet> resolutions_;
+  /// recorded scale factors for the jet energy resolution and their eta binning
+  std::vector<double> scaleFactors_, etaBinning_;
+  /// fitters
+  TtSemiLepKinFitter* semiLep_;
+  TtFullHadKinFitter* fullHad_;
+  StKinFitter* singleTop_;
+};
+
+Replay::Replay(const Setting& setting, const TopKinFitterRecord& config):
+  channel_(config.channel), scaleFactors_(config.jetEnergyResolutionScaleFactors), etaBinning_(config.jetEnergyResolutionEtaBinning),
+  semiLep_(0), fullHad_(0), singleTop_(0)
+{
+  // parametrisations as recorded unless scanned
+  const TopKinFitter::Param jetParam = (TopKinFitter::Param)(setting.param<0 ? config.jetParam : setting.param);
+  const TopKinFitter::Param lepParam = (TopKinFitter::Param)(setting.param<0 ? config.lepParam : setting.param);
+  const TopKinFitter::Param metParam = (TopKinFitter::Param)(setting.param<0 ? config.metParam : setting.param);
+  switch(channel_){
+  case TopKinFitterRecord::kSemiLep :
+    {
+      std::vector<TtSemiLepKinFitter::Constraint> constraints;
+      for(unsigned int idx=0; idx<config.constraints.size(); ++idx)
+	constraints.push_back((TtSemiLepKinFitter::Constraint)config.constraints[idx]);
+      semiLep_ = new TtSemiLepKinFitter(jetParam, lepParam, metParam, setting.maxNrIter, setting.maxDeltaS, setting.maxF,
+					constraints, config.mW, config.mTop, &resolutions_, &resolutions_, &resolutions_, &resolutions_,
+					&scaleFactors_, &etaBinning_, config.fixLepton);
+    }
+    break;
+  case TopKinFitterRecord::kFullHad :
+    {
+      std::vector<TtFullHadKinFitter::Constraint> constraints;
+      for(unsigned int idx=0; idx<config.constraints.size(); ++idx)
+	constraints.push_back((TtFullHadKinFitter::Constraint)config.constraints[idx]);
+      fullHad_ = new TtFullHadKinFitter(jetParam, setting.maxNrIter, setting.maxDeltaS, setting.maxF,
+					constraints, config.mW, config.mTop, &resolutions_, &resolutions_, &scaleFactors_, &etaBinning_);
+    }
+    break;
+  case TopKinFitterRecord::kSingleTop :
+    singleTop_ = new StKinFitter(jetParam, lepParam, metParam, setting.maxNrIter, setting.maxDeltaS, setting.maxF, config.constraints);
+    break;
+  }
+}
+
+Replay::~Replay()
+{
+  delete semiLep_;
+  delete fullHad_;
+  delete singleTop_;
+}
+
+int
+Replay::fit(const TopKinFitterRecord& record, const std::vector<int>& combi)
+{
+  switch(channel_){
+  case TopKinFitterRecord::kSemiLep :
+    return semiLep_->fit(record.jets [combi[TtSemiLepEvtPartons::LightQ   ]], record.jets [combi[TtSemiLepEvtPartons::LightQBar]],
+			 record.bJets[combi[TtSemiLepEvtPartons::HadB     ]], record.bJets[combi[TtSemiLepEvtPartons::LepB     ]],
+			 record.lepton, record.neutrino, record.leptonCharge, record.leptonType);
+  case TopKinFitterRecord::kFullHad :
+    return fullHad_->fit(record.jets [combi[TtFullHadEvtPartons::LightQ   ]], record.jets [combi[TtFullHadEvtPartons::LightQBar]],
+			 record.bJets[combi[TtFullHadEvtPartons::B        ]], record.jets [combi[TtFullHadEvtPartons::LightP   ]],
+			 record.jets [combi[TtFullHadEvtPartons::LightPBar]], record.bJets[combi[TtFullHadEvtPartons::BBar     ]]);
+  case TopKinFitterRecord::kSingleTop :
+    // jet combination given as (bottom, light)
+    return singleTop_->fit(record.bJets[combi[0]], record.jets[combi[1]], record.lepton, record.neutrino, record.leptonType);
+  }
+  return -1;
+}
+
+double
+Replay::chi2() const
+{
+  switch(channel_){
+  case TopKinFitterRecord::kSemiLep   : return semiLep_  ->fitS();
+  case TopKinFitterRecord::kFullHad   : return fullHad_  ->fitS();
+  case TopKinFitterRecord::kSingleTop : return singleTop_->fitS();
+  }
+  return -1.;
+}
+
+/// replay all events of one channel (with the fitter configuration of the first); returns the best combination per event
+std::vector<BestFit> replay(const std::vector<TopKinFitterRecord>& records,
+			    const Setting& setting, double& seconds, unsigned long& nFits, unsigned long& nConverged)
+{
+  Replay fitter(setting, records.front());
+  std::vector<BestFit> best(records.size());
+  seconds = 0.; nFits = 0; nConverged = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(unsigned int evt=0; evt<records.size(); ++evt){
+    for(unsigned int idx=0; idx<records[evt].combis.size(); ++idx){
+      ++nFits;
+      if(fitter.fit(records[evt], records[evt].combis[idx])!=0) continue;
+      ++nConverged;
+      const double chi2 = fitter.chi2();
+      if(best[evt].combi.empty() || chi2<best[evt].chi2){
+	best[evt].combi = records[evt].combis[idx];
+	best[evt].chi2  = chi2;
+      }
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  seconds = elapsed.count();
+  return best;
+}
+
+/// parse a comma separated list of values
+template <typename T>
+std::vector<T> parseList(const std::string& list)
+{
+  std::vector<T> values;
+  std::stringstream stream(list);
+  std::string item;
+  while(std::getline(stream, item, ',')){
+    std::stringstream value(item);
+    T val;
+    if(!(value >> val))
+      throw std::invalid_argument("cannot parse '"+item+"'");
+    values.push_back(val);
+  }
+  return values;
+}
+
+/// check the parametrisation of all objects (-1 for the recorded ones)
+int param(const int val)
+{
+  switch(val){
+  case -1                        :
+  case TopKinFitter::kEMom       :
+  case TopKinFitter::kEtEtaPhi   :
+  case TopKinFitter::kEtThetaPhi : return val;
+  }
+  throw std::invalid_argument("chosen parametrisation is not supported");
+}
+
+/// convert Channel to human readable form
+std::string channelName(const TopKinFitterRecord::Channel channel)
+{
+  switch(channel){
+  case TopKinFitterRecord::kSemiLep   : return "TtSemiLepKinFitter";
+  case TopKinFitterRecord::kFullHad   : return "TtFullHadKinFitter";
+  case TopKinFitterRecord::kSingleTop : return "StKinFitter";
+  }
+  return "";
+}
+
+/// return whether a is dominated by b
+bool dominated(const Summary& a, const Summary& b)
+{
+  if(b.throughput<a.throughput || b.agreement<a.agreement || b.deltaChi2>a.deltaChi2) return false;
+  return (b.throughput>a.throughput || b.agreement>a.agreement || b.deltaChi2<a.deltaChi2);
+}
+
+void usage()
+{
+  std::cerr << "usage: topKinFitterParetoScan <records> [--maxNrIter n1,n2,...] [--maxDeltaS d1,d2,...]\n"
+	    << "                              [--maxF f1,f2,...] [--param p1,p2,...] [--refParam p]\n"
+	    << "                              [--maxEvents n]\n"
+	    << "       parametrisation: -1: recorded (default), 0: EMom, 1: EtEtaPhi, 2: EtThetaPhi\n";
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc<2){
+    usage();
+    return 1;
+  }
+  std::vector<int>      maxNrIter = parseList<int>   ("50,100,200,500");
+  std::vector<double>   maxDeltaS = parseList<double>("5e-4,5e-5,5e-6");
+  std::vector<double>   maxF      = parseList<double>("1e-3,1e-4,1e-5");
+  std::vector<int>      params    = parseList<int>   ("-1");
+  int          refParam  = -1;
+  long         maxEvents = -1;
+  try{
+    for(int arg=2; arg<argc; arg+=2){
+      const std::string option = argv[arg];
+      if(arg+1>=argc) throw std::invalid_argument("missing value for option "+option);
+      const std::string value = argv[arg+1];
+      if     (option=="--maxNrIter") maxNrIter = parseList<int>     (value);
+      else if(option=="--maxDeltaS") maxDeltaS = parseList<double>  (value);
+      else if(option=="--maxF"     ) maxF      = parseList<double>  (value);
+      else if(option=="--param"    ) params    = parseList<int>     (value);
+      else if(option=="--refParam" ) refParam  = parseList<int>     (value).at(0);
+      else if(option=="--maxEvents") maxEvents = parseList<long>    (value).at(0);
+      else throw std::invalid_argument("unknown option "+option);
+    }
+    param(refParam);
+    for(unsigned int idx=0; idx<params.size(); ++idx) param(params[idx]);
+  }
+  catch(std::exception& e){
+    std::cerr << "ERROR: " << e.what() << "\n";
+    usage();
+    return 1;
+  }
+
+  try{
+    // read the records and sort them by channel
+    std::ifstream in(argv[1]);
+    if(!in){
+      std::cerr << "ERROR: cannot open file '" << argv[1] << "'\n";
+      return 1;
+    }
+    std::map<TopKinFitterRecord::Channel, std::vector<TopKinFitterRecord> > records;
+    TopKinFitterRecord record;
+    for(long evt=0; (maxEvents<0 || evt<maxEvents) && record.read(in); ++evt){
+      std::vector<TopKinFitterRecord>& channelRecords = records[record.channel];
+      if(!channelRecords.empty() && !channelRecords.front().sameConfiguration(record))
+	throw std::runtime_error("records of "+channelName(record.channel)+" with different fitter configurations, scan them separately");
+      channelRecords.push_back(record);
+    }
+
+    for(std::map<TopKinFitterRecord::Channel, std::vector<TopKinFitterRecord> >::const_iterator channel = records.begin(); channel != records.end(); ++channel){
+      // reference with tight convergence criteria
+      const Setting reference = { refMaxNrIter, refMaxDeltaS, refMaxF, param(refParam) };
+      double seconds;
+      unsigned long nFits, nConverged;
+      const std::vector<BestFit> refBest = replay(channel->second, reference, seconds, nFits, nConverged);
+
+      // scan the grid
+      std::vector<Summary> summaries;
+      for(unsigned int iParam=0; iParam<params.size(); ++iParam){
+	for(unsigned int iIter=0; iIter<maxNrIter.size(); ++iIter){
+	  for(unsigned int iDeltaS=0; iDeltaS<maxDeltaS.size(); ++iDeltaS){
+	    for(unsigned int iF=0; iF<maxF.size(); ++iF){
+	      Summary summary;
+	      summary.setting.maxNrIter = maxNrIter[iIter];
+	      summary.setting.maxDeltaS = maxDeltaS[iDeltaS];
+	      summary.setting.maxF      = maxF[iF];
+	      summary.setting.param     = param(params[iParam]);
+	      const std::vector<BestFit> best = replay(channel->second, summary.setting, seconds, nFits, nConverged);
+	      unsigned int nRef = 0, nAgree = 0, nBoth = 0;
+	      double sumDeltaChi2 = 0.;
+	      for(unsigned int evt=0; evt<best.size(); ++evt){
+		if(refBest[evt].combi.empty()) continue;
+		++nRef;
+		if(best[evt].combi.empty()) continue;
+		if(best[evt].combi==refBest[evt].combi) ++nAgree;
+		sumDeltaChi2 += std::fabs(best[evt].chi2-refBest[evt].chi2);
+		++nBoth;
+	      }
+	      summary.throughput = (seconds>0. ? nFits/seconds : 0.);
+	      summary.converged  = (nFits>0 ? (double)nConverged/nFits : 0.);
+	      summary.agreement  = (nRef >0 ? (double)nAgree/nRef : 1.);
+	      summary.deltaChi2  = (nBoth>0 ? sumDeltaChi2/nBoth : 0.);
+	      summaries.push_back(summary);
+	    }
+	  }
+	}
+      }
+      // flag the Pareto front
+      for(unsigned int idx=0; idx<summaries.size(); ++idx){
+	summaries[idx].pareto = true;
+	for(unsigned int jdx=0; jdx<summaries.size(); ++jdx)
+	  if(jdx!=idx && dominated(summaries[idx], summaries[jdx])){
+	    summaries[idx].pareto = false;
+	    break;
+	  }
+      }
+
+      std::cout << "\n"
+		<< "+++++++++++ Pareto scan: " << channelName(channel->first) << " ++++++++++++ \n"
+		<< "  Events            : " << channel->second.size() << "\n"
+		<< "  Reference         : param " << refParam << ", maxNrIter " << refMaxNrIter
+		<< ", maxDeltaS " << refMaxDeltaS << ", maxF " << refMaxF << "\n"
+		<< "  param  maxNrIter  maxDeltaS       maxF     fits/s  converged  agreement  <|dchi2|>  pareto \n";
+      for(unsigned int idx=0; idx<summaries.size(); ++idx){
+	const Summary& summary = summaries[idx];
+	std::cout << std::setw(7)  << summary.setting.param
+		  << std::setw(11) << summary.setting.maxNrIter
+		  << std::setw(11) << summary.setting.maxDeltaS
+		  << std::setw(11) << summary.setting.maxF
+		  << std::setw(11) << std::setprecision(4) << summary.throughput
+		  << std::setw(11) << std::setprecision(4) << summary.converged
+		  << std::setw(11) << std::setprecision(4) << summary.agreement
+		  << std::setw(11) << std::setprecision(4) << summary.deltaChi2
+		  << std::setw(8)  << (summary.pareto ? "*" : "") << "\n";
+      }
+      std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+    }
+  }
+  catch(std::exception& e){
+    std::cerr << "ERROR: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -82,6 +82,7 @@ TMatrixD CovarianceMatrix::setupMatrix(const pat::PATObject<T>& object, const To
 {
   // This part is for pat objects with resolutions embedded
   if(object.hasKinResolution()) {
+    TMatrixD CovM2 (2,2); CovM2.Zero();
     TMatrixD CovM3 (3,3); CovM3.Zero();
     TMatrixD CovM4 (4,4); CovM4.Zero();
     TMatrixD* CovM = &CovM3;
@@ -105,6 +106,11 @@ TMatrixD CovarianceMatrix::setupMatrix(const pat::PATObject<T>& object, const To
       CovM3(2,2) = pow(object.resolPhi(resolutionProvider)  , 2);
       CovM = &CovM3;
       break;
+    case TopKinFitter::kEtPhiPz :
+      CovM2(0,0) = pow(object.resolEt(resolutionProvider) , 2);
+      CovM2(1,1) = pow(object.resolPhi(resolutionProvider), 2);
+      CovM = &CovM2;
+      break;
     case TopKinFitter::kEMom :
       CovM4(0,0) = pow(1, 2);
       CovM4(1,1) = pow(1, 2);
@@ -0,0 +1,424 @@
+#ifndef JetCombinationGenerator_h
+#define JetCombinationGenerator_h
+
+#include <vector>
+#include <algorithm>
+
+#include "AnalysisDataFormats/TopObjects/interface/TtSemiLepEvtPartons.h"
+#include "AnalysisDataFormats/TopObjects/interface/TtFullHadEvtPartons.h"
+
+/*
+  \class   JetCombinationGenerator JetCombinationGenerator.h "TopQuarkAnalysis/TopKinFitter/interface/JetCombinationGenerator.h"
+
+  \brief   Enumerates the canonical assignments of jets to the partons of a decay topology
+
+  The topology is given as template parameter. It provides the number of partons and the
+  symmetries of the decay, i.e. the pairs of partons that are indistinguishable in the fit
+  (e.g. the two light quarks from a W decay). Of two assignments that only differ by
+  swapping the jets of such a pair, only the canonical one, with the lower jet index on
+  the first parton of the pair, is generated.
+
+  The assignments come in the order of the former next_combination/next_permutation loop
+  with the symmetry cuts applied: jet subsets in lexicographical order and, within each
+  subset, the jet permutations in lexicographical order. As the canonical permutations of
+  a sorted subset only depend on the relative order of the jets, they are enumerated once
+  for the ranks 0..nPartons-1 and then mapped onto each subset. The subsets themselves are
+  tabulated once per jet count up to MaxTableJets jets (beyond they are computed from their
+  index). Both tables are flat arrays of small integers, such that the assignments have a
+  linear index (subset times number of permutations plus permutation) and the enumeration
+  is a walk through the tables; any index range can be generated on its own.
+
+  Optionally the assignments are restricted by the b-tagging: the jets are flagged up front
+  as b-tagged and/or light, the light partons only get light jets and at least a given number
+  of the b partons get b-tagged jets. Jet subsets that cannot provide such an assignment are
+  skipped as a whole; the order of the remaining assignments is unchanged.
+
+  As an approximate alternative to the enumeration, the assignments can be grown role by
+  role (a W decay pair or a single b quark, as defined by the topology), keeping after each
+  role only a given number of the best partial assignments according to a score (e.g. the
+  mass pulls of the completed W and top candidates): a beam search.
+
+**/
+
+/// semi-leptonic ttbar decay: the two light quarks from the hadronic W are indistinguishable
+struct TtSemiLepTopology {
+  static const unsigned int nPartons = 4;
+  static const unsigned int nBPartons = 2;
+  static const unsigned int nSymmetries = 1;
+  static const unsigned int nRoles = 3;
+  /// roles for the beam search: number of partons assigned after the hadronic W (LightQ,
+  /// LightQBar), the hadronic b and the leptonic b
+  static unsigned int roleEnd(const unsigned int role) {
+    static const unsigned int ends[nRoles] = { 2, 3, 4 };
+    return ends[role];
+  }
+  /// b partons
+  static bool isB(const unsigned int parton) {
+    return (parton==TtSemiLepEvtPartons::HadB || parton==TtSemiLepEvtPartons::LepB);
+  }
+  /// pairs of indistinguishable partons
+  static unsigned int symmetry(const unsigned int i, const unsigned int j) {
+    static const unsigned int pairs[nSymmetries][2] = {
+      { TtSemiLepEvtPartons::LightQ, TtSemiLepEvtPartons::LightQBar }
+    };
+    return pairs[i][j];
+  }
+};
+
+/// dileptonic ttbar decay: the b (0) and the bbar (1) are distinguished by the lepton charges; note that
+/// the pairs come per jet subset, i.e. (0,1), (1,0), (0,2), ..., not ordered by the b jet first
+struct TtFullLepTopology {
+  static const unsigned int nPartons = 2;
+  static const unsigned int nBPartons = 2;
+  static const unsigned int nSymmetries = 0;
+  static const unsigned int nRoles = 2;
+  /// roles for the beam search: number of partons assigned after the b and the bbar
+  static unsigned int roleEnd(const unsigned int role) {
+    return role+1;
+  }
+  /// b partons
+  static bool isB(const unsigned int parton) {
+    return true;
+  }
+  /// pairs of indistinguishable partons (none)
+  static unsigned int symmetry(const unsigned int i, const unsigned int j) {
+    return 0;
+  }
+};
+
+/// fully hadronic ttbar decay: the light quarks of either W and the two decay branches are indistinguishable
+struct TtFullHadTopology {
+  static const unsigned int nPartons = 6;
+  static const unsigned int nBPartons = 2;
+  static const unsigned int nSymmetries = 3;
+  static const unsigned int nRoles = 4;
+  /// roles for the beam search: number of partons assigned after the first W (LightQ,
+  /// LightQBar), the b, the second W (LightP, LightPBar) and the bbar
+  static unsigned int roleEnd(const unsigned int role) {
+    static const unsigned int ends[nRoles] = { 2, 3, 5, 6 };
+    return ends[role];
+  }
+  /// b partons
+  static bool isB(const unsigned int parton) {
+    return (parton==TtFullHadEvtPartons::B || parton==TtFullHadEvtPartons::BBar);
+  }
+  /// pairs of indistinguishable partons
+  static unsigned int symmetry(const unsigned int i, const unsigned int j) {
+    static const unsigned int pairs[nSymmetries][2] = {
+      { TtFullHadEvtPartons::LightQ, TtFullHadEvtPartons::LightQBar },
+      { TtFullHadEvtPartons::LightP, TtFullHadEvtPartons::LightPBar },
+      { TtFullHadEvtPartons::B     , TtFullHadEvtPartons::BBar      }
+    };
+    return pairs[i][j];
+  }
+};
+
+template <class Topology, unsigned int MaxTableJets = 12>
+class JetCombinationGenerator {
+
+ public:
+  /// constructor from the indices of the jets to be considered (in increasing order)
+  explicit JetCombinationGenerator(const std::vector<int>& jets);
+  /// default destructor
+  ~JetCombinationGenerator(){};
+
+  /// restrict the assignments by the b-tagging: the light partons only get jets flagged as light,
+  /// at least minTaggedB of the b partons get jets flagged as b-tagged (flags indexed by jet index)
+  void setBTagging(const std::vector<bool>& bTagged, const std::vector<bool>& light, const unsigned int minTaggedB);
+  /// fill the next canonical jet assignment (indexed by parton); returns false when done
+  bool next(std::vector<int>& combi);
+  /// number of candidate assignments before the b-tagging, i.e. the range of the linear index
+  unsigned long size() const { return size_; };
+  /// fill the candidate assignment with the given linear index; returns whether it is compatible with the b-tagging
+  bool combination(const unsigned long index, std::vector<int>& combi) const;
+  /// return whether the given jet assignment is compatible with the b-tagging
+  bool accept(const std::vector<int>& combi) const;
+  /// return whether the given jet assignment is canonical w.r.t. the symmetries of the topology
+  static bool canonical(const std::vector<int>& combi);
+  /// canonical permutations of the ranks 0..nPartons-1 in lexicographical order (nPartons entries each)
+  static const std::vector<unsigned char>& assignments();
+  /// number of canonical permutations
+  static unsigned int nAssignments() { return assignments().size()/Topology::nPartons; };
+  /// subsets of nPartons of n jet positions in lexicographical order (nPartons entries each, n<=MaxTableJets)
+  static const std::vector<unsigned char>& subsets(const unsigned int n);
+  /// approximate search: grow the assignments role by role, keeping after each role the beamWidth
+  /// best partial ones according to score(combi) (lower is better, unassigned partons are -1); fills
+  /// the completed ones, best first, and returns false if partial assignments were dropped
+  template <class Score>
+  bool beamSearch(const unsigned int beamWidth, const Score& score, std::vector<std::vector<int> >& combis) const;
+
+ private:
+  /// number of subsets of k out of n
+  static unsigned long binomial(const unsigned int n, const unsigned int k);
+  /// fill the positions in jets_ of the jet subset with the given index in lexicographical order
+  void subset(unsigned long index, std::vector<unsigned int>& positions) const;
+  /// return whether the current jet subset allows for an assignment compatible with the b-tagging
+  bool feasible() const;
+
+ private:
+  /// indices of the jets to be considered
+  std::vector<int> jets_;
+  /// positions in jets_ of the current subset
+  std::vector<unsigned int> subset_;
+  /// linear index of the next assignment and number of candidate assignments
+  unsigned long index_;
+  unsigned long size_;
+  /// restrict the assignments by the b-tagging
+  bool useBTagging_;
+  /// jets flagged as b-tagged and as light (indexed by jet index)
+  std::vector<bool> bTagged_;
+  std::vector<bool> light_;
+  /// minimal number of b partons with b-tagged jets
+  unsigned int minTaggedB_;
+};
+
+template <class Topology, unsigned int MaxTableJets>
+JetCombinationGenerator<Topology, MaxTableJets>::JetCombinationGenerator(const std::vector<int>& jets):
+  jets_(jets), subset_(Topology::nPartons), index_(0),
+  size_(binomial(jets.size(), Topology::nPartons)*nAssignments()),
+  useBTagging_(false), minTaggedB_(0)
+{
+}
+
+template <class Topology, unsigned int MaxTableJets>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::canonical(const std::vector<int>& combi)
+{
+  for(unsigned int i=0; i<Topology::nSymmetries; ++i)
+    if( combi[Topology::symmetry(i,0)] > combi[Topology::symmetry(i,1)] ) return false;
+  return true;
+}
+
+template <class Topology, unsigned int MaxTableJets>
+const std::vector<unsigned char>&
+JetCombinationGenerator<Topology, MaxTableJets>::assignments()
+{
+  static const std::vector<unsigned char> table = [](){
+    std::vector<unsigned char> result;
+    std::vector<int> ranks(Topology::nPartons);
+    for(unsigned int i=0; i<ranks.size(); ++i)
+      ranks[i] = i;
+    do{
+      if(canonical(ranks)) result.insert(result.end(), ranks.begin(), ranks.end());
+    }
+    while(std::next_permutation(ranks.begin(), ranks.end()));
+    return result;
+  }();
+  return table;
+}
+
+template <class Topology, unsigned int MaxTableJets>
+const std::vector<unsigned char>&
+JetCombinationGenerator<Topology, MaxTableJets>::subsets(const unsigned int n)
+{
+  static const std::vector<std::vector<unsigned char> > tables = [](){
+    std::vector<std::vector<unsigned char> > result(MaxTableJets+1);
+    const unsigned int k = Topology::nPartons;
+    for(unsigned int nJets=k; nJets<=MaxTableJets; ++nJets){
+      std::vector<unsigned char> positions(k);
+      for(unsigned int i=0; i<k; ++i)
+	positions[i] = i;
+      while(true){
+	result[nJets].insert(result[nJets].end(), positions.begin(), positions.end());
+	// advance the right-most position that can still be increased
+	int i = k-1;
+	while(i>=0 && positions[i]==nJets-k+i) --i;
+	if(i<0) break;
+	++positions[i];
+	for(unsigned int j=i+1; j<k; ++j)
+	  positions[j] = positions[j-1]+1;
+      }
+    }
+    return result;
+  }();
+  return tables[n];
+}
+
+template <class Topology, unsigned int MaxTableJets>
+unsigned long
+JetCombinationGenerator<Topology, MaxTableJets>::binomial(const unsigned int n, const unsigned int k)
+{
+  if(k>n) return 0;
+  unsigned long result = 1;
+  for(unsigned int i=1; i<=k; ++i)
+    result = result*(n-k+i)/i;
+  return result;
+}
+
+template <class Topology, unsigned int MaxTableJets>
+void
+JetCombinationGenerator<Topology, MaxTableJets>::subset(unsigned long index, std::vector<unsigned int>& positions) const
+{
+  const unsigned int k = Topology::nPartons;
+  const unsigned int n = jets_.size();
+  positions.resize(k);
+  if(n<=MaxTableJets){
+    const std::vector<unsigned char>& table = subsets(n);
+    for(unsigned int i=0; i<k; ++i)
+      positions[i] = table[index*k+i];
+    return;
+  }
+  // lexicographical unranking: each position is the lowest one with enough subsets left
+  unsigned int first = 0;
+  for(unsigned int i=0; i<k; ++i){
+    for(unsigned int p=first; ; ++p){
+      const unsigned long count = binomial(n-p-1, k-i-1);
+      if(index<count){
+	positions[i] = p;
+	first = p+1;
+	break;
+      }
+      index -= count;
+    }
+  }
+}
+
+template <class Topology, unsigned int MaxTableJets>
+template <class Score>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::beamSearch(const unsigned int beamWidth, const Score& score, std::vector<std::vector<int> >& combis) const
+{
+  combis.clear();
+  if(jets_.size()<Topology::nPartons || beamWidth==0) return true;
+  // partial assignments with their score; equal scores are ranked by the jet indices,
+  // such that the result is deterministic
+  typedef std::pair<double, std::vector<int> > Candidate;
+  std::vector<Candidate> beam(1, Candidate(0., std::vector<int>(Topology::nPartons, -1)));
+  bool complete = true;
+  unsigned int parton = 0;
+  for(unsigned int role=0; role<Topology::nRoles; ++role){
+    std::vector<Candidate> grown = beam;
+    for(; parton<Topology::roleEnd(role); ++parton){
+      // the second parton of a symmetric pair (always the higher index) only gets jets
+      // above the one of the first, as in the canonical assignments
+      int partner = -1;
+      for(unsigned int i=0; i<Topology::nSymmetries; ++i)
+	if(Topology::symmetry(i,1)==parton) partner = Topology::symmetry(i,0);
+      // b partons still to come after this one
+      unsigned int nBLeft = 0;
+      for(unsigned int i=parton+1; i<Topology::nPartons; ++i)
+	if(Topology::isB(i)) ++nBLeft;
+      std::vector<Candidate> next;
+      for(unsigned int c=0; c<grown.size(); ++c){
+	for(unsigned int j=0; j<jets_.size(); ++j){
+	  std::vector<int> combi = grown[c].second;
+	  const int jet = jets_[j];
+	  if(std::find(combi.begin(), combi.begin()+parton, jet)!=combi.begin()+parton) continue;
+	  if(partner>=0 && jet<combi[partner]) continue;
+	  if(useBTagging_){
+	    if(!Topology::isB(parton) && !light_[jet]) continue;
+	    if(Topology::isB(parton)){
+	      // enough b partons left to reach the required number of b-tagged jets
+	      unsigned int nTaggedB = 0;
+	      for(unsigned int i=0; i<=parton; ++i)
+		if(Topology::isB(i) && bTagged_[i==parton ? jet : combi[i]]) ++nTaggedB;
+	      if(nTaggedB+nBLeft<minTaggedB_) continue;
+	    }
+	  }
+	  combi[parton] = jet;
+	  next.push_back(Candidate(0., combi));
+	}
+      }
+      grown.swap(next);
+    }
+    for(unsigned int c=0; c<grown.size(); ++c)
+      grown[c].first = score(grown[c].second);
+    if(grown.size()>beamWidth){
+      std::partial_sort(grown.begin(), grown.begin()+beamWidth, grown.end());
+      grown.resize(beamWidth);
+      complete = false;
+    }
+    else
+      std::sort(grown.begin(), grown.end());
+    beam.swap(grown);
+  }
+  for(unsigned int c=0; c<beam.size(); ++c)
+    if(accept(beam[c].second)) combis.push_back(beam[c].second);
+  return complete;
+}
+
+template <class Topology, unsigned int MaxTableJets>
+void
+JetCombinationGenerator<Topology, MaxTableJets>::setBTagging(const std::vector<bool>& bTagged, const std::vector<bool>& light, const unsigned int minTaggedB)
+{
+  useBTagging_ = true;
+  bTagged_     = bTagged;
+  light_       = light;
+  minTaggedB_  = minTaggedB;
+}
+
+template <class Topology, unsigned int MaxTableJets>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::accept(const std::vector<int>& combi) const
+{
+  if(!useBTagging_) return true;
+  unsigned int nTaggedB = 0;
+  for(unsigned int i=0; i<Topology::nPartons; ++i){
+    if(Topology::isB(i)){
+      if(bTagged_[combi[i]]) ++nTaggedB;
+    }
+    else if(!light_[combi[i]]) return false;
+  }
+  return (nTaggedB>=minTaggedB_);
+}
+
+template <class Topology, unsigned int MaxTableJets>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::feasible() const
+{
+  if(!useBTagging_) return true;
+  // jets that can only be b (tagged and not light), that can be neither,
+  // and that are tagged; jets that are not light have to go to b partons
+  unsigned int nOnlyB = 0, nNeither = 0, nTagged = 0;
+  for(unsigned int i=0; i<subset_.size(); ++i){
+    const int jet = jets_[subset_[i]];
+    if(bTagged_[jet]) ++nTagged;
+    if(!light_[jet]){
+      if(bTagged_[jet]) ++nOnlyB;
+      else ++nNeither;
+    }
+  }
+  return (nTagged>=minTaggedB_ && nNeither+std::max(nOnlyB, minTaggedB_)<=Topology::nBPartons);
+}
+
+template <class Topology, unsigned int MaxTableJets>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::combination(const unsigned long index, std::vector<int>& combi) const
+{
+  const unsigned int nAssign = nAssignments();
+  std::vector<unsigned int> positions;
+  subset(index/nAssign, positions);
+  const unsigned char* ranks = &assignments()[(index%nAssign)*Topology::nPartons];
+  combi.resize(Topology::nPartons);
+  for(unsigned int i=0; i<Topology::nPartons; ++i)
+    combi[i] = jets_[positions[ranks[i]]];
+  return accept(combi);
+}
+
+template <class Topology, unsigned int MaxTableJets>
+bool
+JetCombinationGenerator<Topology, MaxTableJets>::next(std::vector<int>& combi)
+{
+  const std::vector<unsigned char>& table = assignments();
+  const unsigned int nAssign = nAssignments();
+  combi.resize(Topology::nPartons);
+  while(index_<size_){
+    const unsigned int assignment = index_%nAssign;
+    if(assignment==0){
+      subset(index_/nAssign, subset_);
+      // skip jet subsets without any assignment compatible with the b-tagging
+      if(!feasible()){
+	index_ += nAssign;
+	continue;
+      }
+    }
+    ++index_;
+    const unsigned char* ranks = &table[assignment*Topology::nPartons];
+    for(unsigned int i=0; i<Topology::nPartons; ++i)
+      combi[i] = jets_[subset_[ranks[i]]];
+    if(accept(combi)) return true;
+  }
+  return false;
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "AnalysisDataFormats/TopObjects/interface/StEvtSolution.h"
 
 #include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/CovarianceMatrix.h"
 
 #include "TLorentzVector.h"
 
@@ -27,6 +28,13 @@ class StKinFitter : public TopKinFitter {
     ~StKinFitter();
 
     StEvtSolution addKinFitInfo(StEvtSolution * asol);
+    /// kinematic fit interface for plain 4-vecs
+    int fit(const TLorentzVector& p4Bottom, const TLorentzVector& p4Light, const TLorentzVector& p4Lepton,
+	    const TLorentzVector& p4Neutrino, const CovarianceMatrix::ObjectType leptonType);
+    /// common core of the fit interface
+    int fit(const TLorentzVector& p4Bottom, const TLorentzVector& p4Light, const TLorentzVector& p4Lepton,
+	    const TLorentzVector& p4Neutrino, const TMatrixD& covBottom, const TMatrixD& covLight,
+	    const TMatrixD& covLepton, const TMatrixD& covNeutrino);
 
   private:
 
@@ -39,10 +47,14 @@ class StKinFitter : public TopKinFitter {
     TAbsFitParticle * fitLight_;
     TAbsFitParticle * fitLepton_;
     TAbsFitParticle * fitNeutrino_;
+    // unmeasured neutrino pz (only for the MET parametrisation kEtPhiPz)
+    TAbsFitParticle * fitNeutrinoPz_;
     // the constraints on the fit
     TFitConstraintM  * cons1_;
     TFitConstraintM  * cons2_;
     TFitConstraintM  * cons3_;
+    // object used to construct the covariance matrices for the plain 4-vec interface
+    CovarianceMatrix * covM_;
     // other parameters
     Param jetParam_, lepParam_, metParam_;
     std::vector<int> constraints_;
@@ -0,0 +1,52 @@
+#ifndef TFitConstraintMFixed_h
+#define TFitConstraintMFixed_h
+
+#include "TMatrixD.h"
+#include "TLorentzVector.h"
+
+#include "PhysicsTools/KinFitter/interface/TFitConstraintM.h"
+
+/*
+  \class   TFitConstraintMFixed TFitConstraintMFixed.h "TopQuarkAnalysis/TopKinFitter/interface/TFitConstraintMFixed.h"
+
+  \brief   Mass constraint with additional fixed 4-vectors on either side
+
+  Same as TFitConstraintM, M(particles1 + fixed1) - M(particles2 + fixed2) = mass, where
+  fixed1 and fixed2 are 4-vectors that enter the invariant masses but are no parameters
+  of the fit. Used to keep well measured objects (e.g. the charged lepton) fixed while
+  still using them in the mass constraints.
+
+**/
+
+class TFitConstraintMFixed : public TFitConstraintM {
+
+ public:
+  /// constructor
+  TFitConstraintMFixed(const TString& name, const TString& title, std::vector<TAbsFitParticle*>* particles1,
+		       std::vector<TAbsFitParticle*>* particles2, Double_t mass=0);
+  /// default destructor
+  virtual ~TFitConstraintMFixed(){};
+
+  /// set the fixed 4-vector added to particles1
+  void setFixed1(const TLorentzVector& p4) { fixed1_ = p4; };
+  /// set the fixed 4-vector added to particles2
+  void setFixed2(const TLorentzVector& p4) { fixed2_ = p4; };
+
+  /// derivative of the constraint w.r.t. the parameters of the given particle
+  virtual TMatrixD* getDerivative(TAbsFitParticle* particle);
+  /// value of the constraint for the initial parameters
+  virtual Double_t getInitValue();
+  /// value of the constraint for the current parameters
+  virtual Double_t getCurrentValue();
+
+ private:
+  /// sum of the 4-vectors of the given particles and the fixed 4-vector
+  TLorentzVector sum(const std::vector<TAbsFitParticle*>& particles, const TLorentzVector& fixed, bool initial) const;
+
+ private:
+  /// fixed 4-vectors entering the invariant masses
+  TLorentzVector fixed1_;
+  TLorentzVector fixed2_;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TFitParticleEtPhi_h
+#define TFitParticleEtPhi_h
+
+#include "TMatrixD.h"
+#include "TLorentzVector.h"
+
+#include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
+
+class TFitParticlePz;
+
+/*
+  \class   TFitParticleEtPhi TFitParticleEtPhi.h "TopQuarkAnalysis/TopKinFitter/interface/TFitParticleEtPhi.h"
+
+  \brief   Measured transverse part of a massless particle (neutrino) with parameters Et and phi
+
+  Used together with an unmeasured TFitParticlePz, which carries the longitudinal momentum,
+  to describe the neutrino by the measured transverse energy and azimuthal angle of the MET
+  and a free pz. The 4-vector of this particle is (Et*cos(phi), Et*sin(phi), 0, E) with the
+  full energy E=sqrt(Et^2+pz^2), the 4-vector of the companion is (0, 0, pz, 0), such that
+  the sum of both is the neutrino. Both particles always have to enter the same constraints.
+
+**/
+
+class TFitParticleEtPhi : public TAbsFitParticle {
+
+ public:
+  /// constructor
+  TFitParticleEtPhi(const TString& name, const TString& title, const TLorentzVector* pini, const TMatrixD* theCovMatrix, TFitParticlePz* pz=0);
+  /// default destructor
+  virtual ~TFitParticleEtPhi(){};
+  /// clone the particle
+  virtual TAbsFitParticle* clone(TString newname = "") const;
+
+  /// set the companion particle carrying the longitudinal momentum
+  void setPz(TFitParticlePz* pz) { pz_ = pz; };
+  /// return current transverse energy
+  double et() { return (*getParCurr())(0,0); };
+
+  /// derivative of the 4-vector w.r.t. the parameters (Et, phi)
+  virtual TMatrixD* getDerivative();
+  /// convert a 4-vector to the parameters (Et, phi)
+  virtual TMatrixD* transform(const TLorentzVector& vec);
+  /// set the initial 4-vector
+  virtual void setIni4Vec(const TLorentzVector* pini);
+
+ protected:
+  /// calculate the 4-vector from the parameters
+  virtual TLorentzVector* calc4Vec(const TMatrixD* params);
+
+ private:
+  /// companion particle carrying the longitudinal momentum
+  TFitParticlePz* pz_;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef TFitParticlePz_h
+#define TFitParticlePz_h
+
+#include "TMatrixD.h"
+#include "TLorentzVector.h"
+
+#include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
+
+class TFitParticleEtPhi;
+
+/*
+  \class   TFitParticlePz TFitParticlePz.h "TopQuarkAnalysis/TopKinFitter/interface/TFitParticlePz.h"
+
+  \brief   Unmeasured longitudinal part of a massless particle (neutrino) with parameter pz
+
+  Companion of TFitParticleEtPhi: its 4-vector is (0, 0, pz, 0). The dependence of the
+  energy E=sqrt(Et^2+pz^2) of the neutrino on pz is taken into account in the derivative.
+
+**/
+
+class TFitParticlePz : public TAbsFitParticle {
+
+ public:
+  /// constructor
+  TFitParticlePz(const TString& name, const TString& title, const TLorentzVector* pini, TFitParticleEtPhi* etPhi=0);
+  /// default destructor
+  virtual ~TFitParticlePz(){};
+  /// clone the particle
+  virtual TAbsFitParticle* clone(TString newname = "") const;
+
+  /// set the companion particle carrying the transverse energy
+  void setEtPhi(TFitParticleEtPhi* etPhi) { etPhi_ = etPhi; };
+  /// return current longitudinal momentum
+  double pz() { return (*getParCurr())(0,0); };
+
+  /// derivative of the 4-vector w.r.t. the parameter pz
+  virtual TMatrixD* getDerivative();
+  /// convert a 4-vector to the parameter pz
+  virtual TMatrixD* transform(const TLorentzVector& vec);
+  /// set the initial 4-vector
+  virtual void setIni4Vec(const TLorentzVector* pini);
+
+ protected:
+  /// calculate the 4-vector from the parameters
+  virtual TLorentzVector* calc4Vec(const TMatrixD* params);
+
+ private:
+  /// companion particle carrying the transverse energy
+  TFitParticleEtPhi* etPhi_;
+};
+
+#endif
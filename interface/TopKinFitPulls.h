@@ -0,0 +1,114 @@
+#ifndef TopKinFitPulls_h
+#define TopKinFitPulls_h
+
+#include <vector>
+
+#include "DataFormats/Math/interface/LorentzVector.h"
+#include "DataFormats/Candidate/interface/Candidate.h"
+
+/*
+  \class   TopKinFitPulls TopKinFitPulls.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitPulls.h"
+
+  \brief   Event product with the results of the kinematic fits encoded relative to the input objects
+
+  The fitted objects differ from the measured ones by small corrections. Instead of their
+  4-vectors only the shifts of the parameters log(pt), eta, phi and log(E) with respect to the
+  measured object are stored, quantised to 16 bit (see unit(), well below the
+  resolutions of the fit). The measured object of a role is either the jet assigned to one
+  of the partons of the combination (see the jet index of the role) or, for the lepton and the
+  neutrino, the first object of the lepton and MET collections given to the producer. The
+  fitted 4-vectors are reconstructed from the same input collections (a jet energy correction
+  applied in the fit is part of the stored shift); objects of invalid results are returned as
+  null vectors. The roles are the ones of TopKinFitResults. Chi2, probability, status and
+  constraint residual are kept as columns.
+
+**/
+
+class TopKinFitPulls {
+
+ public:
+  /// encoded parameters of a fitted object
+  enum Parameter { kLogPt, kEta, kPhi, kLogE, kNParameters };
+  /// code marking objects of invalid results
+  static const short kInvalid = -32768;
+
+ public:
+  /// default constructor (for the dictionary)
+  TopKinFitPulls();
+  /// constructor with the position in the jet combination of the jet measuring each role
+  /// (-1 for roles measured by other objects) and the number of jets per combination
+  TopKinFitPulls(const std::vector<int>& roleJets, const unsigned int nJets);
+  /// default destructor
+  ~TopKinFitPulls(){};
+
+  /// add a combination: fitted and measured objects per role (the measured objects of the jet
+  /// roles are the jets of jetCombi), jet indices, chi2, probability, status and constraint residual
+  void push_back(const std::vector<const reco::Candidate*>& fitted, const std::vector<const reco::Candidate*>& measured,
+		 const std::vector<int>& jetCombi, const double chi2, const double prob, const int status, const double residual);
+  /// reserve the space for n combinations
+  void reserve(const unsigned int n);
+
+  /// return the number of combinations
+  unsigned int size() const { return chi2_.size(); };
+  /// return the number of roles per combination
+  unsigned int nRoles() const { return roleJets_.size(); };
+  /// return the number of jets per combination
+  unsigned int nJets() const { return nJets_; };
+  /// return the position in the jet combination of the jet measuring a role (-1 for other objects)
+  int roleJet(const unsigned int role) const { return roleJets_[role]; };
+
+  /// return the fitted 4-vector of a role of combination i given its measured object
+  math::XYZTLorentzVector p4(const unsigned int i, const unsigned int role, const reco::Candidate& measured) const;
+  /// return the fitted 4-vector of a jet role of combination i from the input jets
+  template<typename JetCollection>
+  math::XYZTLorentzVector jetP4(const unsigned int i, const unsigned int role, const JetCollection& jets) const;
+  /// return the stored code of a parameter of a role of combination i
+  short code(const unsigned int i, const unsigned int role, const unsigned int par) const { return codes_[(i*nRoles()+role)*kNParameters+par]; };
+  /// return the index of the jet assigned to parton k in combination i (-1 for invalid results)
+  int jet(const unsigned int i, const unsigned int k) const { return jets_[i*nJets_+k]; };
+  /// return the jet indices of combination i
+  std::vector<int> jetCombi(const unsigned int i) const;
+  /// return the chi2 of combination i
+  double chi2(const unsigned int i) const { return chi2_[i]; };
+  /// return the chi2 probability of combination i
+  double prob(const unsigned int i) const { return prob_[i]; };
+  /// return the fit status of combination i
+  int status(const unsigned int i) const { return status_[i]; };
+  /// return the distance from the constraints of combination i
+  double residual(const unsigned int i) const { return residual_[i]; };
+
+  /// return the quantisation unit of a parameter
+  static double unit(const unsigned int par);
+
+ private:
+  /// quantise the shift of a parameter
+  static short encode(const double shift, const unsigned int par);
+
+ private:
+  /// number of jets per combination
+  unsigned short nJets_;
+  /// position in the jet combination of the jet measuring each role (-1 for other objects)
+  std::vector<short> roleJets_;
+  /// quantised parameter shifts, indexed by (i*nRoles+role)*kNParameters+par
+  std::vector<short> codes_;
+  /// jet indices, indexed by i*nJets+k
+  std::vector<short> jets_;
+  /// chi2, chi2 probability, fit status and constraint residual per combination
+  std::vector<float> chi2_;
+  std::vector<float> prob_;
+  std::vector<short> status_;
+  std::vector<float> residual_;
+};
+
+/// return the fitted 4-vector of a jet role of combination i from the input jets
+template<typename JetCollection>
+math::XYZTLorentzVector
+TopKinFitPulls::jetP4(const unsigned int i, const unsigned int role, const JetCollection& jets) const
+{
+  const int idx = (roleJets_[role]<0 ? -1 : jet(i, roleJets_[role]));
+  if(idx<0 || idx>=(int)jets.size())
+    return math::XYZTLorentzVector();
+  return p4(i, role, static_cast<const reco::Candidate&>(jets[idx]));
+}
+
+#endif
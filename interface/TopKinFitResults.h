@@ -0,0 +1,90 @@
+#ifndef TopKinFitResults_h
+#define TopKinFitResults_h
+
+#include <vector>
+
+#include "DataFormats/Math/interface/LorentzVector.h"
+#include "DataFormats/PatCandidates/interface/Particle.h"
+
+/*
+  \class   TopKinFitResults TopKinFitResults.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitResults.h"
+
+  \brief   Compact event product with the results of the kinematic fits of the jet combinations
+
+  Structure of arrays replacing the separate collections of fitted pat::Particles per role and
+  the jet combination, chi2, probability, status and constraint residual products: the fitted 4-vectors are stored
+  as float columns (px, py, pz, E) indexed by combination and role, the jet indices of the
+  combinations in a flat array indexed by combination and parton. The pat::Particles are built
+  on demand; they only carry the fitted 4-vector, the fitted covariance matrices (parameter
+  exportFitCovariance) are not stored. The order of the roles is given by the producer, see
+  SemiLepRole and FullHadRole; the order of the jet indices is the one of TtSemiLepEvtPartons
+  and TtFullHadEvtPartons respectively. Invalid results (no converged fit) have status -1,
+  chi2, probability and residual -1 and jet indices -1.
+
+**/
+
+class TopKinFitResults {
+
+ public:
+  /// roles of the fitted objects of TtSemiLepKinFitProducer
+  enum SemiLepRole { kHadP, kHadQ, kHadB, kLepB, kLepton, kNeutrino, kNSemiLepRoles };
+  /// roles of the fitted objects of TtFullHadKinFitProducer
+  enum FullHadRole { kB, kBBar, kLightQ, kLightQBar, kLightP, kLightPBar, kNFullHadRoles };
+
+ public:
+  /// default constructor (for the dictionary)
+  TopKinFitResults();
+  /// constructor with the number of roles and of jets per combination
+  TopKinFitResults(const unsigned int nRoles, const unsigned int nJets);
+  /// default destructor
+  ~TopKinFitResults(){};
+
+  /// add a combination: fitted objects per role, jet indices, chi2, probability, status and constraint residual
+  void push_back(const std::vector<const reco::Candidate*>& fitted, const std::vector<int>& jetCombi,
+		 const double chi2, const double prob, const int status, const double residual);
+  /// reserve the space for n combinations
+  void reserve(const unsigned int n);
+
+  /// return the number of combinations
+  unsigned int size() const { return chi2_.size(); };
+  /// return the number of roles per combination
+  unsigned int nRoles() const { return nRoles_; };
+  /// return the number of jets per combination
+  unsigned int nJets() const { return nJets_; };
+
+  /// return the fitted 4-vector of a role of combination i
+  math::XYZTLorentzVector p4(const unsigned int i, const unsigned int role) const;
+  /// return the fitted object of a role of combination i as pat::Particle
+  pat::Particle particle(const unsigned int i, const unsigned int role) const;
+  /// return the fitted objects of a role of all combinations, as the separate collections
+  std::vector<pat::Particle> particles(const unsigned int role) const;
+  /// return the index of the jet assigned to parton k in combination i (-1 for invalid results)
+  int jet(const unsigned int i, const unsigned int k) const { return jets_[i*nJets_+k]; };
+  /// return the jet indices of combination i
+  std::vector<int> jetCombi(const unsigned int i) const;
+  /// return the chi2 of combination i
+  double chi2(const unsigned int i) const { return chi2_[i]; };
+  /// return the chi2 probability of combination i
+  double prob(const unsigned int i) const { return prob_[i]; };
+  /// return the fit status of combination i
+  int status(const unsigned int i) const { return status_[i]; };
+  /// return the distance from the constraints of combination i
+  double residual(const unsigned int i) const { return residual_[i]; };
+
+ private:
+  /// number of roles per combination
+  unsigned short nRoles_;
+  /// number of jets per combination
+  unsigned short nJets_;
+  /// fitted 4-vectors, indexed by i*nRoles+role
+  std::vector<float> px_, py_, pz_, e_;
+  /// jet indices, indexed by i*nJets+k
+  std::vector<short> jets_;
+  /// chi2, chi2 probability, fit status and constraint residual per combination
+  std::vector<float> chi2_;
+  std::vector<float> prob_;
+  std::vector<short> status_;
+  std::vector<float> residual_;
+};
+
+#endif
@@ -1,10 +1,19 @@
 #ifndef TopKinFitter_h
 #define TopKinFitter_h
 
+#include <vector>
+
 #include "TMath.h"
+#include "TLorentzVector.h"
 
 #include "PhysicsTools/KinFitter/interface/TKinFitter.h"
 
+#include "DataFormats/PatCandidates/interface/Particle.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterStats.h"
+
+class TAbsFitParticle;
+
 /*
   \class   TopKinFitter TopKinFitter.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitter.h"
   
@@ -18,8 +27,8 @@ class TopKinFitter {
   
  public:
   
-  /// supported parameterizations
-  enum Param{ kEMom, kEtEtaPhi, kEtThetaPhi };
+  /// supported parameterizations (kEtPhiPz: measured Et and phi with unmeasured pz, for MET only)
+  enum Param{ kEMom, kEtEtaPhi, kEtThetaPhi, kEtPhiPz };
 
  public:
   /// default constructor
@@ -32,20 +41,65 @@ class TopKinFitter {
   double fitS()  const { return fitter_->getS(); };
   /// return number of used iterations
   int fitNrIter() const { return fitter_->getNbIter(); };
+  /// return distance from the constraints (constraint residual)
+  double fitF() const { return fitter_->getF(); };
+  /// return number of degrees of freedom of the fit
+  int fitNDF() const { return fitter_->getNDF(); };
   /// return fit probability
   double fitProb() const { return TMath::Prob(fitter_->getS(), fitter_->getNDF()); };
   /// allows to change the verbosity of the TKinFitter
   void setVerbosity(const int verbosityLevel) { fitter_->setVerbosity(verbosityLevel); };
+  /// return the statistics of all fits performed by this fitter
+  const TopKinFitterStats& fitStats() const { return stats_; };
+  /// mark the end of an event in the fit statistics
+  void endEvent() { stats_.endEvent(); };
+  /// move the fit statistics of another fitter (e.g. of a worker thread) into the ones of this fitter
+  void takeFitStats(TopKinFitter& other) { stats_.merge(other.stats_); other.stats_.reset(); };
+  /// change the maximal number of iterations used for the following fits (at most the configured one)
+  void setMaxNrIter(const int maxNrIter);
+  /// repeat fits that hit a lowered iteration limit with the configured one (for the validation only)
+  void setValidation(const bool validate) { validate_ = validate; };
+  /// return whether the last fit only converged when repeated with the configured iteration limit
+  bool fitRescued() const { return rescued_; };
+  /// return the chi2 of the last fit when repeated with the configured iteration limit (-1 if not repeated)
+  double fitRescuedS() const { return rescuedS_; };
+  /// keep the last state of fits that stopped at the maximal number of iterations (the last
+  /// iterate, not the best one seen: the TKinFitter keeps no history of its iterations)
+  void setKeepUnconverged(const bool keepUnconverged) { keepUnconverged_ = keepUnconverged; };
+  /// switch the filling of the fit statistics on or off (e.g. for repeated fits of already counted combinations)
+  void setFillStats(const bool fillStats) { fillStats_ = fillStats; };
+  /// return whether the last fit yields a result: converged, or stopped at the
+  /// maximal number of iterations (status 1) if such fits are kept
+  bool hasFitResult() const { return fitter_->getStatus()==0 || (keepUnconverged_ && fitter_->getStatus()==1); };
+  /// mass of a sum of 4-vectors and its uncertainty from the relative energy resolutions of the summands
+  static void massResolution(const std::vector<TLorentzVector>& p4s, const std::vector<double>& resolutions, double& mass, double& sigma);
+  /// take over the kinematic resolution (e.g. an embedded fitted covariance matrix) of another particle, if it has one
+  static void copyKinResolution(pat::Particle& particle, const pat::Particle& from);
 
  protected:
   /// convert Param to human readable form
   std::string param(const Param& param) const;
+  /// perform the fit, fill the fit statistics and return the fit status
+  int runFit();
+  /// embed the fitted covariance matrix of a fit particle as kinematic resolution into the
+  /// corresponding fitted pat::Particle (jets and leptons/MET differ for kEMom)
+  void embedCovMatrixFit(pat::Particle& particle, TAbsFitParticle* fitParticle, const Param& param, const bool isJet) const;
   
  protected:
   /// kinematic fitter
   TKinFitter* fitter_;
   /// maximal allowed number of iterations to be used for the fit
   int maxNrIter_;
+  /// maximal number of iterations currently in use (can be lowered w.r.t. maxNrIter_)
+  int nrIterLimit_;
+  /// repeat fits that hit a lowered iteration limit
+  bool validate_;
+  /// last fit converged only when repeated with the configured iteration limit
+  bool rescued_;
+  /// chi2 of the last fit when repeated with the configured iteration limit
+  double rescuedS_;
+  /// keep the last state of fits that stopped at the maximal number of iterations
+  bool keepUnconverged_;
   /// maximal allowed chi2 (not normalized to degrees of freedom)
   double maxDeltaS_;
   /// maximal allowed distance from constraints
@@ -54,6 +108,10 @@ class TopKinFitter {
   double mW_;
   /// top mass value used for constraints
   double mTop_;
+  /// fill the fit statistics
+  bool fillStats_;
+  /// statistics of the performed fits
+  TopKinFitterStats stats_;
 };
 
 #endif
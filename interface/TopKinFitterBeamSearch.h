@@ -0,0 +1,72 @@
+#ifndef TopKinFitterBeamSearch_h
+#define TopKinFitterBeamSearch_h
+
+#include <string>
+#include <ostream>
+
+/*
+  \class   TopKinFitterBeamSearch TopKinFitterBeamSearch.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterBeamSearch.h"
+
+  \brief   Settings and statistics of the approximate search for the best jet assignment
+
+  Instead of fitting all jet combinations, the assignments are grown role by role (see
+  JetCombinationGenerator::beamSearch) and only the completed ones of a beam of given width
+  are fitted. This is approximate: the best combination can be dropped early on the basis
+  of its mass pulls. Events in which partial assignments were dropped are not exhaustive.
+
+  To monitor the search, every n-th event is a validation event: all combinations are fitted,
+  those outside the beam without entering the result, and it is counted how often one of them
+  would have been the best combination.
+
+**/
+
+class TopKinFitterBeamSearch {
+
+ public:
+  /// default constructor (no beam search)
+  TopKinFitterBeamSearch();
+  /// constructor with the width of the beam (0 for the full enumeration) and the validation prescale
+  TopKinFitterBeamSearch(const unsigned int beamWidth, const unsigned int validationPrescale);
+  /// default destructor
+  ~TopKinFitterBeamSearch(){};
+
+  /// to be called at the beginning of each event
+  void beginEvent();
+  /// return whether the beam search is used
+  bool enabled() const { return beamWidth_>0; };
+  /// return the width of the beam
+  unsigned int beamWidth() const { return beamWidth_; };
+  /// return whether the current event is a validation event
+  bool validateEvent() const { return validate_; };
+  /// add an event searched with the beam: whether partial assignments were dropped
+  void fill(const bool truncated);
+  /// add the outcome of a validation event: whether there was a converged fit and whether the best one was outside the beam
+  void fillValidation(const bool converged, const bool bestLost);
+  /// add the counters of the report of another stream; the configuration is taken from it
+  void merge(const TopKinFitterBeamSearch& other);
+
+  /// report the searched events and the validation
+  void print(std::ostream& out, const std::string& label) const;
+
+ private:
+  /// width of the beam (0 for the full enumeration)
+  unsigned int beamWidth_;
+  /// every n-th event is used for validation (0 for none)
+  unsigned int validationPrescale_;
+  /// number of events
+  unsigned long nEvents_;
+  /// current event is a validation event
+  bool validate_;
+  /// number of events searched with the beam
+  unsigned long nSearched_;
+  /// number of events in which partial assignments were dropped
+  unsigned long nTruncated_;
+  /// number of validation events
+  unsigned long nValidated_;
+  /// number of validation events with a converged fit
+  unsigned long nConverged_;
+  /// number of validation events in which the best combination was outside the beam
+  unsigned long nLost_;
+};
+
+#endif
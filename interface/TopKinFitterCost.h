@@ -0,0 +1,105 @@
+#ifndef TopKinFitterCost_h
+#define TopKinFitterCost_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/JetCombinationGenerator.h"
+
+/*
+  \class   TopKinFitterCost TopKinFitterCost.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+
+  \brief   Prediction of the number of fits per event and its comparison with the actual cost
+
+  The number of jet combinations to be fitted follows from the number of jets, their b-tagging
+  and the configuration of the producer before any fit is done: it is the number of assignments
+  of the JetCombinationGenerator (or of the valid matches with useOnlyMatch). The static
+  functions predict it either for a given event or, for capacity planning, from the number of
+  jets and b-tagged jets only (the b-tagged jets are taken as not light, all others as light).
+
+  The prediction refers to the full enumeration: the factorised fits, the chi2 bounds, the W
+  pull cut, the beam search and the budget make the actual number of fits differ from it. To
+  quantify this, the predicted and the actual number of fits and the fit time of every event
+  can be accumulated and are printed at the end of the job per predicted number of fits.
+
+**/
+
+class TopKinFitterCost {
+
+ public:
+  /// default constructor (no report)
+  TopKinFitterCost();
+  /// constructor with the switch for the report
+  explicit TopKinFitterCost(const bool enabled);
+  /// default destructor
+  ~TopKinFitterCost(){};
+
+  /// number of jet assignments a generator (with its b-tagging set up) yields, without fitting
+  template <class Generator>
+  static unsigned long nCombinations(Generator combinations);
+  /// number of jet assignments for nJets jets of which nBTags are b-tagged (not light, all others light),
+  /// with at least minTaggedB b partons on b-tagged jets (0: no b-tagging)
+  template <class Topology>
+  static unsigned long nCombinations(const unsigned int nJets, const unsigned int nBTags, const unsigned int minTaggedB);
+  /// predicted number of fits of TtSemiLepKinFitProducer for nJets jets of which nBTags are b-tagged
+  static unsigned long semiLepFits(const unsigned int nJets, const unsigned int nBTags, const int maxNJets, const bool useBTagging,
+				   const bool useOnlyMatch=false, const unsigned int nMatches=1);
+  /// predicted number of fits of TtFullHadKinFitProducer for nJets jets of which nBTags are b-tagged
+  static unsigned long fullHadFits(const unsigned int nJets, const unsigned int nBTags, const int maxNJets, const bool useBTagging,
+				   const unsigned int bTags, const bool useOnlyMatch=false, const unsigned int nMatches=1);
+
+  /// return whether the report is filled
+  bool enabled() const { return enabled_; };
+  /// add an event: predicted number of fits, actual number of fits and their wall time in seconds
+  void fill(const unsigned long predicted, const unsigned long actual, const double seconds);
+  /// add the counters of the report of another stream; the configuration is taken from it
+  void merge(const TopKinFitterCost& other);
+  /// report the actual number of fits and the fit time per predicted number of fits
+  void print(std::ostream& out, const std::string& label) const;
+
+ private:
+  /// accumulated events with the same predicted number of fits
+  struct Bin {
+    unsigned long nEvents;
+    unsigned long nFits;
+    unsigned long maxFits;
+    double time;
+  };
+
+ private:
+  /// fill the report
+  bool enabled_;
+  /// events per predicted number of fits
+  std::map<unsigned long, Bin> bins_;
+};
+
+template <class Generator>
+unsigned long
+TopKinFitterCost::nCombinations(Generator combinations)
+{
+  unsigned long n = 0;
+  std::vector<int> combi;
+  while(combinations.next(combi)) ++n;
+  return n;
+}
+
+template <class Topology>
+unsigned long
+TopKinFitterCost::nCombinations(const unsigned int nJets, const unsigned int nBTags, const unsigned int minTaggedB)
+{
+  // the number only depends on how many jets are b-tagged, not on which ones
+  std::vector<int> jets;
+  std::vector<bool> bTagged, light;
+  for(unsigned int i=0; i<nJets; ++i){
+    jets.push_back(i);
+    bTagged.push_back(i<nBTags);
+    light  .push_back(i>=nBTags);
+  }
+  JetCombinationGenerator<Topology> combinations(jets);
+  if(minTaggedB>0) combinations.setBTagging(bTagged, light, minTaggedB);
+  return nCombinations(combinations);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef TopKinFitterGlobalCache_h
+#define TopKinFitterGlobalCache_h
+
+#include <string>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJobSummary.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterOffloadQueue.h"
+
+/*
+  \class   TopKinFitterGlobalCache TopKinFitterGlobalCache.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterGlobalCache.h"
+
+  \brief   Objects shared by the streams of a kinematic fit producer
+
+  Holds the end-of-job summary of the fits of all streams and the dedicated threads to which
+  the streams hand the fits of events with large combinatorics.
+
+**/
+
+struct TopKinFitterGlobalCache {
+
+  /// constructor with the file for the fit statistics in JSON format and the number of dedicated threads
+  TopKinFitterGlobalCache(const std::string& fitStatsJSON, const unsigned int offloadThreads):
+    summary(fitStatsJSON), offload(offloadThreads) {};
+
+  /// end-of-job summary of the fits of all streams
+  TopKinFitterJobSummary summary;
+  /// dedicated threads for the fits of events with large combinatorics
+  mutable TopKinFitterOffloadQueue offload;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TopKinFitterJetPreselection_h
+#define TopKinFitterJetPreselection_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "DataFormats/PatCandidates/interface/Jet.h"
+
+/*
+  \class   TopKinFitterJetPreselection TopKinFitterJetPreselection.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJetPreselection.h"
+
+  \brief   Choice of the jets considered in the jet combinatorics (maxNJets window)
+
+  Without preselection the first maxNJets jets of the (pt-ordered) input collection are
+  considered. With preselection the jets are ranked by the sum of their rank in pt and
+  their rank in the b-tag discriminator, the latter scaled by a configurable weight, and
+  the maxNJets best ranked jets are considered. Independent of the ranking, the window is
+  guaranteed to contain the required number of b-tagged jets, as far as the event has as
+  many. The considered jets are returned in the order of the input collection.
+
+  The statistics count the events in which the window differs from the first maxNJets jets
+  and those in which b-tagged jets outside the ranking had to be kept.
+
+**/
+
+class TopKinFitterJetPreselection {
+
+ public:
+  /// default constructor (first maxNJets jets)
+  TopKinFitterJetPreselection();
+  /// constructor with the switch for the preselection and the weight of the rank in the b-tag discriminator
+  TopKinFitterJetPreselection(const bool enabled, const double bTagWeight);
+  /// default destructor
+  ~TopKinFitterJetPreselection(){};
+
+  /// return whether the jets are preselected
+  bool enabled() const { return enabled_; };
+  /// fill the indices of the jets to be considered: all jets if maxNJets<minNJets or if there are
+  /// not more jets than maxNJets, otherwise maxNJets jets with at least nBTags b-tagged ones
+  /// (b-tag discriminator bTagAlgo at least minBTagValueBJet)
+  void select(const std::vector<pat::Jet>& jets, const int maxNJets, const unsigned int minNJets,
+	      const unsigned int nBTags, const std::string& bTagAlgo, const double minBTagValueBJet,
+	      std::vector<int>& indices);
+  /// add the counters of the report of another stream; the configuration is taken from it
+  void merge(const TopKinFitterJetPreselection& other);
+
+  /// report the events with a changed window
+  void print(std::ostream& out, const std::string& label) const;
+
+ private:
+  /// preselect the jets
+  bool enabled_;
+  /// weight of the rank in the b-tag discriminator w.r.t. the rank in pt
+  double bTagWeight_;
+  /// number of events with more jets than maxNJets
+  unsigned long nTruncated_;
+  /// number of events in which the window differs from the first maxNJets jets
+  unsigned long nChanged_;
+  /// number of events in which b-tagged jets had to be kept
+  unsigned long nKept_;
+};
+
+#endif
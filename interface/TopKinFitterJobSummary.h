@@ -0,0 +1,77 @@
+#ifndef TopKinFitterJobSummary_h
+#define TopKinFitterJobSummary_h
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <ostream>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterStats.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterPruning.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterBeamSearch.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJetPreselection.h"
+
+/*
+  \class   TopKinFitterJobSummary TopKinFitterJobSummary.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJobSummary.h"
+
+  \brief   End-of-job summary of the kinematic fits shared by the streams of a producer
+
+  In multithreaded jobs every stream has its own instance of a producer with its own fitters,
+  so the fits of different streams run concurrently without sharing any state. At the end of
+  each stream its fit statistics and its pruning, beam search, cost and preselection reports
+  are merged into the summary, while the remaining reports (e.g. the adaptive limit, which
+  each stream tunes on its own) are added as they are; at the end of the job the merged
+  statistics and reports are printed as one table each, followed by the reports of the
+  streams, and the fit statistics are written in JSON format if requested. The summary also numbers the streams, e.g. to give every stream
+  its own file for the fit inputs. All members are safe to be called from several streams.
+
+**/
+
+class TopKinFitterJobSummary {
+
+ public:
+  /// constructor with the file to write the merged fit statistics to in JSON format (empty for none)
+  explicit TopKinFitterJobSummary(const std::string& fitStatsJSON);
+  /// default destructor
+  ~TopKinFitterJobSummary(){};
+
+  /// return a new stream index (0 for the first stream)
+  unsigned int newStream() const { return nStreams_++; };
+  /// name of the file of a stream derived from a common file name (the name itself for the first stream)
+  static std::string streamFileName(const std::string& fileName, const unsigned int stream);
+  /// add the fit statistics, the reports to be merged and the remaining reports of a stream (as given by newStream) at its end
+  void add(const unsigned int stream, const TopKinFitterStats& stats, const TopKinFitterPruning& pruning,
+	   const TopKinFitterBeamSearch& beamSearch, const TopKinFitterCost& cost,
+	   const TopKinFitterJetPreselection& preselection, const std::string& reports) const;
+
+  /// print the merged fit statistics and reports, followed by the remaining reports of all streams
+  void print(std::ostream& out, const std::string& label) const;
+  /// write the merged fit statistics in JSON format, return false if the file cannot be opened
+  bool printJSON(const std::string& label) const;
+  /// return the file to write the merged fit statistics to in JSON format
+  const std::string& fitStatsJSON() const { return fitStatsJSON_; };
+
+ private:
+  /// file to write the merged fit statistics to in JSON format (empty for none)
+  std::string fitStatsJSON_;
+  /// number of streams
+  mutable std::atomic<unsigned int> nStreams_;
+  /// protects the merged statistics and the reports
+  mutable std::mutex mutex_;
+  /// fit statistics merged over the streams
+  mutable TopKinFitterStats stats_;
+  /// pruning report merged over the streams
+  mutable TopKinFitterPruning pruning_;
+  /// beam search report merged over the streams
+  mutable TopKinFitterBeamSearch beamSearch_;
+  /// cost report merged over the streams
+  mutable TopKinFitterCost cost_;
+  /// preselection report merged over the streams
+  mutable TopKinFitterJetPreselection preselection_;
+  /// remaining reports of the streams, by stream index
+  mutable std::map<unsigned int, std::string> reports_;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TopKinFitterOffloadQueue_h
+#define TopKinFitterOffloadQueue_h
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+/*
+  \class   TopKinFitterOffloadQueue TopKinFitterOffloadQueue.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterOffloadQueue.h"
+
+  \brief   Dedicated threads for the fits of events with large combinatorics
+
+  Tasks pushed to the queue are run in the order of their arrival by a fixed set of threads,
+  started once and waiting for work in between, such that the calling thread is free for
+  other work. The producers push the fits of an event from their acquire step (external work)
+  and signal the framework from within the task when it is done; the tasks are therefore
+  expected to handle their exceptions themselves. The destructor runs the remaining tasks
+  before the threads are joined. Without threads the queue is disabled.
+
+**/
+
+class TopKinFitterOffloadQueue {
+
+ public:
+  /// task to be run on one of the threads
+  typedef std::function<void ()> Task;
+
+ public:
+  /// constructor with the number of threads (0 for none)
+  explicit TopKinFitterOffloadQueue(const unsigned int nThreads=0);
+  /// default destructor; runs the remaining tasks, stops and joins the threads
+  ~TopKinFitterOffloadQueue();
+
+  /// return whether there are threads to run tasks
+  bool enabled() const { return !threads_.empty(); };
+  /// return the number of threads
+  unsigned int nThreads() const { return threads_.size(); };
+  /// add a task to be run by the next free thread
+  void push(const Task& task);
+
+ private:
+  /// not to be copied
+  TopKinFitterOffloadQueue(const TopKinFitterOffloadQueue&);
+  TopKinFitterOffloadQueue& operator=(const TopKinFitterOffloadQueue&);
+  /// main loop of the threads
+  void loop();
+
+ private:
+  /// threads running the tasks
+  std::vector<std::thread> threads_;
+  /// protects the members below
+  std::mutex mutex_;
+  /// signals new tasks or the end to the threads
+  std::condition_variable wake_;
+  /// tasks waiting for a thread
+  std::deque<Task> tasks_;
+  /// threads are to be stopped once no task is left
+  bool stop_;
+};
+
+#endif
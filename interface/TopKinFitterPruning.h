@@ -0,0 +1,74 @@
+#ifndef TopKinFitterPruning_h
+#define TopKinFitterPruning_h
+
+#include <string>
+#include <ostream>
+
+/*
+  \class   TopKinFitterPruning TopKinFitterPruning.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterPruning.h"
+
+  \brief   Cut on the W candidates of the jet combinations and statistics of the pruned combinations
+
+  Jet combinations with a W candidate whose dijet mass is further than a given number of
+  standard deviations (pull) away from the W mass are not fitted. The statistics count the
+  combinations removed by this cut and those skipped because a lower bound on their chi2
+  already excluded them from the best ones.
+
+  To monitor the cut, every n-th event is a validation event: the combinations failing the
+  cut are fitted as well, without entering the result, and it is counted how often one of
+  them would have been the best combination.
+
+**/
+
+class TopKinFitterPruning {
+
+ public:
+  /// default constructor (no cut)
+  TopKinFitterPruning();
+  /// constructor with the maximal pull of the W candidates (0 for no cut) and the validation prescale
+  TopKinFitterPruning(const double maxWPull, const unsigned int validationPrescale);
+  /// default destructor
+  ~TopKinFitterPruning(){};
+
+  /// to be called at the beginning of each event
+  void beginEvent();
+  /// return whether the cut on the W candidates is applied
+  bool enabled() const { return maxWPull_>0.; };
+  /// return the maximal pull of the W candidates
+  double maxWPull() const { return maxWPull_; };
+  /// return whether the current event is a validation event
+  bool validateEvent() const { return validate_; };
+  /// add the number of combinations of an event, of those failing the cut and of those skipped by their chi2 bound
+  void fill(const unsigned int nCombis, const unsigned int nCut, const unsigned int nBounded);
+  /// add the outcome of a validation event: whether there was a converged fit and whether the best one failed the cut
+  void fillValidation(const bool converged, const bool bestCut);
+  /// add the counters of the report of another stream; the configuration is taken from it
+  void merge(const TopKinFitterPruning& other);
+
+  /// report the pruned combinations and the validation
+  void print(std::ostream& out, const std::string& label) const;
+
+ private:
+  /// maximal pull of the W candidates (0 for no cut)
+  double maxWPull_;
+  /// every n-th event is used for validation (0 for none)
+  unsigned int validationPrescale_;
+  /// number of events
+  unsigned long nEvents_;
+  /// current event is a validation event
+  bool validate_;
+  /// number of jet combinations
+  unsigned long nCombis_;
+  /// number of jet combinations failing the cut
+  unsigned long nCut_;
+  /// number of jet combinations skipped by their chi2 bound
+  unsigned long nBounded_;
+  /// number of validation events
+  unsigned long nValidated_;
+  /// number of validation events with a converged fit
+  unsigned long nConverged_;
+  /// number of validation events in which the best combination failed the cut
+  unsigned long nLost_;
+};
+
+#endif
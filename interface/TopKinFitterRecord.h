@@ -0,0 +1,79 @@
+#ifndef TopKinFitterRecord_h
+#define TopKinFitterRecord_h
+
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "TLorentzVector.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/CovarianceMatrix.h"
+
+/*
+  \class   TopKinFitterRecord TopKinFitterRecord.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterRecord.h"
+
+  \brief   Recorded inputs of the kinematic fits of one event
+
+  Holds the 4-vectors that entered the kinematic fits of one event together with the jet
+  combinations that were fitted, such that the fits can be replayed outside of the framework
+  (e.g. by the topKinFitterParetoScan tool to scan the convergence parameters). Two 4-vectors
+  are kept per jet, as used for the light quark and for the b quark roles, since the jet
+  corrections may depend on the role. The configuration of the fitter (parametrisations,
+  constraints, masses and jet energy resolution scale factors) is recorded with each event;
+  the object resolutions are not, the replay uses the default ones. The records are written
+  to and read from a plain text format with one block per event.
+
+**/
+
+class TopKinFitterRecord {
+
+ public:
+  /// supported decay channels
+  enum Channel{ kSemiLep, kFullHad, kSingleTop };
+
+ public:
+  /// default constructor
+  TopKinFitterRecord();
+  /// constructor for a given channel
+  explicit TopKinFitterRecord(const Channel channel);
+  /// default destructor
+  ~TopKinFitterRecord(){};
+
+  /// write record to a stream
+  void write(std::ostream& out) const;
+  /// read the next record from a stream; returns false if no further record is found
+  bool read(std::istream& in);
+  /// return whether the fitter configuration agrees with the one of another record
+  bool sameConfiguration(const TopKinFitterRecord& other) const;
+
+ public:
+  /// decay channel the fits belong to
+  Channel channel;
+  /// parametrisations of jets, lepton and MET (TopKinFitter::Param)
+  int jetParam, lepParam, metParam;
+  /// lepton kept fixed in the fit (semi-leptonic channel only)
+  bool fixLepton;
+  /// constraints as configured in the producer (Constraint of the fitter of the channel)
+  std::vector<int> constraints;
+  /// W and top mass used in the constraints
+  double mW, mTop;
+  /// scale factors for the jet energy resolution and their eta binning
+  std::vector<double> jetEnergyResolutionScaleFactors;
+  std::vector<double> jetEnergyResolutionEtaBinning;
+  /// jets as used for the light quark roles
+  std::vector<TLorentzVector> jets;
+  /// jets as used for the b quark roles
+  std::vector<TLorentzVector> bJets;
+  /// lepton (semi-leptonic and single top channel only)
+  TLorentzVector lepton;
+  /// lepton charge
+  int leptonCharge;
+  /// lepton type
+  CovarianceMatrix::ObjectType leptonType;
+  /// neutrino as used as input to the fit
+  TLorentzVector neutrino;
+  /// fitted jet combinations (indices in the order of the partons of the channel)
+  std::vector<std::vector<int> > combis;
+};
+
+#endif
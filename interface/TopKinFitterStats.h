@@ -0,0 +1,83 @@
+#ifndef TopKinFitterStats_h
+#define TopKinFitterStats_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+/*
+  \class   TopKinFitterStats TopKinFitterStats.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterStats.h"
+
+  \brief   Counters to monitor the performance of the kinematic fits of a TopKinFitter
+
+  Accumulates the number of fits, the distribution of the number of iterations per fit
+  split by fit status (converged, maximal number of iterations reached, diverged), the
+  wall time spent per fit and the number of fits per event. Every fitter keeps its own
+  set of counters; the counters of several fitters (e.g. one per thread) can be merged
+  and are printed at the end of the job either as a table or in JSON format.
+
+**/
+
+class TopKinFitterStats {
+
+ public:
+  /// classification of the status returned by the TKinFitter
+  enum StatusType{ kConverged, kMaxIterations, kDiverged, kNStatusTypes };
+
+ public:
+  /// default constructor
+  TopKinFitterStats();
+  /// default destructor
+  ~TopKinFitterStats(){};
+
+  /// add the result of a single fit
+  void fill(const int status, const int nrIter, const double seconds);
+  /// close the current event and fill the number of fits per event
+  void endEvent();
+  /// add the counters of another instance to this one, including the fits of its current event
+  void merge(const TopKinFitterStats& other);
+  /// reset all counters
+  void reset();
+
+  /// return number of processed events
+  unsigned long nEvents() const { return nEvents_; };
+  /// return number of fits
+  unsigned long nFits() const;
+  /// return number of fits of a given status type
+  unsigned long nFits(const StatusType type) const { return nFits_[type]; };
+  /// return wall time spent in the fits in seconds
+  double time() const;
+  /// return the q-quantile (0<=q<=1) of the number of iterations for fits of a given status type
+  int nrIterQuantile(const double q, const StatusType type=kConverged) const;
+
+  /// print counters as human readable table
+  void print(std::ostream& out, const std::string& label) const;
+  /// print counters in JSON format
+  void printJSON(std::ostream& out, const std::string& label) const;
+
+  /// convert TKinFitter status to StatusType
+  static StatusType statusType(const int status);
+
+ private:
+  /// convert StatusType to human readable form
+  static std::string statusName(const StatusType type);
+
+ private:
+  /// number of fits per status type
+  unsigned long nFits_[kNStatusTypes];
+  /// distribution of the number of iterations per status type (unit bins)
+  std::vector<unsigned long> nrIter_[kNStatusTypes];
+  /// summed wall time of the fits per status type
+  double time_[kNStatusTypes];
+  /// longest fit
+  double maxTime_;
+  /// distribution of the number of fits per event
+  std::map<unsigned long, unsigned long> fitsPerEvent_;
+  /// number of fits in the current event
+  unsigned long fitsInEvent_;
+  /// number of processed events
+  unsigned long nEvents_;
+};
+
+#endif
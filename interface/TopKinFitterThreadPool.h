@@ -0,0 +1,80 @@
+#ifndef TopKinFitterThreadPool_h
+#define TopKinFitterThreadPool_h
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+/*
+  \class   TopKinFitterThreadPool TopKinFitterThreadPool.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterThreadPool.h"
+
+  \brief   Fixed set of threads to distribute the fits of the jet combinations of an event
+
+  The pool consists of the calling thread (worker 0) and nThreads-1 threads that are started
+  once and wait for work in between. run() calls a given function for the indices 0..n-1,
+  handed out one by one to the next free worker, and returns when all of them are done.
+  The function gets the number of the worker, such that each worker can use its own fit
+  context; the results are to be stored by index, which keeps them in enumeration order
+  independent of the number of threads. The first exception thrown by the function stops
+  the distribution of further indices and is rethrown by run(). With a single thread, or
+  if run() is asked to run serially, the function is simply called in a loop by worker 0;
+  this is meant for work whose outcome depends on the order in which the indices are
+  processed (pruning against the results so far, a time budget).
+
+**/
+
+class TopKinFitterThreadPool {
+
+ public:
+  /// function to be called for each index: (worker, index)
+  typedef std::function<void (const unsigned int, const unsigned int)> Work;
+
+ public:
+  /// constructor with the total number of threads including the calling one (0 is treated as 1)
+  explicit TopKinFitterThreadPool(const unsigned int nThreads=1);
+  /// default destructor; stops and joins the threads
+  ~TopKinFitterThreadPool();
+
+  /// return the total number of threads including the calling one
+  unsigned int nThreads() const { return threads_.size()+1; };
+  /// call work(worker, index) for index=0..n-1 distributed over the threads (serial: in order by worker 0)
+  void run(const unsigned int n, const Work& work, const bool serial=false);
+
+ private:
+  /// not to be copied
+  TopKinFitterThreadPool(const TopKinFitterThreadPool&);
+  TopKinFitterThreadPool& operator=(const TopKinFitterThreadPool&);
+  /// main loop of the additional threads
+  void loop(const unsigned int worker);
+  /// process indices until none is left
+  void process(const unsigned int worker);
+
+ private:
+  /// additional threads
+  std::vector<std::thread> threads_;
+  /// protects the members below except next_
+  std::mutex mutex_;
+  /// signals new work or the end to the threads
+  std::condition_variable wake_;
+  /// signals the end of the work of all threads
+  std::condition_variable done_;
+  /// current work and number of indices
+  const Work* work_;
+  unsigned int n_;
+  /// next index to be processed
+  std::atomic<unsigned int> next_;
+  /// counts the calls of run() to wake up the threads
+  unsigned long generation_;
+  /// number of additional threads still working on the current call of run()
+  unsigned int busy_;
+  /// threads are to be stopped
+  bool stop_;
+  /// first exception thrown by the work
+  std::exception_ptr error_;
+};
+
+#endif
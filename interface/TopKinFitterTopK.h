@@ -0,0 +1,122 @@
+#ifndef TopKinFitterTopK_h
+#define TopKinFitterTopK_h
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+/*
+  \class   TopKinFitterTopK TopKinFitterTopK.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTopK.h"
+
+  \brief   Keeps the fit results with the k smallest chi2 values out of a sequence of fits
+
+  The results are ranked by chi2 and, for equal chi2, by their index in the sequence of fits,
+  which reproduces the order of a stable sort of all results. They are kept in a max-heap over
+  a contiguous array of fixed capacity, such that the worst kept result is always on top: a
+  new result is only accepted if it ranks better, in which case it replaces the worst one.
+  Check accepts() before filling the payload of a result, so that only results that make the
+  cut are materialised. Several instances (e.g. one per thread) can be merged. A capacity of
+  0 keeps all results.
+
+**/
+
+template <class Result>
+class TopKinFitterTopK {
+
+ public:
+  /// constructor with the maximal number of results to be kept (0 for all)
+  explicit TopKinFitterTopK(const unsigned int capacity=0);
+  /// default destructor
+  ~TopKinFitterTopK(){};
+
+  /// return the maximal number of results to be kept (0 for all)
+  unsigned int capacity() const { return capacity_; };
+  /// return the number of results kept
+  unsigned int size() const { return entries_.size(); };
+  /// remove all results, keeping the allocated memory
+  void clear() { entries_.clear(); };
+  /// return whether a result with given chi2 and index in the sequence of fits would be kept
+  bool accepts(const double chi2, const unsigned int index) const;
+  /// add a result if accepted; the payload is swapped in, result is left in an unspecified state
+  void push(const double chi2, const unsigned int index, Result& result);
+  /// add the results of another instance
+  void merge(TopKinFitterTopK& other);
+  /// move the kept results out in ranking order (best first) into a sequence container and clear
+  template <class Container>
+  void extract(Container& results);
+
+ private:
+  /// result with its ranking
+  struct Entry {
+    double chi2;
+    unsigned int index;
+    Result result;
+  };
+  /// ranking: entries that rank worse compare greater, putting the worst on top of the heap
+  static bool less(const Entry& lhs, const Entry& rhs) {
+    return (lhs.chi2<rhs.chi2 || (lhs.chi2==rhs.chi2 && lhs.index<rhs.index));
+  }
+
+ private:
+  /// maximal number of results to be kept (0 for all)
+  unsigned int capacity_;
+  /// heap of the kept results
+  std::vector<Entry> entries_;
+};
+
+template <class Result>
+TopKinFitterTopK<Result>::TopKinFitterTopK(const unsigned int capacity):
+  capacity_(capacity)
+{
+  entries_.reserve(capacity_);
+}
+
+template <class Result>
+bool
+TopKinFitterTopK<Result>::accepts(const double chi2, const unsigned int index) const
+{
+  if(capacity_==0 || entries_.size()<capacity_) return true;
+  const Entry& worst = entries_.front();
+  return (chi2<worst.chi2 || (chi2==worst.chi2 && index<worst.index));
+}
+
+template <class Result>
+void
+TopKinFitterTopK<Result>::push(const double chi2, const unsigned int index, Result& result)
+{
+  if(!accepts(chi2, index)) return;
+  if(capacity_>0 && entries_.size()==capacity_)
+    // move the worst entry to the back and reuse it
+    std::pop_heap(entries_.begin(), entries_.end(), less);
+  else
+    entries_.push_back(Entry());
+  Entry& entry = entries_.back();
+  entry.chi2  = chi2;
+  entry.index = index;
+  std::swap(entry.result, result);
+  std::push_heap(entries_.begin(), entries_.end(), less);
+}
+
+template <class Result>
+void
+TopKinFitterTopK<Result>::merge(TopKinFitterTopK& other)
+{
+  for(unsigned int i=0; i<other.entries_.size(); ++i)
+    push(other.entries_[i].chi2, other.entries_[i].index, other.entries_[i].result);
+  other.clear();
+}
+
+template <class Result>
+template <class Container>
+void
+TopKinFitterTopK<Result>::extract(Container& results)
+{
+  std::sort_heap(entries_.begin(), entries_.end(), less);
+  results.resize(entries_.size());
+  typename Container::iterator result = results.begin();
+  for(unsigned int i=0; i<entries_.size(); ++i, ++result)
+    std::swap(*result, entries_[i].result);
+  clear();
+}
+
+#endif
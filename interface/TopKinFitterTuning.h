@@ -0,0 +1,94 @@
+#ifndef TopKinFitterTuning_h
+#define TopKinFitterTuning_h
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterStats.h"
+
+/*
+  \class   TopKinFitterTuning TopKinFitterTuning.h "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTuning.h"
+
+  \brief   Adaptive limit on the number of iterations of the kinematic fit
+
+  During a warm-up period the fits are performed with the configured maximal number of
+  iterations and the distribution of the number of iterations of converged fits is taken
+  from the fit statistics. Once the warm-up period is over, the iteration limit is lowered
+  to a high quantile of this distribution. Decisions are only taken at event boundaries, so
+  that all fits of an event use the same limit.
+
+  To monitor the effect on the ranking of the jet combinations, every n-th event after the
+  warm-up is a validation event: fits that hit the lowered limit are repeated with the
+  configured limit, and the best combination with and without these rescued fits is compared.
+  The repeated fits only enter this comparison; the written results are the ones of the
+  lowered limit in all events.
+
+**/
+
+class TopKinFitterTuning {
+
+ public:
+  /// default constructor (adaptive mode switched off)
+  TopKinFitterTuning();
+  /// constructor with configuration
+  TopKinFitterTuning(const bool enabled, const unsigned int warmUpFits, const double quantile,
+		     const int maxNrIter, const unsigned int validationPrescale);
+  /// default destructor
+  ~TopKinFitterTuning(){};
+
+  /// to be called at the beginning of each event; returns true if the iteration limit changed
+  bool beginEvent(const TopKinFitterStats& stats);
+  /// return whether the adaptive mode is switched on
+  bool enabled() const { return enabled_; };
+  /// return whether the warm-up period is over
+  bool tuned() const { return tuned_; };
+  /// return the iteration limit to be used for the current event
+  int maxNrIter() const { return tuned_ ? tunedNrIter_ : maxNrIter_; };
+  /// return whether the current event is a validation event
+  bool validateEvent() const { return validate_; };
+  /// add the outcome of a validation event: best combination and chi2 including
+  /// (fixed limit) and excluding (tuned limit) the rescued fits, and number of rescued fits
+  void fillValidation(const std::vector<int>& bestCombi, const double bestChi2,
+		      const std::vector<int>& bestTunedCombi, const double bestTunedChi2,
+		      const unsigned int nRescued);
+
+  /// report the chosen settings and the ranking quality
+  void print(std::ostream& out, const std::string& label) const;
+
+ private:
+  /// switch for the adaptive mode
+  bool enabled_;
+  /// number of fits in the warm-up period
+  unsigned int warmUpFits_;
+  /// quantile of the iterations of converged fits used as limit
+  double quantile_;
+  /// configured maximal number of iterations
+  int maxNrIter_;
+  /// every n-th event after the warm-up is used for validation (0 for none)
+  unsigned int validationPrescale_;
+  /// warm-up period over
+  bool tuned_;
+  /// iteration limit after the warm-up period
+  int tunedNrIter_;
+  /// number of converged fits the limit was derived from
+  unsigned long nConvergedWarmUp_;
+  /// number of events after the warm-up period
+  unsigned long nTunedEvents_;
+  /// current event is a validation event
+  bool validate_;
+  /// number of validation events
+  unsigned long nValidated_;
+  /// number of validation events with converged fits for both limits
+  unsigned long nCompared_;
+  /// number of validation events in which the best combination changed
+  unsigned long nChanged_;
+  /// number of validation events without converged fit when using the tuned limit only
+  unsigned long nLost_;
+  /// number of fits rescued by the configured limit
+  unsigned long nRescued_;
+  /// summed chi2 difference of the best combination (tuned - fixed)
+  double sumDeltaChi2_;
+};
+
+#endif
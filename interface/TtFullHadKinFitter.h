@@ -1,7 +1,9 @@
 #ifndef TtFullHadKinFitter_h
 #define TtFullHadKinFitter_h
 
+#include <list>
 #include <vector>
+#include <chrono>
 
 #include "TLorentzVector.h"
 
@@ -9,8 +11,15 @@
 
 #include "TopQuarkAnalysis/TopKinFitter/interface/CovarianceMatrix.h"
 #include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitter.h"
-
-#include "PhysicsTools/JetMCUtils/interface/combination.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTuning.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterPruning.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterBeamSearch.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJetPreselection.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterRecord.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/JetCombinationGenerator.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterThreadPool.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTopK.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
@@ -56,18 +65,29 @@ class TtFullHadKinFitter : public TopKinFitter {
 
   /// kinematic fit interface
   int fit(const std::vector<pat::Jet>& jets);
+  /// kinematic fit interface for plain 4-vecs
+  int fit(const TLorentzVector& p4LightQ, const TLorentzVector& p4LightQBar, const TLorentzVector& p4B,
+	  const TLorentzVector& p4LightP, const TLorentzVector& p4LightPBar, const TLorentzVector& p4BBar);
+  /// common core of the fit interface
+  int fit(const TLorentzVector& p4LightQ, const TLorentzVector& p4LightQBar, const TLorentzVector& p4B,
+	  const TLorentzVector& p4LightP, const TLorentzVector& p4LightPBar, const TLorentzVector& p4BBar,
+	  const TMatrixD& covLightQ, const TMatrixD& covLightQBar, const TMatrixD& covB,
+	  const TMatrixD& covLightP, const TMatrixD& covLightPBar, const TMatrixD& covBBar);
   /// return fitted b quark candidate
-  const pat::Particle fittedB() const { return (fitter_->getStatus()==0 ? fittedB_ : pat::Particle()); };
+  const pat::Particle fittedB() const { return (hasFitResult() ? fittedB_ : pat::Particle()); };
   /// return fitted b quark candidate
-  const pat::Particle fittedBBar() const { return (fitter_->getStatus()==0 ? fittedBBar_ : pat::Particle()); };
+  const pat::Particle fittedBBar() const { return (hasFitResult() ? fittedBBar_ : pat::Particle()); };
   /// return fitted light quark candidate
-  const pat::Particle fittedLightQ() const { return (fitter_->getStatus()==0 ? fittedLightQ_ : pat::Particle()); };
+  const pat::Particle fittedLightQ() const { return (hasFitResult() ? fittedLightQ_ : pat::Particle()); };
   /// return fitted light quark candidate
-  const pat::Particle fittedLightQBar() const { return (fitter_->getStatus()==0 ? fittedLightQBar_ : pat::Particle()); };
+  const pat::Particle fittedLightQBar() const { return (hasFitResult() ? fittedLightQBar_ : pat::Particle()); };
   /// return fitted light quark candidate
-  const pat::Particle fittedLightP() const { return (fitter_->getStatus()==0 ? fittedLightP_ : pat::Particle()); };
+  const pat::Particle fittedLightP() const { return (hasFitResult() ? fittedLightP_ : pat::Particle()); };
   /// return fitted light quark candidate
-  const pat::Particle fittedLightPBar() const { return (fitter_->getStatus()==0 ? fittedLightPBar_ : pat::Particle()); };
+  const pat::Particle fittedLightPBar() const { return (hasFitResult() ? fittedLightPBar_ : pat::Particle()); };
+  /// embed the fitted covariance matrices as kinematic resolutions into the fitted particles of
+  /// the last fit (not done in fit() to keep the loop over the jet combinations cheap)
+  void embedFitResolutions();
   /// add kin fit information to the old event solution (in for legacy reasons)
   TtHadEvtSolution addKinFitInfo(TtHadEvtSolution * asol);
   
@@ -119,6 +139,7 @@ class TtFullHadKinFitter : public TopKinFitter {
     int Status;
     double Chi2;
     double Prob;
+    double Residual;
     pat::Particle B;
     pat::Particle BBar;
     pat::Particle LightQ;
@@ -182,7 +203,11 @@ class TtFullHadKinFitter : public TopKinFitter {
     }
     /// set match to be used
     void setMatch(const std::vector<int>& match){
-      match_ = match;
+      matches_ = std::vector<std::vector<int> >(1, match);
+    }
+    /// set matches to be used (all of them are fitted and ranked by chi2)
+    void setMatches(const std::vector<std::vector<int> >& matches){
+      matches_ = matches;
     }
     /// set the validity of a match
     void setMatchInvalidity(bool invalidMatch){
@@ -192,16 +217,141 @@ class TtFullHadKinFitter : public TopKinFitter {
     void setOutput(int maxNComb){
       maxNComb_ = maxNComb;
     }
+    /// return only the best maxNResults fit results from fit() (0 for all, the default); the
+    /// fits of the other combinations are bounded by them and may be skipped
+    void setMaxNResults(unsigned int maxNResults){
+      maxNResults_ = maxNResults;
+    }
+    /// set parameters for the adaptive limit on the number of iterations
+    void setAdaptiveNrIter(bool enabled, unsigned int warmUpFits, double quantile, unsigned int validationPrescale){
+      tuning_ = TopKinFitterTuning(enabled, warmUpFits, quantile, maxNrIter_, validationPrescale);
+    }
+    /// keep fits that stopped at the maximal number of iterations
+    void setKeepUnconverged(bool keepUnconverged){
+      keepUnconverged_ = keepUnconverged;
+      fitter->setKeepUnconverged(keepUnconverged);
+      for(unsigned int i=0; i<workers_.size(); ++i) workers_[i]->setKeepUnconverged(keepUnconverged);
+      for(unsigned int branch=0; branch<2; ++branch)
+	for(unsigned int i=0; i<tripletFitters_[branch].size(); ++i) tripletFitters_[branch][i]->setKeepUnconverged(keepUnconverged);
+    }
+    /// export the fitted covariance matrices for the combinations to be written
+    void setExportFitCovariance(bool exportFitCovariance){
+      exportFitCovariance_ = exportFitCovariance;
+    }
+    /// set stream to record the fit inputs to (0 for none)
+    void setFitInputDump(std::ostream* fitInputDump){
+      fitInputDump_ = fitInputDump;
+    }
+    /// set the number of threads to distribute the fits of the jet combinations of an event over
+    void setNumThreads(unsigned int numThreads);
+    /// set the budget for the fits of an event: maximal number of jet combinations fitted (the triplet fits are
+    /// not counted) and wall time in seconds (0 for no limit)
+    void setBudget(unsigned int maxNFittedCombis, double maxFitTime){
+      maxNFittedCombis_   = maxNFittedCombis;
+      maxFitTime_ = maxFitTime;
+    }
+    /// fit the distinct jet triplets (b, q, q') of the two top branches once per event: without equal top masses
+    /// their results are combined, with equal top masses they bound and order the fits of the jet combinations;
+    /// these coupled fits are not seeded from the triplets (TKinFitter starts from the measured values), each
+    /// jet combination that is not pruned is still fitted in full
+    void setFactoriseFits(bool factoriseFits){
+      factoriseFits_ = factoriseFits;
+      setupTripletFitters();
+    }
+    /// skip jet combinations with a W candidate further than maxWPull standard deviations from mW (0 for no cut);
+    /// in every n-th event (n = validationPrescale, 0 for none) they are fitted to monitor the cut
+    void setWPullCut(double maxWPull, unsigned int validationPrescale){
+      pruning_ = TopKinFitterPruning(maxWPull, validationPrescale);
+    }
+    /// approximate search: fit only the beamWidth best assignments grown role by role (0 for all combinations);
+    /// in every n-th event (n = validationPrescale, 0 for none) all combinations are fitted to monitor it
+    void setBeamSearch(unsigned int beamWidth, unsigned int validationPrescale){
+      beamSearch_ = TopKinFitterBeamSearch(beamWidth, validationPrescale);
+    }
+    /// compare the predicted number of fits per event with the actual one and the fit time
+    void setCostReport(bool costReport){
+      cost_ = TopKinFitterCost(costReport);
+    }
+    /// choose the maxNJets jets by their ranks in pt and in the b-tag discriminator, keeping the
+    /// b-tagged jets needed for the b partons (with the b-tagging parameters in use at the fit)
+    void setJetPreselection(bool jetPreselection, double bTagWeight){
+      preselection_ = TopKinFitterJetPreselection(jetPreselection, bTagWeight);
+    }
 
-    /// do the fitting and return fit result
+    /// do the fitting and return the fit results of all combinations (or the best maxNResults
+    /// ones, see setMaxNResults) sorted w.r.t. chi2
     std::list<TtFullHadKinFitter::KinFitResult> fit(const std::vector<pat::Jet>& jets);
+    /// return the statistics of all fits performed so far
+    const TopKinFitterStats& fitStats() const { return fitter->fitStats(); }
+    /// return the adaptive limit on the number of iterations
+    const TopKinFitterTuning& tuning() const { return tuning_; }
+    /// return whether all jet combinations of the last event were fitted (i.e. the budget was not exceeded)
+    bool exhaustive() const { return exhaustive_; }
+    /// return the statistics of the pruned jet combinations
+    const TopKinFitterPruning& pruning() const { return pruning_; }
+    /// return the statistics of the approximate search
+    const TopKinFitterBeamSearch& beamSearch() const { return beamSearch_; }
+    /// return the predicted against the actual number of fits
+    const TopKinFitterCost& cost() const { return cost_; }
+    /// return the choice of the jets to be considered
+    const TopKinFitterJetPreselection& preselection() const { return preselection_; }
     
   private:
 
-    // helper function for b-tagging
-    bool doBTagging(const std::vector<pat::Jet>& jets, const unsigned int& bJetCounter, std::vector<int>& combi);
+    /// outcome of the fit of a single jet combination on one of the threads
+    struct CombiFit {
+      bool fitted;
+      bool pruned;
+      bool cut;
+      bool offBeam;
+      int status;
+      double chi2;
+      bool hasResult;
+      /// converged only when repeated with the configured iteration limit, with rescuedChi2
+      bool rescued;
+      double rescuedChi2;
+    };
+    /// outcome of the fit of a single jet triplet (b, q, q') of one top branch
+    struct TripletFit {
+      bool fitted;
+      int status;
+      double chi2;
+      double residual;
+      int ndf;
+      bool hasResult;
+      bool rescued;
+      double rescuedChi2;
+      pat::Particle b, lightQ, lightQBar;
+    };
+    /// W candidate of a jet pair: corrected dijet mass and its distance from mW in standard deviations
+    struct DijetW {
+      double mass;
+      double pull;
+    };
+
+    /// create a kinematic fit interface with the configured parameters
+    TtFullHadKinFitter* newFitter();
+    /// restrict the jet assignments to those compatible with the b-tagging; returns false if there are none
+    bool setupBTagging(const std::vector<pat::Jet>& jets, JetCombinationGenerator<TtFullHadTopology>& combinations);
     /// helper function to construct the proper corrected jet for its corresponding quarkType
     pat::Jet corJet(const pat::Jet& jet, const std::string& quarkType);
+    /// helper function to construct the corrected jets of a given jet combination
+    std::vector<pat::Jet> jetCombination(const std::vector<pat::Jet>& jets, const std::vector<int>& combi);
+    /// fill the W candidates of all jet pairs of the event and the corrected jets for the top candidates
+    void fillDijetTable(const std::vector<pat::Jet>& jets);
+    /// return the W candidate of the jets i and j
+    const DijetW& dijet(int i, int j) const { return dijets_[i*nDijetJets_+j]; }
+    /// return whether one of the W candidates of a jet combination fails the pull cut
+    bool hopelessW(const std::vector<int>& combi) const;
+    /// sum of the squared pulls of the W and top candidates of the assigned branches of a (partial) jet combination
+    double beamScore(const std::vector<int>& combi) const;
+    /// order the jet combinations by the pulls of their W candidates (best first)
+    void orderCombinations(std::vector<std::vector<int> >& combis);
+    /// create the kinematic fit interfaces for the jet triplets if the constraints allow for it
+    void setupTripletFitters();
+    /// fit the distinct jet triplets of the combinations; tripletOf gives the triplet fit per branch and combination
+    void fitTriplets(const std::vector<pat::Jet>& jets, const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+		     std::vector<TripletFit>& tripletFits, std::vector<unsigned int> (&tripletOf)[2]);
     
     // convert unsigned to Param
     TtFullHadKinFitter::Param param(unsigned int configParameter);
@@ -231,8 +381,12 @@ class TtFullHadKinFitter : public TopKinFitter {
     std::string jetCorrectionLevel_;
     /// maximal number of jets (-1 possible to indicate 'all')
     int maxNJets_;
+    /// choice of the maxNJets jets to be considered
+    TopKinFitterJetPreselection preselection_;
     /// maximal number of combinations to be written to the event
     int maxNComb_;
+    /// maximal number of fit results returned by fit() (0 for all)
+    unsigned int maxNResults_;
     /// maximal number of iterations to be performed for the fit
     unsigned int maxNrIter_;
     /// maximal chi2 equivalent
@@ -249,13 +403,59 @@ class TtFullHadKinFitter : public TopKinFitter {
     double mTop_;
     /// fit or only a certain combination
     bool useOnlyMatch_;
-    /// the combination that should be used
-    std::vector<int> match_;
+    /// the combinations that should be used
+    std::vector<std::vector<int> > matches_;
     /// match is invalid
     bool invalidMatch_;
+    /// adaptive limit on the number of iterations
+    TopKinFitterTuning tuning_;
+    /// cut on the W candidates and statistics of the pruned combinations
+    TopKinFitterPruning pruning_;
+    /// W candidates of all jet pairs of the event (indexed by i*nDijetJets_+j)
+    std::vector<DijetW> dijets_;
+    unsigned int nDijetJets_;
+    /// corrected 4-vectors of the jets as light and as b jets and their relative energy resolutions
+    std::vector<TLorentzVector> wJets_, bJets_;
+    std::vector<double> wJetResolutions_, bJetResolutions_;
+    /// approximate search for the best jet assignment
+    TopKinFitterBeamSearch beamSearch_;
+    /// predicted against actual number of fits per event
+    TopKinFitterCost cost_;
+    /// resolutions for the pulls of the W candidates
+    CovarianceMatrix* covM_;
+    /// stream to record the fit inputs to
+    std::ostream* fitInputDump_;
+    /// export the fitted covariance matrices for the combinations to be written
+    bool exportFitCovariance_;
+    /// keep fits that stopped at the maximal number of iterations
+    bool keepUnconverged_;
+    /// maximal number of fits per event (0 for no limit)
+    unsigned int maxNFittedCombis_;
+    /// maximal wall time for the fits of an event in seconds (0 for no limit)
+    double maxFitTime_;
+    /// all jet combinations of the last event were fitted
+    bool exhaustive_;
+    /// fit the jet triplets of the two top branches once per event
+    bool factoriseFits_;
+    /// mass constraints of either top branch, both expressed in terms of the first one (B, LightQ,
+    /// LightQBar); empty for both if the jet triplets are not used
+    std::vector<TtFullHadKinFitter::Constraint> tripletConstraints_[2];
+    /// the branches are coupled by the equal top masses: the triplet fits only bound and order the full fits
+    bool coupled_;
+    /// both branches have the same constraints and share the triplet fits
+    bool symmetric_;
+    /// threads for the fits of the jet combinations of an event
+    TopKinFitterThreadPool* pool_;
 
     /// kinematic fit interface
     TtFullHadKinFitter* fitter;
+    /// additional kinematic fit interfaces for the worker threads (the calling thread uses fitter)
+    std::vector<TtFullHadKinFitter*> workers_;
+    /// kinematic fit interfaces for the jet triplets per branch and thread (none for the second
+    /// branch if both are symmetric)
+    std::vector<TtFullHadKinFitter*> tripletFitters_[2];
+    /// best maxNResults fit results per thread
+    std::vector<TopKinFitterTopK<TtFullHadKinFitter::KinFitResult> > bestResults_;
  
   };
 };
@@ -47,7 +47,8 @@ class TtSemiLepKinFitter : public TopKinFitter {
 			      const std::vector<edm::ParameterSet>* lepResolutions =0, 
 			      const std::vector<edm::ParameterSet>* metResolutions =0,
 			      const std::vector<double>* jetEnergyResolutionScaleFactors=0,
-			      const std::vector<double>* jetEnergyResolutionEtaBinning  =0);
+			      const std::vector<double>* jetEnergyResolutionEtaBinning  =0,
+			      const bool fixLepton=false);
   /// default destructor
   ~TtSemiLepKinFitter();
 
@@ -63,17 +64,20 @@ class TtSemiLepKinFitter : public TopKinFitter {
 	  const TMatrixD& covLepton, const TMatrixD& covNeutrino,
 	  const int leptonCharge);
   /// return hadronic b quark candidate
-  const pat::Particle fittedHadB() const { return (fitter_->getStatus()==0 ? fittedHadB_ : pat::Particle()); };
+  const pat::Particle fittedHadB() const { return (hasFitResult() ? fittedHadB_ : pat::Particle()); };
   /// return hadronic light quark candidate
-  const pat::Particle fittedHadP() const { return (fitter_->getStatus()==0 ? fittedHadP_ : pat::Particle()); };
+  const pat::Particle fittedHadP() const { return (hasFitResult() ? fittedHadP_ : pat::Particle()); };
   /// return hadronic light quark candidate
-  const pat::Particle fittedHadQ() const { return (fitter_->getStatus()==0 ? fittedHadQ_ : pat::Particle()); };
+  const pat::Particle fittedHadQ() const { return (hasFitResult() ? fittedHadQ_ : pat::Particle()); };
   /// return leptonic b quark candidate
-  const pat::Particle fittedLepB() const { return (fitter_->getStatus()==0 ? fittedLepB_ : pat::Particle()); };
-  /// return lepton candidate
-  const pat::Particle fittedLepton() const { return (fitter_->getStatus()==0 ? fittedLepton_ : pat::Particle()); };
+  const pat::Particle fittedLepB() const { return (hasFitResult() ? fittedLepB_ : pat::Particle()); };
+  /// return lepton candidate (the input lepton if the lepton is kept fixed)
+  const pat::Particle fittedLepton() const { return (hasFitResult() ? fittedLepton_ : pat::Particle()); };
   /// return neutrino candidate
-  const pat::Particle fittedNeutrino() const { return (fitter_->getStatus()==0 ? fittedNeutrino_ : pat::Particle()); };
+  const pat::Particle fittedNeutrino() const { return (hasFitResult() ? fittedNeutrino_ : pat::Particle()); };
+  /// embed the fitted covariance matrices as kinematic resolutions into the fitted particles of
+  /// the last fit (not done in fit() to keep the loop over the jet combinations cheap)
+  void embedFitResolutions();
   /// add kin fit information to the old event solution (in for legacy reasons)
   TtSemiEvtSolution addKinFitInfo(TtSemiEvtSolution* asol);
   
@@ -97,6 +101,8 @@ class TtSemiLepKinFitter : public TopKinFitter {
   TAbsFitParticle* lepB_;
   TAbsFitParticle* lepton_;
   TAbsFitParticle* neutrino_;
+  /// unmeasured neutrino pz (only for the MET parametrisation kEtPhiPz)
+  TAbsFitParticle* neutrinoPz_;
   /// resolutions
   const std::vector<edm::ParameterSet>* udscResolutions_;
   const std::vector<edm::ParameterSet>* bResolutions_;
@@ -126,6 +132,8 @@ class TtSemiLepKinFitter : public TopKinFitter {
   Param metParam_;
   /// vector of constraints to be used
   std::vector<Constraint> constrList_;
+  /// keep the lepton as fixed 4-vector in the mass constraints instead of fitting it
+  bool fixLepton_;
   /// internally use simple boolean for this constraint to reduce the per-event computing time
   bool constrainSumPt_;
 };
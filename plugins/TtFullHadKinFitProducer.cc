@@ -1,12 +1,29 @@
+#include <fstream>
+#include <sstream>
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
 #include "TopQuarkAnalysis/TopKinFitter/plugins/TtFullHadKinFitProducer.h"
 
 static const unsigned int nPartons=6;
 
+/// fitted objects of a fit result in the order of TopKinFitResults::FullHadRole
+static std::vector<const reco::Candidate*> fittedObjects(const TtFullHadKinFitter::KinFitResult& res)
+{
+  std::vector<const reco::Candidate*> fitted(TopKinFitResults::kNFullHadRoles);
+  fitted[TopKinFitResults::kB         ] = &res.B;
+  fitted[TopKinFitResults::kBBar      ] = &res.BBar;
+  fitted[TopKinFitResults::kLightQ    ] = &res.LightQ;
+  fitted[TopKinFitResults::kLightQBar ] = &res.LightQBar;
+  fitted[TopKinFitResults::kLightP    ] = &res.LightP;
+  fitted[TopKinFitResults::kLightPBar ] = &res.LightPBar;
+  return fitted;
+}
+
 /// default constructor  
-TtFullHadKinFitProducer::TtFullHadKinFitProducer(const edm::ParameterSet& cfg):
-  jets_                       (cfg.getParameter<edm::InputTag>("jets")),
-  match_                      (cfg.getParameter<edm::InputTag>("match")),
+TtFullHadKinFitProducer::TtFullHadKinFitProducer(const edm::ParameterSet& cfg, const TopKinFitterGlobalCache* cache):
+  jetsToken_                  (consumes<std::vector<pat::Jet> >(cfg.getParameter<edm::InputTag>("jets"))),
   useOnlyMatch_               (cfg.getParameter<bool>("useOnlyMatch")),
+  maxNMatch_                  (cfg.getParameter<unsigned int>("maxNMatch")),
   bTagAlgo_                   (cfg.getParameter<std::string>("bTagAlgo")),
   minBTagValueBJet_           (cfg.getParameter<double>("minBTagValueBJet")),
   maxBTagValueNonBJet_        (cfg.getParameter<double>("maxBTagValueNonBJet")),
@@ -15,16 +32,38 @@ TtFullHadKinFitProducer::TtFullHadKinFitProducer(const edm::ParameterSet& cfg):
   jetCorrectionLevel_         (cfg.getParameter<std::string>("jetCorrectionLevel")),
   maxNJets_                   (cfg.getParameter<int>("maxNJets")),
   maxNComb_                   (cfg.getParameter<int>("maxNComb")),
+  exportFitCovariance_        (cfg.getParameter<bool>("exportFitCovariance")),
+  numThreads_                 (cfg.getParameter<unsigned int>("numThreads")),
+  maxNFittedCombis_           (cfg.getParameter<unsigned int>("maxNFittedCombis")),
+  maxFitTime_                 (cfg.getParameter<double>("maxFitTime")),
+  factoriseFits_              (cfg.getParameter<bool>("factoriseFits")),
+  maxWPull_                   (cfg.getParameter<double>("maxWPull")),
+  wPullValidationPrescale_    (cfg.getParameter<unsigned int>("wPullValidationPrescale")),
+  beamWidth_                  (cfg.getParameter<unsigned int>("beamWidth")),
+  beamValidationPrescale_     (cfg.getParameter<unsigned int>("beamValidationPrescale")),
+  costReport_                 (cfg.getParameter<bool>("costReport")),
+  offloadMinFits_             (cfg.getParameter<unsigned int>("offloadMinFits")),
+  compactResults_             (cfg.getParameter<bool>("compactResults")),
+  pullResults_                (cfg.getParameter<bool>("pullResults")),
+  jetPreselection_            (cfg.getParameter<bool>("jetPreselection")),
+  jetPreselectionBTagWeight_  (cfg.getParameter<double>("jetPreselectionBTagWeight")),
   maxNrIter_                  (cfg.getParameter<unsigned int>("maxNrIter")),
   maxDeltaS_                  (cfg.getParameter<double>("maxDeltaS")),
   maxF_                       (cfg.getParameter<double>("maxF")),
+  keepUnconverged_            (cfg.getParameter<bool>("keepUnconverged")),
   jetParam_                   (cfg.getParameter<unsigned>("jetParametrisation")),
   constraints_                (cfg.getParameter<std::vector<unsigned> >("constraints")),
   mW_                         (cfg.getParameter<double>("mW"  )),
   mTop_                       (cfg.getParameter<double>("mTop")),
   jetEnergyResolutionScaleFactors_(cfg.getParameter<std::vector<double> >("jetEnergyResolutionScaleFactors")),
-  jetEnergyResolutionEtaBinning_  (cfg.getParameter<std::vector<double> >("jetEnergyResolutionEtaBinning"))
+  jetEnergyResolutionEtaBinning_  (cfg.getParameter<std::vector<double> >("jetEnergyResolutionEtaBinning")),
+  fitInputDump_               (cfg.getParameter<std::string>("fitInputDump")),
+  stream_                     (cache->summary.newStream())
 {
+  // the matches are only read if they are to be used
+  if(useOnlyMatch_)
+    matchToken_ = consumes<std::vector<std::vector<int> > >(cfg.getParameter<edm::InputTag>("match"));
+
   if(cfg.exists("udscResolutions") && cfg.exists("bResolutions")){
     udscResolutions_ = cfg.getParameter <std::vector<edm::ParameterSet> >("udscResolutions");
     bResolutions_    = cfg.getParameter <std::vector<edm::ParameterSet> >("bResolutions");
@@ -39,19 +78,47 @@ TtFullHadKinFitProducer::TtFullHadKinFitProducer(const edm::ParameterSet& cfg):
 					     udscResolutions_, bResolutions_, jetEnergyResolutionScaleFactors_, 
 					     jetEnergyResolutionEtaBinning_, jetCorrectionLevel_, maxNJets_, maxNComb_,
 					     maxNrIter_, maxDeltaS_, maxF_, jetParam_, constraints_, mW_, mTop_);
+  kinFitter->setMaxNResults(maxNComb_>=1 ? maxNComb_ : 0);
+  kinFitter->setKeepUnconverged(keepUnconverged_);
+  kinFitter->setExportFitCovariance(exportFitCovariance_);
+  kinFitter->setNumThreads(numThreads_);
+  kinFitter->setBudget(maxNFittedCombis_, maxFitTime_);
+  kinFitter->setFactoriseFits(factoriseFits_);
+  kinFitter->setWPullCut(maxWPull_, wPullValidationPrescale_);
+  kinFitter->setBeamSearch(beamWidth_, beamValidationPrescale_);
+  kinFitter->setCostReport(costReport_);
+  kinFitter->setJetPreselection(jetPreselection_, jetPreselectionBTagWeight_);
+  kinFitter->setAdaptiveNrIter(cfg.getParameter<bool>("adaptiveMaxNrIter"), cfg.getParameter<unsigned int>("adaptiveWarmUpFits"),
+			       cfg.getParameter<double>("adaptiveQuantile"), cfg.getParameter<unsigned int>("adaptiveValidationPrescale"));
+  if(!fitInputDump_.empty()){
+    fitInputDump_ = TopKinFitterJobSummary::streamFileName(fitInputDump_, stream_);
+    fitInputDumpFile_.open(fitInputDump_.c_str());
+    if(!fitInputDumpFile_) throw cms::Exception("Configuration") << "Cannot open file '" << fitInputDump_ << "' to record the fit inputs.\n";
+    kinFitter->setFitInputDump(&fitInputDumpFile_);
+  }
 
   // produces the following collections
-  produces< std::vector<pat::Particle> >("PartonsB");
-  produces< std::vector<pat::Particle> >("PartonsBBar");
-  produces< std::vector<pat::Particle> >("PartonsLightQ");
-  produces< std::vector<pat::Particle> >("PartonsLightQBar");
-  produces< std::vector<pat::Particle> >("PartonsLightP");
-  produces< std::vector<pat::Particle> >("PartonsLightPBar");
-
-  produces< std::vector<std::vector<int> > >();
-  produces< std::vector<double> >("Chi2");
-  produces< std::vector<double> >("Prob");
-  produces< std::vector<int> >("Status");
+  if(compactResults_){
+    produces<TopKinFitResults>("Compact");
+  }
+  if(pullResults_){
+    produces<TopKinFitPulls>("Pulls");
+  }
+  if(!compactResults_ && !pullResults_){
+    produces< std::vector<pat::Particle> >("PartonsB");
+    produces< std::vector<pat::Particle> >("PartonsBBar");
+    produces< std::vector<pat::Particle> >("PartonsLightQ");
+    produces< std::vector<pat::Particle> >("PartonsLightQBar");
+    produces< std::vector<pat::Particle> >("PartonsLightP");
+    produces< std::vector<pat::Particle> >("PartonsLightPBar");
+
+    produces< std::vector<std::vector<int> > >();
+    produces< std::vector<double> >("Chi2");
+    produces< std::vector<double> >("Prob");
+    produces< std::vector<int> >("Status");
+    produces< std::vector<double> >("ConstraintResidual");
+  }
+  produces<bool>("Exhaustive");
 }
 
 /// default destructor
@@ -60,56 +127,129 @@ TtFullHadKinFitProducer::~TtFullHadKinFitProducer()
   delete kinFitter;
 }
 
-/// produce fitted object collections and meta data describing fit quality
-void 
-TtFullHadKinFitProducer::produce(edm::Event& event, const edm::EventSetup& setup)
+/// create the summary and the dedicated threads shared by the streams
+std::unique_ptr<TopKinFitterGlobalCache>
+TtFullHadKinFitProducer::initializeGlobalCache(const edm::ParameterSet& cfg)
+{
+  return std::unique_ptr<TopKinFitterGlobalCache>(new TopKinFitterGlobalCache(cfg.getParameter<std::string>("fitStatsJSON"),
+									      cfg.getParameter<unsigned int>("offloadThreads")));
+}
+
+/// get the inputs and do the fit, on the dedicated threads for large combinatorics
+void
+TtFullHadKinFitProducer::acquire(const edm::Event& event, const edm::EventSetup& setup, edm::WaitingTaskWithArenaHolder holder)
 {
   // get jet collection
   edm::Handle<std::vector<pat::Jet> > jets;
-  event.getByLabel(jets_, jets);
+  event.getByToken(jetsToken_, jets);
 
   // get match in case that useOnlyMatch_ is true
-  std::vector<int> match;
+  std::vector<std::vector<int> > validMatches;
   bool invalidMatch=false;
   if(useOnlyMatch_) {
     kinFitter->setUseOnlyMatch(true);
-    // in case that only a ceratin match should be used, get match here
+    // in case that only certain matches should be used, get the first maxNMatch valid ones here
     edm::Handle<std::vector<std::vector<int> > > matches;
-    event.getByLabel(match_, matches);
-    match = *(matches->begin());
-    // check if match is valid
-    if( match.size()!=nPartons ){
-      invalidMatch=true;
-    }
-    else {
-      for(unsigned int idx=0; idx<match.size(); ++idx) {
-	if(match[idx]<0 || match[idx]>=(int)jets->size()) {
-	  invalidMatch=true;
-	  break;
-	}
-      }
+    event.getByToken(matchToken_, matches);
+    for(std::vector<std::vector<int> >::const_iterator match = matches->begin(); match != matches->end() && match-matches->begin() < (int)maxNMatch_; ++match) {
+      // check if match is valid
+      bool valid = (match->size()==nPartons);
+      for(unsigned int idx=0; valid && idx<match->size(); ++idx)
+	valid = ((*match)[idx]>=0 && (*match)[idx]<(int)jets->size());
+      if(valid) validMatches.push_back(*match);
     }
-    /// set match to be used
-    kinFitter->setMatch(match);
+    invalidMatch = validMatches.empty();
+    /// set matches to be used
+    kinFitter->setMatches(validMatches);
   }
 
   /// set the validity of a match
   kinFitter->setMatchInvalidity(invalidMatch);
 
-  std::list<TtFullHadKinFitter::KinFitResult> fitResults = kinFitter->fit(*jets);
+  // the jet collection stays in the event until produce
+  const std::vector<pat::Jet>* jetCollection = jets.product();
+  if(offloadMinFits_>0 && globalCache()->offload.enabled()){
+    unsigned int nBTags = 0;
+    for(std::vector<pat::Jet>::const_iterator jet = jets->begin(); jet != jets->end(); ++jet)
+      if(jet->bDiscriminator(bTagAlgo_) >= minBTagValueBJet_) ++nBTags;
+    if(TopKinFitterCost::fullHadFits(jets->size(), nBTags, maxNJets_, useBTagging_, bTags_, useOnlyMatch_, validMatches.size()) >= offloadMinFits_){
+      globalCache()->offload.push([this, jetCollection, holder]() mutable {
+	  std::exception_ptr error;
+	  try{
+	    fitResults_ = kinFitter->fit(*jetCollection);
+	  }
+	  catch(...){
+	    error = std::current_exception();
+	  }
+	  holder.doneWaiting(error);
+	});
+      return;
+    }
+  }
+  fitResults_ = kinFitter->fit(*jetCollection);
+}
+
+/// produce fitted object collections and meta data describing fit quality
+void 
+TtFullHadKinFitProducer::produce(edm::Event& event, const edm::EventSetup& setup)
+{
+  const std::list<TtFullHadKinFitter::KinFitResult>& fitResults = fitResults_;
+
+  // all jet combinations were fitted within the budget
+  std::unique_ptr<bool> pExhaustive( new bool(kinFitter->exhaustive()) );
+
+  if(compactResults_ || pullResults_){
+    unsigned int nComb = fitResults.size();
+    if(maxNComb_>=1 && nComb>(unsigned int)maxNComb_) nComb = maxNComb_;
+    if(compactResults_){
+      // one entry per combination with the fitted objects in the order of TopKinFitResults::FullHadRole
+      std::unique_ptr<TopKinFitResults> pCompact( new TopKinFitResults(TopKinFitResults::kNFullHadRoles, TtFullHadTopology::nPartons) );
+      pCompact->reserve(nComb);
+      std::list<TtFullHadKinFitter::KinFitResult>::const_iterator res = fitResults.begin();
+      for(unsigned int iComb=0; iComb<nComb; ++iComb, ++res){
+	pCompact->push_back(fittedObjects(*res), res->JetCombi, res->Chi2, res->Prob, res->Status, res->Residual);
+      }
+      event.put(std::move(pCompact), "Compact");
+    }
+    if(pullResults_){
+      // all fitted objects are measured by the jets of the combination
+      std::vector<int> roleJets(TopKinFitResults::kNFullHadRoles);
+      roleJets[TopKinFitResults::kB        ] = TtFullHadEvtPartons::B;
+      roleJets[TopKinFitResults::kBBar     ] = TtFullHadEvtPartons::BBar;
+      roleJets[TopKinFitResults::kLightQ   ] = TtFullHadEvtPartons::LightQ;
+      roleJets[TopKinFitResults::kLightQBar] = TtFullHadEvtPartons::LightQBar;
+      roleJets[TopKinFitResults::kLightP   ] = TtFullHadEvtPartons::LightP;
+      roleJets[TopKinFitResults::kLightPBar] = TtFullHadEvtPartons::LightPBar;
+      edm::Handle<std::vector<pat::Jet> > jets;
+      event.getByToken(jetsToken_, jets);
+      std::unique_ptr<TopKinFitPulls> pPulls( new TopKinFitPulls(roleJets, TtFullHadTopology::nPartons) );
+      pPulls->reserve(nComb);
+      std::vector<const reco::Candidate*> measured(TopKinFitResults::kNFullHadRoles);
+      std::list<TtFullHadKinFitter::KinFitResult>::const_iterator res = fitResults.begin();
+      for(unsigned int iComb=0; iComb<nComb; ++iComb, ++res){
+	for(unsigned int role=0; role<roleJets.size(); ++role)
+	  measured[role] = (res->JetCombi[roleJets[role]]>=0 ? &(*jets)[res->JetCombi[roleJets[role]]] : 0);
+	pPulls->push_back(fittedObjects(*res), measured, res->JetCombi, res->Chi2, res->Prob, res->Status, res->Residual);
+      }
+      event.put(std::move(pPulls), "Pulls");
+    }
+    event.put(std::move(pExhaustive), "Exhaustive");
+    return;
+  }
 
   // pointer for output collections
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsB( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsBBar( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsLightQ   ( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsLightQBar( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsLightP   ( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsLightPBar( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsB( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsBBar( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsLightQ   ( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsLightQBar( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsLightP   ( new std::vector<pat::Particle> );
+  std::unique_ptr< std::vector<pat::Particle> > pPartonsLightPBar( new std::vector<pat::Particle> );
   // pointer for meta information
-  std::auto_ptr< std::vector<std::vector<int> > > pCombi ( new std::vector<std::vector<int> > );
-  std::auto_ptr< std::vector<double> > pChi2  ( new std::vector<double> );
-  std::auto_ptr< std::vector<double> > pProb  ( new std::vector<double> );
-  std::auto_ptr< std::vector<int> > pStatus( new std::vector<int> );
+  std::unique_ptr< std::vector<std::vector<int> > > pCombi ( new std::vector<std::vector<int> > );
+  std::unique_ptr< std::vector<double> > pChi2  ( new std::vector<double> );
+  std::unique_ptr< std::vector<double> > pProb  ( new std::vector<double> );
+  std::unique_ptr< std::vector<int> > pStatus( new std::vector<int> );
+  std::unique_ptr< std::vector<double> > pResidual( new std::vector<double> );
 
   unsigned int iComb = 0;
   for(std::list<TtFullHadKinFitter::KinFitResult>::const_iterator res = fitResults.begin(); res != fitResults.end(); ++res){
@@ -129,19 +269,47 @@ TtFullHadKinFitProducer::produce(edm::Event& event, const edm::EventSetup& setup
     pChi2  ->push_back( res->Chi2     );
     pProb  ->push_back( res->Prob     );
     pStatus->push_back( res->Status   );
+    pResidual->push_back( res->Residual );
 
   }
 
-  event.put(pCombi);
-  event.put(pPartonsB        , "PartonsB"        );
-  event.put(pPartonsBBar     , "PartonsBBar"     );
-  event.put(pPartonsLightQ   , "PartonsLightQ"   );
-  event.put(pPartonsLightQBar, "PartonsLightQBar");
-  event.put(pPartonsLightP   , "PartonsLightP"   );
-  event.put(pPartonsLightPBar, "PartonsLightPBar");
-  event.put(pChi2   , "Chi2"   );
-  event.put(pProb   , "Prob"   );
-  event.put(pStatus , "Status" );
+  event.put(std::move(pCombi));
+  event.put(std::move(pPartonsB)        , "PartonsB"        );
+  event.put(std::move(pPartonsBBar)     , "PartonsBBar"     );
+  event.put(std::move(pPartonsLightQ)   , "PartonsLightQ"   );
+  event.put(std::move(pPartonsLightQBar), "PartonsLightQBar");
+  event.put(std::move(pPartonsLightP)   , "PartonsLightP"   );
+  event.put(std::move(pPartonsLightPBar), "PartonsLightPBar");
+  event.put(std::move(pChi2)   , "Chi2"   );
+  event.put(std::move(pProb)   , "Prob"   );
+  event.put(std::move(pStatus) , "Status" );
+  event.put(std::move(pResidual), "ConstraintResidual");
+  event.put(std::move(pExhaustive), "Exhaustive");
+}
+
+/// add the fit statistics of this stream to the summary
+void
+TtFullHadKinFitProducer::endStream()
+{
+  std::ostringstream table;
+  kinFitter->tuning().print(table, "TtFullHadKinFitter");
+  if(keepUnconverged_)
+    table << "  TtFullHadKinFitter: " << kinFitter->fitStats().nFits(TopKinFitterStats::kMaxIterations)
+	  << " fits stopped at maxNrIter and were kept with their last iterate\n";
+  globalCache()->summary.add(stream_, kinFitter->fitStats(), kinFitter->pruning(), kinFitter->beamSearch(),
+			     kinFitter->cost(), kinFitter->preselection(), table.str());
+}
+
+/// print the fit statistics of all streams
+void
+TtFullHadKinFitProducer::globalEndJob(const TopKinFitterGlobalCache* cache)
+{
+  std::ostringstream table;
+  cache->summary.print(table, "TtFullHadKinFitter");
+  edm::LogVerbatim("TtFullHadKinFitProducer") << table.str();
+
+  if(!cache->summary.printJSON("TtFullHadKinFitter"))
+    edm::LogWarning("TtFullHadKinFitProducer") << "Cannot open file '" << cache->summary.fitStatsJSON() << "' to write the fit statistics.";
 }
 
 #include "FWCore/Framework/interface/MakerMacros.h"
@@ -1,11 +1,19 @@
 #ifndef TtFullHadKinFitProducer_h
 #define TtFullHadKinFitProducer_h
 
+#include <memory>
+#include <utility>
+#include <fstream>
+
 #include "FWCore/Framework/interface/Event.h"
-#include "FWCore/Framework/interface/EDProducer.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Concurrency/interface/WaitingTaskWithArenaHolder.h"
 
 #include "TopQuarkAnalysis/TopKinFitter/interface/TtFullHadKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterGlobalCache.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitResults.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitPulls.h"
 #include "AnalysisDataFormats/TopObjects/interface/TtFullHadEvtPartons.h"
 
 /*
@@ -16,29 +24,46 @@
   Get jet collection and if wanted match from the event content and do the kinematic fit
   of the event with this objects using the kinFit class from TtFullHadKinFitter and put
   the result into the event content
+
+  Every stream has its own instance with its own fitter; the fit statistics and reports
+  of the streams are collected in a TopKinFitterJobSummary shared by all of them. The fit
+  is done in the acquire step (external work): events with large combinatorics can be
+  handed to dedicated threads shared by the streams, which frees the framework thread
+  until the result is put into the event.
   
 **/
 
-class TtFullHadKinFitProducer : public edm::EDProducer {
+class TtFullHadKinFitProducer : public edm::stream::EDProducer<edm::GlobalCache<TopKinFitterGlobalCache>, edm::ExternalWork> {
   
  public:
   /// default constructor  
-  explicit TtFullHadKinFitProducer(const edm::ParameterSet& cfg);
+  explicit TtFullHadKinFitProducer(const edm::ParameterSet& cfg, const TopKinFitterGlobalCache* cache);
   /// default destructor
   ~TtFullHadKinFitProducer();
+
+  /// create the summary and the dedicated threads shared by the streams
+  static std::unique_ptr<TopKinFitterGlobalCache> initializeGlobalCache(const edm::ParameterSet& cfg);
+  /// print the fit statistics of all streams
+  static void globalEndJob(const TopKinFitterGlobalCache* cache);
   
  private:
+  /// get the inputs and do the fit, on the dedicated threads for large combinatorics
+  virtual void acquire(const edm::Event& event, const edm::EventSetup& setup, edm::WaitingTaskWithArenaHolder holder) override;
   /// produce fitted object collections and meta data describing fit quality
-  virtual void produce(edm::Event& event, const edm::EventSetup& setup);
+  virtual void produce(edm::Event& event, const edm::EventSetup& setup) override;
+  /// add the fit statistics of this stream to the summary
+  virtual void endStream() override;
 
  private:
-  /// input tag for jets
-  edm::InputTag jets_;
-  /// input tag for matches (in case the fit should be performed on certain matches)
-  edm::InputTag match_;
+  /// token for jets
+  edm::EDGetTokenT<std::vector<pat::Jet> > jetsToken_;
+  /// token for matches (in case the fit should be performed on certain matches)
+  edm::EDGetTokenT<std::vector<std::vector<int> > > matchToken_;
   /// switch to tell whether all possible combinations should be used for the fit 
   /// or only a certain combination
   bool useOnlyMatch_;
+  /// number of combinations taken from the beginning of the match collection
+  unsigned int maxNMatch_;
   /// input tag for b-tagging algorithm
   std::string bTagAlgo_;
   /// min value of bTag for a b-jet
@@ -55,12 +80,44 @@ class TtFullHadKinFitProducer : public edm::EDProducer {
   int maxNJets_;
   /// maximal number of combinations to be written to the event
   int maxNComb_;
+  /// export the fitted covariance matrices for the combinations written to the event
+  bool exportFitCovariance_;
+  /// number of threads to distribute the fits of the jet combinations of an event over
+  unsigned int numThreads_;
+  /// maximal number of jet combinations fitted per event, sub-fits of sides or triplets not counted (0 for no limit)
+  unsigned int maxNFittedCombis_;
+  /// maximal wall time for the fits of an event in seconds (0 for no limit)
+  double maxFitTime_;
+  /// fit the jet triplets of the two top branches once per event
+  bool factoriseFits_;
+  /// maximal pull of the W candidates (0 for no cut)
+  double maxWPull_;
+  /// every n-th event the combinations failing the W pull cut are fitted for validation (0 for never)
+  unsigned int wPullValidationPrescale_;
+  /// width of the beam of the approximate search (0 for all combinations)
+  unsigned int beamWidth_;
+  /// every n-th event all combinations are fitted to validate the beam search (0 for never)
+  unsigned int beamValidationPrescale_;
+  /// report the predicted against the actual number of fits per event
+  bool costReport_;
+  /// minimal predicted number of fits for an event to be fitted on the dedicated threads (0 for never)
+  unsigned int offloadMinFits_;
+  /// write the fit results as one TopKinFitResults product instead of the separate collections
+  bool compactResults_;
+  /// write the fit results as one TopKinFitPulls product, encoded relative to the input jets
+  bool pullResults_;
+  /// choose the maxNJets jets by their ranks in pt and in the b-tag discriminator
+  bool jetPreselection_;
+  /// weight of the rank in the b-tag discriminator in the jet preselection
+  double jetPreselectionBTagWeight_;
   /// maximal number of iterations to be performed for the fit
   unsigned int maxNrIter_;
   /// maximal chi2 equivalent
   double maxDeltaS_;
   /// maximal deviation for contstraints
   double maxF_;
+  /// keep fits that stopped at the maximal number of iterations
+  bool keepUnconverged_;
   /// numbering of different possible jet parametrizations
   unsigned int jetParam_;
   /// numbering of different possible kinematic constraints
@@ -74,6 +131,13 @@ class TtFullHadKinFitProducer : public edm::EDProducer {
   /// scale factors for jet energy resolution
   std::vector<double> jetEnergyResolutionScaleFactors_;
   std::vector<double> jetEnergyResolutionEtaBinning_;
+  /// file to record the fit inputs to (empty for none; streams after the first append their index)
+  std::string fitInputDump_;
+  std::ofstream fitInputDumpFile_;
+  /// index of the stream in the job summary
+  unsigned int stream_;
+  /// fit results of the current event, from acquire to produce
+  std::list<TtFullHadKinFitter::KinFitResult> fitResults_;
 
  public:
 
@@ -5,12 +5,13 @@
 // $Id: TtFullLepKinSolutionProducer.h,v 1.9 2010/05/20 13:44:09 snaumann Exp $
 //
 #include <memory>
+#include <utility>
 #include <string>
 #include <vector>
 #include "TLorentzVector.h"
 #include "DataFormats/Math/interface/deltaR.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
-#include "FWCore/Framework/interface/EDProducer.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include "FWCore/Utilities/interface/InputTag.h"
@@ -18,16 +19,15 @@
 #include "TopQuarkAnalysis/TopKinFitter/interface/TtFullLepKinSolver.h"
 
 
-class TtFullLepKinSolutionProducer : public edm::EDProducer {
+// every stream has its own instance with its own solver
+class TtFullLepKinSolutionProducer : public edm::stream::EDProducer<> {
 
   public:
 
     explicit TtFullLepKinSolutionProducer(const edm::ParameterSet & iConfig);
     ~TtFullLepKinSolutionProducer();
     
-    virtual void beginJob();
-    virtual void produce(edm::Event & evt, const edm::EventSetup & iSetup);
-    virtual void endJob();
+    virtual void produce(edm::Event & evt, const edm::EventSetup & iSetup) override;
 
   private:  
 
@@ -42,10 +42,10 @@ class TtFullLepKinSolutionProducer : public edm::EDProducer {
       } 
     };
     
-    edm::InputTag jets_;
-    edm::InputTag electrons_;
-    edm::InputTag muons_;
-    edm::InputTag mets_;
+    edm::EDGetTokenT<std::vector<pat::Jet> > jetsToken_;
+    edm::EDGetTokenT<std::vector<pat::Electron> > electronsToken_;
+    edm::EDGetTokenT<std::vector<pat::Muon> > muonsToken_;
+    edm::EDGetTokenT<std::vector<pat::MET> > metsToken_;
 
     std::string jetCorrLevel_;
     int maxNJets_, maxNComb_;
@@ -53,7 +53,7 @@ class TtFullLepKinSolutionProducer : public edm::EDProducer {
     double tmassbegin_, tmassend_, tmassstep_;
     std::vector<double> nupars_;
     
-    TtFullLepKinSolver* solver;
+    std::unique_ptr<TtFullLepKinSolver> solver;
 };
 
 inline bool TtFullLepKinSolutionProducer::PTComp(const reco::Candidate* l1, const reco::Candidate* l2) const 
@@ -74,10 +74,10 @@ inline bool TtFullLepKinSolutionProducer::HasPositiveCharge(const reco::Candidat
 TtFullLepKinSolutionProducer::TtFullLepKinSolutionProducer(const edm::ParameterSet & iConfig) 
 {
   // configurables
-  jets_        = iConfig.getParameter<edm::InputTag>("jets");
-  electrons_   = iConfig.getParameter<edm::InputTag>("electrons");
-  muons_       = iConfig.getParameter<edm::InputTag>("muons");
-  mets_        = iConfig.getParameter<edm::InputTag>("mets");
+  jetsToken_      = consumes<std::vector<pat::Jet> >     (iConfig.getParameter<edm::InputTag>("jets"));
+  electronsToken_ = consumes<std::vector<pat::Electron> >(iConfig.getParameter<edm::InputTag>("electrons"));
+  muonsToken_     = consumes<std::vector<pat::Muon> >    (iConfig.getParameter<edm::InputTag>("muons"));
+  metsToken_      = consumes<std::vector<pat::MET> >     (iConfig.getParameter<edm::InputTag>("mets"));
   jetCorrLevel_= iConfig.getParameter<std::string>  ("jetCorrectionLevel");  
   maxNJets_       = iConfig.getParameter<int> ("maxNJets");
   maxNComb_       = iConfig.getParameter<int> ("maxNComb");  
@@ -89,6 +89,9 @@ TtFullLepKinSolutionProducer::TtFullLepKinSolutionProducer(const edm::ParameterS
   tmassend_         = iConfig.getParameter<double>("tmassend");
   tmassstep_        = iConfig.getParameter<double>("tmassstep");
   nupars_           = iConfig.getParameter<std::vector<double> >("neutrino_parameters");
+
+  // the solver keeps per-event state, it is owned by the stream
+  solver.reset(new TtFullLepKinSolver(tmassbegin_, tmassend_, tmassstep_, nupars_));
   
   // define what will be produced
   produces<std::vector<std::vector<int> > >  (); // vector of the particle inices (b, bbar, e1, e2, mu1, mu2)
@@ -102,16 +105,6 @@ TtFullLepKinSolutionProducer::~TtFullLepKinSolutionProducer()
 {
 }
 
-void TtFullLepKinSolutionProducer::beginJob()
-{
-  solver = new TtFullLepKinSolver(tmassbegin_, tmassend_, tmassstep_, nupars_);
-}
-
-void TtFullLepKinSolutionProducer::endJob()
-{
-  delete solver;
-}
-
 void TtFullLepKinSolutionProducer::produce(edm::Event & evt, const edm::EventSetup & iSetup) 
 {    
   //create vectors fo runsorted output
@@ -121,20 +114,20 @@ void TtFullLepKinSolutionProducer::produce(edm::Event & evt, const edm::EventSet
   std::vector<std::pair<double, int> > weightsV;
 
   //create pointer for products
-  std::auto_ptr<std::vector<std::vector<int> > >   pIdcs(new std::vector<std::vector<int> >);
-  std::auto_ptr<std::vector<reco::LeafCandidate> > pNus(new std::vector<reco::LeafCandidate>);
-  std::auto_ptr<std::vector<reco::LeafCandidate> > pNuBars(new std::vector<reco::LeafCandidate>);
-  std::auto_ptr<std::vector<double> >              pWeight(new std::vector<double>);  
-  std::auto_ptr<bool> pWrongCharge(new bool);  
+  std::unique_ptr<std::vector<std::vector<int> > >   pIdcs(new std::vector<std::vector<int> >);
+  std::unique_ptr<std::vector<reco::LeafCandidate> > pNus(new std::vector<reco::LeafCandidate>);
+  std::unique_ptr<std::vector<reco::LeafCandidate> > pNuBars(new std::vector<reco::LeafCandidate>);
+  std::unique_ptr<std::vector<double> >              pWeight(new std::vector<double>);  
+  std::unique_ptr<bool> pWrongCharge(new bool);  
     
   edm::Handle<std::vector<pat::Jet> > jets;
-  evt.getByLabel(jets_, jets);
+  evt.getByToken(jetsToken_, jets);
   edm::Handle<std::vector<pat::Electron> > electrons;
-  evt.getByLabel(electrons_, electrons);
+  evt.getByToken(electronsToken_, electrons);
   edm::Handle<std::vector<pat::Muon> > muons;
-  evt.getByLabel(muons_, muons);
+  evt.getByToken(muonsToken_, muons);
   edm::Handle<std::vector<pat::MET> > mets;
-  evt.getByLabel(mets_, mets);
+  evt.getByToken(metsToken_, mets);
   
   int selMuon1 = -1, selMuon2 = -1;
   int selElectron1 = -1, selElectron2 = -1;
@@ -460,11 +453,11 @@ void TtFullLepKinSolutionProducer::produce(edm::Event & evt, const edm::EventSet
   }
            
   // put the results in the event
-  evt.put(pIdcs);     
-  evt.put(pNus,         "fullLepNeutrinos");  
-  evt.put(pNuBars,      "fullLepNeutrinoBars");             
-  evt.put(pWeight,      "solWeight");  
-  evt.put(pWrongCharge, "isWrongCharge"); 
+  evt.put(std::move(pIdcs));     
+  evt.put(std::move(pNus),         "fullLepNeutrinos");  
+  evt.put(std::move(pNuBars),      "fullLepNeutrinoBars");             
+  evt.put(std::move(pWeight),      "solWeight");  
+  evt.put(std::move(pWrongCharge), "isWrongCharge"); 
 }
 
 #endif
@@ -1,25 +1,65 @@
 #ifndef TtSemiLepKinFitProducer_h
 #define TtSemiLepKinFitProducer_h
 
+#include <map>
+#include <set>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
 #include "FWCore/Framework/interface/Event.h"
-#include "FWCore/Framework/interface/EDProducer.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Concurrency/interface/WaitingTaskWithArenaHolder.h"
 
-#include "PhysicsTools/JetMCUtils/interface/combination.h"
 #include "AnalysisDataFormats/TopObjects/interface/TtSemiLepEvtPartons.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/JetCombinationGenerator.h"
 #include "TopQuarkAnalysis/TopKinFitter/interface/TtSemiLepKinFitter.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTuning.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterRecord.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterThreadPool.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTopK.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterBeamSearch.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJetPreselection.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterGlobalCache.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitResults.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitPulls.h"
 
+// every stream has its own instance with its own fitters; the fit statistics
+// and reports of the streams are collected in the shared TopKinFitterJobSummary.
+// The fit is done in the acquire step (external work): events with large
+// combinatorics can be handed to dedicated threads shared by the streams,
+// which frees the framework thread until the result is put into the event
 template <typename LeptonCollection>
-class TtSemiLepKinFitProducer : public edm::EDProducer {
+class TtSemiLepKinFitProducer : public edm::stream::EDProducer<edm::GlobalCache<TopKinFitterGlobalCache>, edm::ExternalWork> {
   
  public:
   
-  explicit TtSemiLepKinFitProducer(const edm::ParameterSet&);
+  explicit TtSemiLepKinFitProducer(const edm::ParameterSet&, const TopKinFitterGlobalCache*);
   ~TtSemiLepKinFitProducer();
+
+  // create the summary and the dedicated threads shared by the streams
+  static std::unique_ptr<TopKinFitterGlobalCache> initializeGlobalCache(const edm::ParameterSet&);
+  // print the fit statistics of all streams
+  static void globalEndJob(const TopKinFitterGlobalCache*);
   
  private:
-  // produce
-  virtual void produce(edm::Event&, const edm::EventSetup&);
+  // get the inputs and do the fit, on the dedicated threads for large combinatorics
+  virtual void acquire(const edm::Event&, const edm::EventSetup&, edm::WaitingTaskWithArenaHolder) override;
+  // put the products of the fit into the event
+  virtual void produce(edm::Event&, const edm::EventSetup&) override;
+  // do the fit of the current event and fill the products
+  void fitEvent();
+  // fitted objects of combination i in the order of TopKinFitResults::SemiLepRole
+  std::vector<const reco::Candidate*> fittedObjects(const unsigned int i) const;
+  // add the fit statistics of this stream to the summary
+  virtual void endStream() override;
 
   // convert unsigned to Param
   TtSemiLepKinFitter::Param param(unsigned);
@@ -27,17 +67,39 @@ class TtSemiLepKinFitProducer : public edm::EDProducer {
   TtSemiLepKinFitter::Constraint constraint(unsigned);
   // convert unsigned to Param
   std::vector<TtSemiLepKinFitter::Constraint> constraints(std::vector<unsigned>&);
-  // helper function for b-tagging
-  bool doBTagging(bool& useBTag_, edm::Handle<std::vector<pat::Jet> >& jets, std::vector<int>& combi,
-		  std::string& bTagAlgo_, double& minBTagValueBJets_, double& maxBTagValueNonBJets_);
+  // restrict the jet assignments to those compatible with the b-tagging
+  void setupBTagging(const std::vector<pat::Jet>& jets, JetCombinationGenerator<TtSemiLepTopology>& combinations);
+  // order the jet combinations by the compatibility of their hadronic W and top candidates with mW and mTop (best first)
+  void orderCombinations(const std::vector<pat::Jet>& jets, std::vector<std::vector<int> >& combis);
 
-  edm::InputTag jets_;
-  edm::InputTag leps_;
-  edm::InputTag mets_;
+  /// per-event inputs for the mass pulls of the jet combinations
+  struct MassPulls {
+    /// 4-vectors and relative energy resolutions of the jets as light and as b jets
+    std::vector<TLorentzVector> p4s;
+    std::vector<double> lightRes, bRes;
+    /// leptonic top candidates and their uncertainty per b jet and neutrino solution
+    std::vector<std::vector<double> > lepTop, lepTopSigma;
+  };
+  // fill the per-event inputs for the mass pulls
+  void fillMassPulls(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met, MassPulls& pulls);
+  // sum of the squared pulls of the given masses of a jet combination, for the better neutrino solution; masses
+  // with unassigned partons (-1) do not contribute. It estimates the minimal chi2 for the constrained masses
+  double massChi2(const MassPulls& pulls, const std::vector<int>& combi, const std::vector<TtSemiLepKinFitter::Constraint>& masses) const;
+
+  edm::EDGetTokenT<std::vector<pat::Jet> > jetsToken_;
+  edm::EDGetTokenT<LeptonCollection> lepsToken_;
+  edm::EDGetTokenT<std::vector<pat::MET> > metsToken_;
   
-  edm::InputTag match_;
+  edm::EDGetTokenT<std::vector<std::vector<int> > > matchToken_;
+  /// inputs of the current event, from acquire to the fit
+  edm::Handle<std::vector<pat::Jet> > jetsHandle_;
+  edm::Handle<LeptonCollection> lepsHandle_;
+  edm::Handle<std::vector<pat::MET> > metsHandle_;
+  edm::Handle<std::vector<std::vector<int> > > matchHandle_;
   /// switch to use only a combination given by another hypothesis
   bool useOnlyMatch_;
+  /// number of combinations taken from the beginning of the match collection
+  unsigned int maxNMatch_;
   /// input tag for b-tagging algorithm
   std::string bTagAlgo_;
   /// min value of bTag for a b-jet
@@ -48,8 +110,12 @@ class TtSemiLepKinFitProducer : public edm::EDProducer {
   bool useBTag_;
   /// maximal number of jets (-1 possible to indicate 'all')
   int maxNJets_;
+  /// choice of the maxNJets jets to be considered
+  TopKinFitterJetPreselection preselection_;
   /// maximal number of combinations to be written to the event
   int maxNComb_;
+  /// export the fitted covariance matrices for the combinations written to the event
+  bool exportFitCovariance_;
 
   /// maximal number of iterations to be performed for the fit
   unsigned int maxNrIter_;
@@ -57,9 +123,13 @@ class TtSemiLepKinFitProducer : public edm::EDProducer {
   double maxDeltaS_;
   /// maximal deviation for contstraints
   double maxF_;
+  /// keep fits that stopped at the maximal number of iterations
+  bool keepUnconverged_;
   unsigned int jetParam_;
   unsigned int lepParam_;
   unsigned int metParam_;
+  /// keep the lepton as fixed 4-vector in the mass constraints
+  bool fixLepton_;
   /// constrains
   std::vector<unsigned> constraints_;
   double mW_;
@@ -72,13 +142,53 @@ class TtSemiLepKinFitProducer : public edm::EDProducer {
   std::vector<edm::ParameterSet> bResolutions_;
   std::vector<edm::ParameterSet> lepResolutions_;
   std::vector<edm::ParameterSet> metResolutions_;
+  /// adaptive limit on the number of iterations
+  TopKinFitterTuning tuning_;
+  /// file to record the fit inputs to (empty for none; streams after the first append their index)
+  std::string fitInputDump_;
+  std::ofstream fitInputDumpFile_;
+  /// index of the stream in the job summary
+  unsigned int stream_;
+  /// threads for the fits of the jet combinations of an event
+  TopKinFitterThreadPool pool_;
+  /// maximal number of jet combinations fitted per event, sub-fits of sides or triplets not counted (0 for no limit)
+  unsigned int maxNFittedCombis_;
+  /// maximal wall time for the fits of an event in seconds (0 for no limit)
+  double maxFitTime_;
+  /// lower bound on the chi2 used to order the fits and to skip combinations
+  enum Chi2Bound { kNoBound, kEstimatedBound, kFittedBound };
+  unsigned int chi2Bound_;
+  /// the constraints couple the hadronic and the leptonic side
+  bool coupled_;
+  /// the chi2 is the sum of the separate fits of the two sides
+  bool factorised_;
+  /// approximate search for the best jet assignment
+  TopKinFitterBeamSearch beamSearch_;
+  /// predicted against actual number of fits per event
+  TopKinFitterCost cost_;
+  /// minimal predicted number of fits for an event to be fitted on the dedicated threads (0 for never)
+  unsigned int offloadMinFits_;
+  /// write the fit results as one TopKinFitResults product instead of the separate collections
+  bool compactResults_;
+  /// write the fit results as one TopKinFitPulls product, encoded relative to the input objects
+  bool pullResults_;
+  /// resolutions for the mass pulls
+  CovarianceMatrix* covM_;
 
   TtSemiLepKinFitter* fitter;
+  /// additional fitters for the worker threads (the calling thread uses fitter)
+  std::vector<TtSemiLepKinFitter*> workers_;
+  /// fitters for the separate fits of the hadronic and the leptonic side per thread (if
+  /// factorised, or with the coupling constraints dropped for kFittedBound; none for a
+  /// side without constraints)
+  std::vector<TtSemiLepKinFitter*> hadFitters_;
+  std::vector<TtSemiLepKinFitter*> lepFitters_;
 
   struct KinFitResult {
     int Status;
     double Chi2;
     double Prob;
+    double Residual;
     pat::Particle HadB;
     pat::Particle HadP;
     pat::Particle HadQ;
@@ -88,34 +198,118 @@ class TtSemiLepKinFitProducer : public edm::EDProducer {
     std::vector<int> JetCombi;
     bool operator< (const KinFitResult& rhs) { return Chi2 < rhs.Chi2; };
   };
+
+  /// outcome of the fit of a single jet combination on one of the threads
+  struct CombiFit {
+    bool fitted;
+    bool pruned;
+    bool offBeam;
+    int status;
+    double chi2;
+    bool hasResult;
+    /// converged only when repeated with the configured iteration limit, with rescuedChi2
+    bool rescued;
+    double rescuedChi2;
+  };
+  /// outcome of the separate fit of the hadronic (particles HadP, HadQ, HadB)
+  /// or of the leptonic side (particles LepB, lepton, neutrino)
+  struct SubFit {
+    bool fitted;
+    int status;
+    double chi2;
+    double residual;
+    int ndf;
+    bool hasResult;
+    bool rescued;
+    double rescuedChi2;
+    pat::Particle particles[3];
+  };
+  /// best maxNComb fit results per thread
+  std::vector<TopKinFitterTopK<KinFitResult> > bestResults_;
+
+  /// products of the current event, from the fit to produce
+  struct Products {
+    std::unique_ptr< std::vector<pat::Particle> > pPartonsHadP;
+    std::unique_ptr< std::vector<pat::Particle> > pPartonsHadQ;
+    std::unique_ptr< std::vector<pat::Particle> > pPartonsHadB;
+    std::unique_ptr< std::vector<pat::Particle> > pPartonsLepB;
+    std::unique_ptr< std::vector<pat::Particle> > pLeptons;
+    std::unique_ptr< std::vector<pat::Particle> > pNeutrinos;
+    std::unique_ptr< std::vector<std::vector<int> > > pCombi;
+    std::unique_ptr< std::vector<double> > pChi2;
+    std::unique_ptr< std::vector<double> > pProb;
+    std::unique_ptr< std::vector<int> > pStatus;
+    std::unique_ptr< std::vector<double> > pResidual;
+    std::unique_ptr<int> pJetsConsidered;
+    /// all jet combinations were fitted within the budget
+    std::unique_ptr<bool> pExhaustive;
+  };
+  Products products_;
+
+  // fit the hadronic and the leptonic side of the jet combinations separately, each distinct
+  // hadronic jet triplet and leptonic b jet only once; hadOf and lepOf give the fit per combination
+  void fitSides(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met,
+		const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+		std::vector<SubFit>& hadFits, std::vector<SubFit>& lepFits, std::vector<unsigned int>& hadOf, std::vector<unsigned int>& lepOf);
+  // fit the two sides separately and combine them (results in bestResults_[0])
+  void fitFactorised(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met,
+		     const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+		     std::vector<CombiFit>& fits);
 };
 
 template<typename LeptonCollection>
-TtSemiLepKinFitProducer<LeptonCollection>::TtSemiLepKinFitProducer(const edm::ParameterSet& cfg):
-  jets_                    (cfg.getParameter<edm::InputTag>("jets")),
-  leps_                    (cfg.getParameter<edm::InputTag>("leps")),
-  mets_                    (cfg.getParameter<edm::InputTag>("mets")),
-  match_                   (cfg.getParameter<edm::InputTag>("match")),
+TtSemiLepKinFitProducer<LeptonCollection>::TtSemiLepKinFitProducer(const edm::ParameterSet& cfg, const TopKinFitterGlobalCache* cache):
+  jetsToken_               (consumes<std::vector<pat::Jet> >(cfg.getParameter<edm::InputTag>("jets"))),
+  lepsToken_               (consumes<LeptonCollection>(cfg.getParameter<edm::InputTag>("leps"))),
+  metsToken_               (consumes<std::vector<pat::MET> >(cfg.getParameter<edm::InputTag>("mets"))),
   useOnlyMatch_            (cfg.getParameter<bool>         ("useOnlyMatch"        )),
+  maxNMatch_               (cfg.getParameter<unsigned>     ("maxNMatch"           )),
   bTagAlgo_                (cfg.getParameter<std::string>  ("bTagAlgo"            )),
   minBTagValueBJet_        (cfg.getParameter<double>       ("minBDiscBJets"       )),
   maxBTagValueNonBJet_     (cfg.getParameter<double>       ("maxBDiscLightJets"   )),
   useBTag_                 (cfg.getParameter<bool>         ("useBTagging"         )),
   maxNJets_                (cfg.getParameter<int>          ("maxNJets"            )),
+  preselection_            (cfg.getParameter<bool>         ("jetPreselection"     ),
+			    cfg.getParameter<double>       ("jetPreselectionBTagWeight")),
   maxNComb_                (cfg.getParameter<int>          ("maxNComb"            )),
+  exportFitCovariance_     (cfg.getParameter<bool>         ("exportFitCovariance" )),
   maxNrIter_               (cfg.getParameter<unsigned>     ("maxNrIter"           )),
   maxDeltaS_               (cfg.getParameter<double>       ("maxDeltaS"           )),
   maxF_                    (cfg.getParameter<double>       ("maxF"                )),
+  keepUnconverged_         (cfg.getParameter<bool>         ("keepUnconverged"     )),
   jetParam_                (cfg.getParameter<unsigned>     ("jetParametrisation"  )),
   lepParam_                (cfg.getParameter<unsigned>     ("lepParametrisation"  )),
   metParam_                (cfg.getParameter<unsigned>     ("metParametrisation"  )),
+  fixLepton_               (cfg.getParameter<bool>         ("fixLepton"           )),
   constraints_             (cfg.getParameter<std::vector<unsigned> >("constraints")),
   mW_                      (cfg.getParameter<double>       ("mW"                  )),
   mTop_                    (cfg.getParameter<double>       ("mTop"                )),
   jetEnergyResolutionScaleFactors_(cfg.getParameter<std::vector<double> >("jetEnergyResolutionScaleFactors")),
   jetEnergyResolutionEtaBinning_  (cfg.getParameter<std::vector<double> >("jetEnergyResolutionEtaBinning")),
-  udscResolutions_(0), bResolutions_(0), lepResolutions_(0), metResolutions_(0)
+  udscResolutions_(0), bResolutions_(0), lepResolutions_(0), metResolutions_(0),
+  tuning_                  (cfg.getParameter<bool>         ("adaptiveMaxNrIter"   ),
+			    cfg.getParameter<unsigned>     ("adaptiveWarmUpFits"  ),
+			    cfg.getParameter<double>       ("adaptiveQuantile"    ), maxNrIter_,
+			    cfg.getParameter<unsigned>     ("adaptiveValidationPrescale")),
+  fitInputDump_            (cfg.getParameter<std::string>  ("fitInputDump"        )),
+  stream_                  (cache->summary.newStream()),
+  pool_                    (cfg.getParameter<unsigned>     ("numThreads"          )),
+  maxNFittedCombis_        (cfg.getParameter<unsigned>     ("maxNFittedCombis"    )),
+  maxFitTime_              (cfg.getParameter<double>       ("maxFitTime"          )),
+  chi2Bound_               (cfg.getParameter<unsigned>     ("chi2Bound"           )),
+  coupled_(false), factorised_(false),
+  beamSearch_              (cfg.getParameter<unsigned>     ("beamWidth"           ),
+			    cfg.getParameter<unsigned>     ("beamValidationPrescale")),
+  cost_                    (cfg.getParameter<bool>         ("costReport"          )),
+  offloadMinFits_          (cfg.getParameter<unsigned>     ("offloadMinFits"      )),
+  compactResults_          (cfg.getParameter<bool>         ("compactResults"      )),
+  pullResults_             (cfg.getParameter<bool>         ("pullResults"         )),
+  covM_(0)
 {
+  // the matches are only read if they are to be used
+  if(useOnlyMatch_)
+    matchToken_ = consumes<std::vector<std::vector<int> > >(cfg.getParameter<edm::InputTag>("match"));
+
   if(cfg.exists("udscResolutions") && cfg.exists("bResolutions") && cfg.exists("lepResolutions") && cfg.exists("metResolutions")){
     udscResolutions_ = cfg.getParameter<std::vector<edm::ParameterSet> >("udscResolutions");
     bResolutions_    = cfg.getParameter<std::vector<edm::ParameterSet> >("bResolutions"   );
@@ -128,93 +322,511 @@ TtSemiLepKinFitProducer<LeptonCollection>::TtSemiLepKinFitProducer(const edm::Pa
 
   fitter = new TtSemiLepKinFitter(param(jetParam_), param(lepParam_), param(metParam_), maxNrIter_, maxDeltaS_, maxF_,
 				  constraints(constraints_), mW_, mTop_, &udscResolutions_, &bResolutions_, &lepResolutions_, &metResolutions_,
-				  &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_);
+				  &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_, fixLepton_);
+  fitter->setKeepUnconverged(keepUnconverged_);
+  // one fit context per additional thread
+  for(unsigned int worker=1; worker<pool_.nThreads(); ++worker){
+    workers_.push_back(new TtSemiLepKinFitter(param(jetParam_), param(lepParam_), param(metParam_), maxNrIter_, maxDeltaS_, maxF_,
+					      constraints(constraints_), mW_, mTop_, &udscResolutions_, &bResolutions_, &lepResolutions_, &metResolutions_,
+					      &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_, fixLepton_));
+    workers_.back()->setKeepUnconverged(keepUnconverged_);
+  }
+  bestResults_.assign(pool_.nThreads(), TopKinFitterTopK<KinFitResult>(maxNComb_>=1 ? maxNComb_ : 0));
+
+  if(chi2Bound_>kFittedBound)
+    throw cms::Exception("Configuration") << "Chosen chi2 bound is not supported: " << chi2Bound_ << "\n";
+
+  // the hadronic and the leptonic side are only coupled by the equal top masses and the
+  // sum pt constraint; without them the chi2 is the sum of two independent fits, with
+  // them the sum of the fits without the coupling constraints is a lower bound
+  std::vector<TtSemiLepKinFitter::Constraint> hadConstraints, lepConstraints;
+  const std::vector<TtSemiLepKinFitter::Constraint> allConstraints = constraints(constraints_);
+  for(unsigned int i=0; i<allConstraints.size(); ++i){
+    switch(allConstraints[i]){
+    case TtSemiLepKinFitter::kWHadMass     :
+    case TtSemiLepKinFitter::kTopHadMass   : hadConstraints.push_back(allConstraints[i]); break;
+    case TtSemiLepKinFitter::kWLepMass     :
+    case TtSemiLepKinFitter::kTopLepMass   :
+    case TtSemiLepKinFitter::kNeutrinoMass : lepConstraints.push_back(allConstraints[i]); break;
+    default: coupled_ = true; break;
+    }
+  }
+  factorised_ = (cfg.getParameter<bool>("factoriseFits") && !coupled_ && !hadConstraints.empty() && !lepConstraints.empty());
+  if(factorised_ || chi2Bound_==kFittedBound){
+    // the MET does not enter the constraints of the hadronic fit (EtPhiPz would require one)
+    const TtSemiLepKinFitter::Param hadMetParam = (param(metParam_)==TtSemiLepKinFitter::kEtPhiPz ? TtSemiLepKinFitter::kEMom : param(metParam_));
+    for(unsigned int worker=0; worker<pool_.nThreads(); ++worker){
+      if(!hadConstraints.empty()){
+	hadFitters_.push_back(new TtSemiLepKinFitter(param(jetParam_), param(lepParam_), hadMetParam, maxNrIter_, maxDeltaS_, maxF_,
+						     hadConstraints, mW_, mTop_, &udscResolutions_, &bResolutions_, &lepResolutions_, &metResolutions_,
+						     &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_));
+	hadFitters_.back()->setKeepUnconverged(keepUnconverged_);
+      }
+      if(!lepConstraints.empty()){
+	lepFitters_.push_back(new TtSemiLepKinFitter(param(jetParam_), param(lepParam_), param(metParam_), maxNrIter_, maxDeltaS_, maxF_,
+						     lepConstraints, mW_, mTop_, &udscResolutions_, &bResolutions_, &lepResolutions_, &metResolutions_,
+						     &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_, fixLepton_));
+	lepFitters_.back()->setKeepUnconverged(keepUnconverged_);
+      }
+    }
+  }
+  if(chi2Bound_==kEstimatedBound || beamSearch_.enabled()){
+    if(udscResolutions_.size() && bResolutions_.size() && lepResolutions_.size() && metResolutions_.size())
+      covM_ = new CovarianceMatrix(udscResolutions_, bResolutions_, lepResolutions_, metResolutions_,
+				   jetEnergyResolutionScaleFactors_, jetEnergyResolutionEtaBinning_);
+    else
+      covM_ = new CovarianceMatrix();
+  }
 
-  produces< std::vector<pat::Particle> >("PartonsHadP");
-  produces< std::vector<pat::Particle> >("PartonsHadQ");
-  produces< std::vector<pat::Particle> >("PartonsHadB");
-  produces< std::vector<pat::Particle> >("PartonsLepB");
-  produces< std::vector<pat::Particle> >("Leptons");
-  produces< std::vector<pat::Particle> >("Neutrinos");
+  if(!fitInputDump_.empty()){
+    fitInputDump_ = TopKinFitterJobSummary::streamFileName(fitInputDump_, stream_);
+    fitInputDumpFile_.open(fitInputDump_.c_str());
+    if(!fitInputDumpFile_) throw cms::Exception("Configuration") << "Cannot open file '" << fitInputDump_ << "' to record the fit inputs.\n";
+  }
 
-  produces< std::vector<std::vector<int> > >();
-  produces< std::vector<double> >("Chi2");
-  produces< std::vector<double> >("Prob");
-  produces< std::vector<int> >("Status");
+  if(compactResults_){
+    produces<TopKinFitResults>("Compact");
+  }
+  if(pullResults_){
+    produces<TopKinFitPulls>("Pulls");
+  }
+  if(!compactResults_ && !pullResults_){
+    produces< std::vector<pat::Particle> >("PartonsHadP");
+    produces< std::vector<pat::Particle> >("PartonsHadQ");
+    produces< std::vector<pat::Particle> >("PartonsHadB");
+    produces< std::vector<pat::Particle> >("PartonsLepB");
+    produces< std::vector<pat::Particle> >("Leptons");
+    produces< std::vector<pat::Particle> >("Neutrinos");
+
+    produces< std::vector<std::vector<int> > >();
+    produces< std::vector<double> >("Chi2");
+    produces< std::vector<double> >("Prob");
+    produces< std::vector<int> >("Status");
+    produces< std::vector<double> >("ConstraintResidual");
+  }
 
   produces<int>("NumberOfConsideredJets");
+  produces<bool>("Exhaustive");
 }
 
 template<typename LeptonCollection>
 TtSemiLepKinFitProducer<LeptonCollection>::~TtSemiLepKinFitProducer()
 {
   delete fitter;
+  for(unsigned int i=0; i<workers_.size(); ++i)
+    delete workers_[i];
+  for(unsigned int i=0; i<hadFitters_.size(); ++i)
+    delete hadFitters_[i];
+  for(unsigned int i=0; i<lepFitters_.size(); ++i)
+    delete lepFitters_[i];
+  delete covM_;
 }
 
 template<typename LeptonCollection>
-bool TtSemiLepKinFitProducer<LeptonCollection>::doBTagging(bool& useBTag_, edm::Handle<std::vector<pat::Jet> >& jets, std::vector<int>& combi,
-							   std::string& bTagAlgo_, double& minBTagValueBJet_, double& maxBTagValueNonBJet_){
-  
-  if( !useBTag_ ) {
-    return true;
+void TtSemiLepKinFitProducer<LeptonCollection>::setupBTagging(const std::vector<pat::Jet>& jets, JetCombinationGenerator<TtSemiLepTopology>& combinations)
+{
+  if( !useBTag_ ) return;
+  // flag the jets once, both b partons need b-tagged jets, the light partons light jets
+  std::vector<bool> bTagged, light;
+  for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet != jets.end(); ++jet){
+    bTagged.push_back( jet->bDiscriminator(bTagAlgo_) >= minBTagValueBJet_    );
+    light  .push_back( jet->bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ );
   }
-  if( useBTag_ &&
-      (*jets)[combi[TtSemiLepEvtPartons::HadB     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-      (*jets)[combi[TtSemiLepEvtPartons::LepB     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-      (*jets)[combi[TtSemiLepEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-      (*jets)[combi[TtSemiLepEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-    return true;
+  combinations.setBTagging(bTagged, light, TtSemiLepTopology::nBPartons);
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::orderCombinations(const std::vector<pat::Jet>& jets, std::vector<std::vector<int> >& combis)
+{
+  // sum of the squared relative deviations of the hadronic candidate masses (the leptonic
+  // side is not constrained without the neutrino pz); equal scores keep the enumeration order
+  std::vector<std::pair<double, unsigned int> > scores;
+  for(unsigned int idx=0; idx<combis.size(); ++idx){
+    const std::vector<int>& combi = combis[idx];
+    const reco::Particle::LorentzVector w = jets[combi[TtSemiLepEvtPartons::LightQ]].p4() + jets[combi[TtSemiLepEvtPartons::LightQBar]].p4();
+    const double top = (w + jets[combi[TtSemiLepEvtPartons::HadB]].p4()).mass();
+    scores.push_back(std::make_pair(std::pow((w.mass()-mW_)/mW_, 2) + std::pow((top-mTop_)/mTop_, 2), idx));
   }
-  else{
-    return false;
+  std::sort(scores.begin(), scores.end());
+  std::vector<std::vector<int> > ordered;
+  ordered.reserve(combis.size());
+  for(unsigned int i=0; i<scores.size(); ++i)
+    ordered.push_back(combis[scores[i].second]);
+  combis.swap(ordered);
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::fillMassPulls(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met,
+								MassPulls& pulls)
+{
+  // 4-vectors and relative energy resolutions (approximated by those of the transverse
+  // energy) of the jets as light and as b jets, of the lepton and of the MET
+  pulls.p4s.clear();
+  pulls.lightRes.clear();
+  pulls.bRes.clear();
+  for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet != jets.end(); ++jet){
+    pulls.p4s.push_back(TLorentzVector(jet->px(), jet->py(), jet->pz(), jet->energy()));
+    const double et = (jet->et()>0. ? jet->et() : 1.);
+    pulls.lightRes.push_back(std::sqrt(covM_->setupMatrix(*jet, TopKinFitter::kEtEtaPhi         )(0,0))/et);
+    pulls.bRes    .push_back(std::sqrt(covM_->setupMatrix(*jet, TopKinFitter::kEtEtaPhi, "bjets")(0,0))/et);
   }
+  const TLorentzVector p4Lepton(lepton.px(), lepton.py(), lepton.pz(), lepton.energy());
+  const double lepRes = (lepton.et()>0. ? std::sqrt(covM_->setupMatrix(lepton, TopKinFitter::kEtEtaPhi)(0,0))/lepton.et() : 0.);
+  const double metRes = (met   .et()>0. ? std::sqrt(covM_->setupMatrix(met   , TopKinFitter::kEtEtaPhi)(0,0))/met   .et() : 0.);
+
+  // neutrino pz from the leptonic W mass (massless lepton and neutrino); the real part
+  // of the solutions if there is none
+  std::vector<TLorentzVector> neutrinos;
+  const double ptLep2 = p4Lepton.Perp2();
+  const double mu     = 0.5*mW_*mW_ + p4Lepton.Px()*met.px() + p4Lepton.Py()*met.py();
+  const double a      = mu*p4Lepton.Pz()/ptLep2;
+  const double disc   = a*a - (p4Lepton.E()*p4Lepton.E()*met.pt()*met.pt() - mu*mu)/ptLep2;
+  const int nSolutions = (disc>0. ? 2 : 1);
+  for(int i=0; i<nSolutions; ++i){
+    const double pz = a + (i==0 ? 1. : -1.)*(disc>0. ? std::sqrt(disc) : 0.);
+    neutrinos.push_back(TLorentzVector(met.px(), met.py(), pz, std::sqrt(met.pt()*met.pt()+pz*pz)));
+  }
+
+  // leptonic top candidates per b jet and neutrino solution
+  pulls.lepTop.assign(jets.size(), std::vector<double>(neutrinos.size()));
+  pulls.lepTopSigma = pulls.lepTop;
+  for(unsigned int j=0; j<jets.size(); ++j){
+    for(unsigned int n=0; n<neutrinos.size(); ++n){
+      std::vector<TLorentzVector> summands(1, pulls.p4s[j]);
+      summands.push_back(p4Lepton);
+      summands.push_back(neutrinos[n]);
+      std::vector<double> resolutions(1, pulls.bRes[j]);
+      resolutions.push_back(lepRes);
+      resolutions.push_back(metRes);
+      TopKinFitter::massResolution(summands, resolutions, pulls.lepTop[j][n], pulls.lepTopSigma[j][n]);
+    }
+  }
+}
+
+template<typename LeptonCollection>
+double TtSemiLepKinFitProducer<LeptonCollection>::massChi2(const MassPulls& pulls, const std::vector<int>& combi,
+							    const std::vector<TtSemiLepKinFitter::Constraint>& masses) const
+{
+  const int lightQ = combi[TtSemiLepEvtPartons::LightQ], lightQBar = combi[TtSemiLepEvtPartons::LightQBar];
+  const int hadB = combi[TtSemiLepEvtPartons::HadB], lepB = combi[TtSemiLepEvtPartons::LepB];
+  const bool hadWAssigned = (lightQ>=0 && lightQBar>=0);
+  const bool hadTopAssigned = (hadWAssigned && hadB>=0);
+
+  // hadronic W and top candidates
+  double hadW = 0., hadWSigma = 0., hadTop = 0., hadTopSigma = 0.;
+  if(hadWAssigned){
+    std::vector<TLorentzVector> summands(1, pulls.p4s[lightQ]);
+    summands.push_back(pulls.p4s[lightQBar]);
+    std::vector<double> resolutions(1, pulls.lightRes[lightQ]);
+    resolutions.push_back(pulls.lightRes[lightQBar]);
+    TopKinFitter::massResolution(summands, resolutions, hadW, hadWSigma);
+    if(hadTopAssigned){
+      summands.push_back(pulls.p4s[hadB]);
+      resolutions.push_back(pulls.bRes[hadB]);
+      TopKinFitter::massResolution(summands, resolutions, hadTop, hadTopSigma);
+    }
+  }
+
+  // the leptonic W and the neutrino mass are fulfilled by construction
+  const unsigned int nSolutions = (lepB>=0 ? pulls.lepTop[lepB].size() : 1);
+  double result = 0.;
+  for(unsigned int n=0; n<nSolutions; ++n){
+    const double lepTop      = (lepB>=0 ? pulls.lepTop     [lepB][n] : 0.);
+    const double lepTopSigma = (lepB>=0 ? pulls.lepTopSigma[lepB][n] : 0.);
+    double chi2 = 0.;
+    for(unsigned int i=0; i<masses.size(); ++i){
+      switch(masses[i]){
+      case TtSemiLepKinFitter::kWHadMass       : if(hadWSigma>0.) chi2 += std::pow((hadW-mW_)/hadWSigma, 2); break;
+      case TtSemiLepKinFitter::kTopHadMass     : if(hadTopSigma>0.) chi2 += std::pow((hadTop-mTop_)/hadTopSigma, 2); break;
+      case TtSemiLepKinFitter::kTopLepMass     : if(lepTopSigma>0.) chi2 += std::pow((lepTop-mTop_)/lepTopSigma, 2); break;
+      case TtSemiLepKinFitter::kEqualTopMasses : if(hadTopAssigned && lepB>=0) chi2 += std::pow(hadTop-lepTop, 2)/(std::pow(hadTopSigma, 2)+std::pow(lepTopSigma, 2)+1e-12); break;
+      default: break;
+      }
+    }
+    if(n==0 || chi2<result) result = chi2;
+  }
+  return result;
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::fitSides(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met,
+							  const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+							  std::vector<SubFit>& hadFits, std::vector<SubFit>& lepFits, std::vector<unsigned int>& hadOf, std::vector<unsigned int>& lepOf)
+{
+  // distinct hadronic jet triplets and leptonic b jets of the combinations (only for a
+  // side with constraints)
+  std::map<std::vector<int>, unsigned int> hadIndex;
+  std::map<int, unsigned int> lepIndex;
+  std::vector<std::vector<int> > hadTriplets;
+  std::vector<int> lepBs;
+  hadOf.assign(combis.size(), 0);
+  lepOf.assign(combis.size(), 0);
+  for(unsigned int idx=0; !hadFitters_.empty() && idx<combis.size(); ++idx){
+    std::vector<int> triplet(3);
+    triplet[0] = combis[idx][TtSemiLepEvtPartons::LightQ   ];
+    triplet[1] = combis[idx][TtSemiLepEvtPartons::LightQBar];
+    triplet[2] = combis[idx][TtSemiLepEvtPartons::HadB     ];
+    std::map<std::vector<int>, unsigned int>::const_iterator had = hadIndex.find(triplet);
+    if(had == hadIndex.end()){
+      hadOf[idx] = hadIndex[triplet] = hadTriplets.size();
+      hadTriplets.push_back(triplet);
+    }
+    else hadOf[idx] = had->second;
+  }
+  for(unsigned int idx=0; !lepFitters_.empty() && idx<combis.size(); ++idx){
+    const int lepB = combis[idx][TtSemiLepEvtPartons::LepB];
+    std::map<int, unsigned int>::const_iterator lep = lepIndex.find(lepB);
+    if(lep == lepIndex.end()){
+      lepOf[idx] = lepIndex[lepB] = lepBs.size();
+      lepBs.push_back(lepB);
+    }
+    else lepOf[idx] = lep->second;
+  }
+
+  // fit each of them once, distributed over the threads (serially under a time budget); the
+  // jets in the slots of the other side do not enter any constraint and are irrelevant
+  hadFits.assign(hadTriplets.size(), SubFit());
+  lepFits.assign(lepBs.size(), SubFit());
+  pool_.run(hadFits.size()+lepFits.size(), [&](const unsigned int worker, const unsigned int idx) {
+      if(maxFitTime_>0. && std::chrono::steady_clock::now()>deadline) return;
+      const bool hadronic = (idx<hadFits.size());
+      std::vector<pat::Jet> jetCombi;
+      jetCombi.resize(TtSemiLepTopology::nPartons);
+      if(hadronic){
+	const std::vector<int>& triplet = hadTriplets[idx];
+	jetCombi[TtSemiLepEvtPartons::LightQ   ] = jets[triplet[0]];
+	jetCombi[TtSemiLepEvtPartons::LightQBar] = jets[triplet[1]];
+	jetCombi[TtSemiLepEvtPartons::HadB     ] = jets[triplet[2]];
+	jetCombi[TtSemiLepEvtPartons::LepB     ] = jets[triplet[2]];
+      }
+      else
+	jetCombi.assign(TtSemiLepTopology::nPartons, jets[lepBs[idx-hadFits.size()]]);
+
+      TtSemiLepKinFitter* kinFitter = (hadronic ? hadFitters_[worker] : lepFitters_[worker]);
+      SubFit& fit = (hadronic ? hadFits[idx] : lepFits[idx-hadFits.size()]);
+      fit.fitted    = true;
+      fit.status    = kinFitter->fit(jetCombi, lepton, met);
+      fit.chi2      = kinFitter->fitS();
+      fit.residual  = kinFitter->fitF();
+      fit.ndf       = kinFitter->fitNDF();
+      fit.hasResult = kinFitter->hasFitResult();
+      fit.rescued   = kinFitter->fitRescued();
+      fit.rescuedChi2 = kinFitter->fitRescuedS();
+      if( !fit.hasResult ) return;
+      fit.particles[0] = (hadronic ? kinFitter->fittedHadP() : kinFitter->fittedLepB()    );
+      fit.particles[1] = (hadronic ? kinFitter->fittedHadQ() : kinFitter->fittedLepton()  );
+      fit.particles[2] = (hadronic ? kinFitter->fittedHadB() : kinFitter->fittedNeutrino());
+    }, maxFitTime_>0.);
+  // count the separate fits in the statistics of the main fitter
+  for(unsigned int i=0; i<hadFitters_.size(); ++i)
+    fitter->takeFitStats(*hadFitters_[i]);
+  for(unsigned int i=0; i<lepFitters_.size(); ++i)
+    fitter->takeFitStats(*lepFitters_[i]);
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::fitFactorised(const std::vector<pat::Jet>& jets, const typename LeptonCollection::value_type& lepton, const pat::MET& met,
+							       const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+							       std::vector<CombiFit>& fits)
+{
+  std::vector<SubFit> hadFits, lepFits;
+  std::vector<unsigned int> hadOf, lepOf;
+  fitSides(jets, lepton, met, combis, deadline, hadFits, lepFits, hadOf, lepOf);
+
+  // the chi2 of a combination is the sum of the chi2 of its two sides
+  for(unsigned int idx=0; idx<combis.size(); ++idx){
+    const SubFit& had = hadFits[hadOf[idx]];
+    const SubFit& lep = lepFits[lepOf[idx]];
+    CombiFit& fit = fits[idx];
+    fit.fitted = (had.fitted && lep.fitted);
+    if( !fit.fitted ) continue;
+    fit.status    = (had.status!=0 ? had.status : lep.status);
+    fit.chi2      = had.chi2 + lep.chi2;
+    fit.hasResult = (had.hasResult && lep.hasResult);
+    // converged with the configured iteration limit only
+    fit.rescued   = (fit.status!=0 && (had.status==0 || had.rescued) && (lep.status==0 || lep.rescued));
+    fit.rescuedChi2 = (had.rescued ? had.rescuedChi2 : had.chi2) + (lep.rescued ? lep.rescuedChi2 : lep.chi2);
+    if( fit.offBeam || !fit.hasResult || !bestResults_[0].accepts(fit.chi2, idx) ) continue;
+    KinFitResult result;
+    result.Status = fit.status;
+    result.Chi2 = fit.chi2;
+    result.Prob = TMath::Prob(fit.chi2, had.ndf+lep.ndf);
+    result.Residual = had.residual + lep.residual;
+    result.HadP = had.particles[0];
+    result.HadQ = had.particles[1];
+    result.HadB = had.particles[2];
+    result.LepB = lep.particles[0];
+    result.LepL = lep.particles[1];
+    result.LepN = lep.particles[2];
+    result.JetCombi = combis[idx];
+    bestResults_[0].push(fit.chi2, idx, result);
+  }
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::acquire(const edm::Event& evt, const edm::EventSetup& setup, edm::WaitingTaskWithArenaHolder holder)
+{
+  // the input collections stay in the event until produce
+  evt.getByToken(jetsToken_, jetsHandle_);
+  evt.getByToken(metsToken_, metsHandle_);
+  evt.getByToken(lepsToken_, lepsHandle_);
+  if(useOnlyMatch_) evt.getByToken(matchToken_, matchHandle_);
+
+  // events with large combinatorics are fitted on the dedicated threads
+  if(offloadMinFits_>0 && this->globalCache()->offload.enabled()){
+    unsigned int nBTags = 0;
+    for(std::vector<pat::Jet>::const_iterator jet = jetsHandle_->begin(); jet != jetsHandle_->end(); ++jet)
+      if(jet->bDiscriminator(bTagAlgo_) >= minBTagValueBJet_) ++nBTags;
+    const unsigned int nMatches = (useOnlyMatch_ ? std::min((unsigned int)matchHandle_->size(), maxNMatch_) : 0);
+    if(TopKinFitterCost::semiLepFits(jetsHandle_->size(), nBTags, maxNJets_, useBTag_, useOnlyMatch_, nMatches) >= offloadMinFits_){
+      this->globalCache()->offload.push([this, holder]() mutable {
+	  std::exception_ptr error;
+	  try{
+	    fitEvent();
+	  }
+	  catch(...){
+	    error = std::current_exception();
+	  }
+	  holder.doneWaiting(error);
+	});
+      return;
+    }
+  }
+  fitEvent();
 }
 
 template<typename LeptonCollection>
 void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const edm::EventSetup& setup)
 {
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsHadP( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsHadQ( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsHadB( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pPartonsLepB( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pLeptons    ( new std::vector<pat::Particle> );
-  std::auto_ptr< std::vector<pat::Particle> > pNeutrinos  ( new std::vector<pat::Particle> );
+  if(compactResults_){
+    // one entry per combination with the fitted objects in the order of TopKinFitResults::SemiLepRole
+    std::unique_ptr<TopKinFitResults> pCompact(new TopKinFitResults(TopKinFitResults::kNSemiLepRoles, TtSemiLepTopology::nPartons));
+    pCompact->reserve(products_.pCombi->size());
+    for(unsigned int i=0; i<products_.pCombi->size(); ++i)
+      pCompact->push_back(fittedObjects(i), (*products_.pCombi)[i], (*products_.pChi2)[i], (*products_.pProb)[i],
+			  (*products_.pStatus)[i], (*products_.pResidual)[i]);
+    evt.put(std::move(pCompact), "Compact");
+  }
+  if(pullResults_){
+    // the jets are measured by the jets of the combination, lepton and neutrino by the first
+    // lepton and the first MET, as in the fit
+    std::vector<int> roleJets(TopKinFitResults::kNSemiLepRoles, -1);
+    roleJets[TopKinFitResults::kHadP] = TtSemiLepEvtPartons::LightQ;
+    roleJets[TopKinFitResults::kHadQ] = TtSemiLepEvtPartons::LightQBar;
+    roleJets[TopKinFitResults::kHadB] = TtSemiLepEvtPartons::HadB;
+    roleJets[TopKinFitResults::kLepB] = TtSemiLepEvtPartons::LepB;
+    std::unique_ptr<TopKinFitPulls> pPulls(new TopKinFitPulls(roleJets, TtSemiLepTopology::nPartons));
+    pPulls->reserve(products_.pCombi->size());
+    std::vector<const reco::Candidate*> measured(TopKinFitResults::kNSemiLepRoles, 0);
+    if(!lepsHandle_->empty()) measured[TopKinFitResults::kLepton  ] = &lepsHandle_->front();
+    if(!metsHandle_->empty()) measured[TopKinFitResults::kNeutrino] = &metsHandle_->front();
+    for(unsigned int i=0; i<products_.pCombi->size(); ++i){
+      const std::vector<int>& jetCombi = (*products_.pCombi)[i];
+      for(unsigned int role=0; role<roleJets.size(); ++role)
+	if(roleJets[role]>=0)
+	  measured[role] = (jetCombi[roleJets[role]]>=0 ? &(*jetsHandle_)[jetCombi[roleJets[role]]] : 0);
+      pPulls->push_back(fittedObjects(i), measured, jetCombi, (*products_.pChi2)[i], (*products_.pProb)[i],
+			(*products_.pStatus)[i], (*products_.pResidual)[i]);
+    }
+    evt.put(std::move(pPulls), "Pulls");
+  }
+  if(!compactResults_ && !pullResults_){
+    evt.put(std::move(products_.pCombi));
+    evt.put(std::move(products_.pPartonsHadP), "PartonsHadP");
+    evt.put(std::move(products_.pPartonsHadQ), "PartonsHadQ");
+    evt.put(std::move(products_.pPartonsHadB), "PartonsHadB");
+    evt.put(std::move(products_.pPartonsLepB), "PartonsLepB");
+    evt.put(std::move(products_.pLeptons)    , "Leptons"    );
+    evt.put(std::move(products_.pNeutrinos)  , "Neutrinos"  );
+    evt.put(std::move(products_.pChi2)       , "Chi2"       );
+    evt.put(std::move(products_.pProb)       , "Prob"       );
+    evt.put(std::move(products_.pStatus)     , "Status"     );
+    evt.put(std::move(products_.pResidual)   , "ConstraintResidual");
+  }
+  evt.put(std::move(products_.pJetsConsidered), "NumberOfConsideredJets");
+  evt.put(std::move(products_.pExhaustive), "Exhaustive");
+}
 
-  std::auto_ptr< std::vector<std::vector<int> > > pCombi ( new std::vector<std::vector<int> > );
-  std::auto_ptr< std::vector<double>            > pChi2  ( new std::vector<double> );
-  std::auto_ptr< std::vector<double>            > pProb  ( new std::vector<double> );
-  std::auto_ptr< std::vector<int>               > pStatus( new std::vector<int> );
+template<typename LeptonCollection>
+std::vector<const reco::Candidate*> TtSemiLepKinFitProducer<LeptonCollection>::fittedObjects(const unsigned int i) const
+{
+  std::vector<const reco::Candidate*> fitted(TopKinFitResults::kNSemiLepRoles);
+  fitted[TopKinFitResults::kHadP    ] = &(*products_.pPartonsHadP)[i];
+  fitted[TopKinFitResults::kHadQ    ] = &(*products_.pPartonsHadQ)[i];
+  fitted[TopKinFitResults::kHadB    ] = &(*products_.pPartonsHadB)[i];
+  fitted[TopKinFitResults::kLepB    ] = &(*products_.pPartonsLepB)[i];
+  fitted[TopKinFitResults::kLepton  ] = &(*products_.pLeptons    )[i];
+  fitted[TopKinFitResults::kNeutrino] = &(*products_.pNeutrinos  )[i];
+  return fitted;
+}
 
-  std::auto_ptr<int> pJetsConsidered(new int);
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::fitEvent()
+{
+  std::unique_ptr< std::vector<pat::Particle> >& pPartonsHadP = products_.pPartonsHadP;
+  std::unique_ptr< std::vector<pat::Particle> >& pPartonsHadQ = products_.pPartonsHadQ;
+  std::unique_ptr< std::vector<pat::Particle> >& pPartonsHadB = products_.pPartonsHadB;
+  std::unique_ptr< std::vector<pat::Particle> >& pPartonsLepB = products_.pPartonsLepB;
+  std::unique_ptr< std::vector<pat::Particle> >& pLeptons     = products_.pLeptons;
+  std::unique_ptr< std::vector<pat::Particle> >& pNeutrinos   = products_.pNeutrinos;
+  pPartonsHadP.reset( new std::vector<pat::Particle> );
+  pPartonsHadQ.reset( new std::vector<pat::Particle> );
+  pPartonsHadB.reset( new std::vector<pat::Particle> );
+  pPartonsLepB.reset( new std::vector<pat::Particle> );
+  pLeptons    .reset( new std::vector<pat::Particle> );
+  pNeutrinos  .reset( new std::vector<pat::Particle> );
 
-  edm::Handle<std::vector<pat::Jet> > jets;
-  evt.getByLabel(jets_, jets);
+  std::unique_ptr< std::vector<std::vector<int> > >& pCombi = products_.pCombi;
+  std::unique_ptr< std::vector<double>            >& pChi2  = products_.pChi2;
+  std::unique_ptr< std::vector<double>            >& pProb  = products_.pProb;
+  std::unique_ptr< std::vector<int>               >& pStatus= products_.pStatus;
+  std::unique_ptr< std::vector<double>            >& pResidual = products_.pResidual;
+  pCombi   .reset( new std::vector<std::vector<int> > );
+  pChi2    .reset( new std::vector<double> );
+  pProb    .reset( new std::vector<double> );
+  pStatus  .reset( new std::vector<int> );
+  pResidual.reset( new std::vector<double> );
 
-  edm::Handle<std::vector<pat::MET> > mets;
-  evt.getByLabel(mets_, mets);
+  std::unique_ptr<int>& pJetsConsidered = products_.pJetsConsidered;
+  pJetsConsidered.reset(new int);
+  // all jet combinations were fitted within the budget
+  std::unique_ptr<bool>& pExhaustive = products_.pExhaustive;
+  pExhaustive.reset(new bool(true));
 
-  edm::Handle<LeptonCollection> leps;
-  evt.getByLabel(leps_, leps);
+  const edm::Handle<std::vector<pat::Jet> >& jets = jetsHandle_;
+  const edm::Handle<std::vector<pat::MET> >& mets = metsHandle_;
+  const edm::Handle<LeptonCollection>& leps = lepsHandle_;
 
   const unsigned int nPartons = 4;
 
-  std::vector<int> match;
+  // adapt the iteration limit at the event boundary only
+  const bool newMaxNrIter = tuning_.beginEvent(fitter->fitStats());
+  std::vector<TtSemiLepKinFitter*> kinFitters(1, fitter);
+  kinFitters.insert(kinFitters.end(), workers_   .begin(), workers_   .end());
+  kinFitters.insert(kinFitters.end(), hadFitters_.begin(), hadFitters_.end());
+  kinFitters.insert(kinFitters.end(), lepFitters_.begin(), lepFitters_.end());
+  for(unsigned int i=0; i<kinFitters.size(); ++i){
+    if(newMaxNrIter) kinFitters[i]->setMaxNrIter(tuning_.maxNrIter());
+    kinFitters[i]->setValidation(tuning_.validateEvent());
+  }
+  beamSearch_.beginEvent();
+  // fits and fit time so far, for the actual cost of the event
+  const unsigned long nFitsBefore = fitter->fitStats().nFits();
+  const double fitTimeBefore = fitter->fitStats().time();
+
+  std::vector<std::vector<int> > matches;
   bool invalidMatch = false;
   if(useOnlyMatch_) {
     *pJetsConsidered = nPartons;
-    edm::Handle<std::vector<std::vector<int> > > matchHandle;
-    evt.getByLabel(match_, matchHandle);
-    match = *(matchHandle->begin());
-    // check if match is valid
-    if(match.size()!=nPartons) invalidMatch=true;
-    else {
-      for(unsigned int idx=0; idx<match.size(); ++idx) {
-	if(match[idx]<0 || match[idx]>=(int)jets->size()) {
-	  invalidMatch=true;
-	  break;
-	}
-      }
+    // take the first maxNMatch valid matches
+    for(std::vector<std::vector<int> >::const_iterator match = matchHandle_->begin(); match != matchHandle_->end() && match-matchHandle_->begin() < (int)maxNMatch_; ++match) {
+      // check if match is valid
+      bool valid = (match->size()==nPartons);
+      for(unsigned int idx=0; valid && idx<match->size(); ++idx)
+	valid = ((*match)[idx]>=0 && (*match)[idx]<(int)jets->size());
+      if(valid) matches.push_back(*match);
     }
+    invalidMatch = matches.empty();
   }
 
   // -----------------------------------------------------
@@ -223,13 +835,13 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
   // -----------------------------------------------------
 
   if( leps->empty() || mets->empty() || jets->size()<nPartons || invalidMatch ) {
-    // the kinFit getters return empty objects here
-    pPartonsHadP->push_back( fitter->fittedHadP()     );
-    pPartonsHadQ->push_back( fitter->fittedHadQ()     );
-    pPartonsHadB->push_back( fitter->fittedHadB()     );
-    pPartonsLepB->push_back( fitter->fittedLepB()     );
-    pLeptons    ->push_back( fitter->fittedLepton()   );
-    pNeutrinos  ->push_back( fitter->fittedNeutrino() );
+    // empty objects, independent of which fitter did the last fit
+    pPartonsHadP->push_back( pat::Particle() );
+    pPartonsHadQ->push_back( pat::Particle() );
+    pPartonsHadB->push_back( pat::Particle() );
+    pPartonsLepB->push_back( pat::Particle() );
+    pLeptons    ->push_back( pat::Particle() );
+    pNeutrinos  ->push_back( pat::Particle() );
     // indices referring to the jet combination
     std::vector<int> invalidCombi;
     for(unsigned int i = 0; i < nPartons; ++i) 
@@ -241,20 +853,12 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
     pProb->push_back( -1. );
     // status of the fitter
     pStatus->push_back( -1 );
+    // distance from the constraints
+    pResidual->push_back( -1. );
     // number of jets
     *pJetsConsidered = jets->size();
-    // feed out all products
-    evt.put(pCombi);
-    evt.put(pPartonsHadP, "PartonsHadP");
-    evt.put(pPartonsHadQ, "PartonsHadQ");
-    evt.put(pPartonsHadB, "PartonsHadB");
-    evt.put(pPartonsLepB, "PartonsLepB");
-    evt.put(pLeptons    , "Leptons"    );
-    evt.put(pNeutrinos  , "Neutrinos"  );
-    evt.put(pChi2       , "Chi2"       );
-    evt.put(pProb       , "Prob"       );
-    evt.put(pStatus     , "Status"     );
-    evt.put(pJetsConsidered, "NumberOfConsideredJets");
+    if(cost_.enabled()) cost_.fill(0, 0, 0.);
+    fitter->endEvent();
     return;
   }
 
@@ -263,68 +867,236 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
   // (or only a given jet combination if useOnlyMatch=true)
   // -----------------------------------------------------
   
+  // the jets to be considered, with b-tagging at least both b-tagged jets
   std::vector<int> jetIndices;
   if(!useOnlyMatch_) {
-    for(unsigned int i=0; i<jets->size(); ++i){
-      if(maxNJets_ >= (int) nPartons && maxNJets_ == (int) i) {
-	*pJetsConsidered = i;
-	break;
-      }
-      jetIndices.push_back(i);
-    }
+    preselection_.select(*jets, maxNJets_, nPartons, useBTag_ ? TtSemiLepTopology::nBPartons : 0, bTagAlgo_, minBTagValueBJet_, jetIndices);
+    *pJetsConsidered = jetIndices.size();
   }
   
-  std::vector<int> combi;
-  for(unsigned int i=0; i<nPartons; ++i) {
-    if(useOnlyMatch_) combi.push_back( match[i] );
-    else combi.push_back(i);
+  // canonical assignments of the jets to the partons, taking into account the
+  // indistinguishability of the two jets from the hadronic W decay
+  JetCombinationGenerator<TtSemiLepTopology> combinations(jetIndices);
+  setupBTagging(*jets, combinations);
+  // number of fits of the full enumeration, known before any fit
+  unsigned long nPredicted = (cost_.enabled() && !useOnlyMatch_ ? TopKinFitterCost::nCombinations(combinations) : 0);
+
+  // inputs for the mass pulls of the beam search and of the estimated chi2 bound
+  const bool useBeam = (beamSearch_.enabled() && !useOnlyMatch_);
+  MassPulls pulls;
+  if(useBeam || (chi2Bound_==kEstimatedBound && !factorised_))
+    fillMassPulls(*jets, (*leps)[0], (*mets)[0], pulls);
+
+  // don't go through combinatorics if useOnlyMatch was chosen; the generated
+  // assignments are compatible with the b-tagging, given matches have to be checked
+  std::vector<std::vector<int> > combis;
+  std::set<std::vector<int> > beamCombis;
+  bool beamTruncated = false;
+  if(useOnlyMatch_) {
+    for(unsigned int i=0; i<matches.size(); ++i)
+      if(combinations.accept(matches[i])) combis.push_back(matches[i]);
+    nPredicted = combis.size();
+  }
+  else if(useBeam) {
+    // approximate search: the partial assignments are ranked by the pulls of the
+    // hadronic W and of the top candidates, whether they are constrained or not
+    std::vector<TtSemiLepKinFitter::Constraint> beamMasses;
+    beamMasses.push_back(TtSemiLepKinFitter::kWHadMass  );
+    beamMasses.push_back(TtSemiLepKinFitter::kTopHadMass);
+    beamMasses.push_back(TtSemiLepKinFitter::kTopLepMass);
+    beamTruncated = !combinations.beamSearch(beamSearch_.beamWidth(), [&](const std::vector<int>& combi) { return massChi2(pulls, combi, beamMasses); }, combis);
+    beamSearch_.fill(beamTruncated);
+    // in validation events all combinations are fitted, those outside the beam
+    // without entering the result
+    if(beamSearch_.validateEvent()){
+      beamCombis.insert(combis.begin(), combis.end());
+      combis.clear();
+      std::vector<int> combi;
+      while(combinations.next(combi)) combis.push_back(combi);
+    }
   }
+  else {
+    std::vector<int> combi;
+    while(combinations.next(combi)) combis.push_back(combi);
+  }
+  const bool validateBeam = (useBeam && beamSearch_.validateEvent());
 
-  std::list<KinFitResult> FitResultList;
+  // with a budget, the most promising combinations are fitted first, such that the
+  // best result so far is meaningful when the budget is used up
+  const bool budget = (maxNFittedCombis_>0 || maxFitTime_>0.);
+  if(budget && combis.size()>1) orderCombinations(*jets, combis);
+  const unsigned int nCombis = combis.size();
+  if(maxNFittedCombis_>0 && combis.size()>maxNFittedCombis_) combis.resize(maxNFittedCombis_);
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(maxFitTime_));
 
-  do{
-    for(int cnt = 0; cnt < TMath::Factorial( combi.size() ); ++cnt){
-      // take into account indistinguishability of the two jets from the hadr. W decay,
-      // reduces combinatorics by a factor of 2
-      if( (combi[TtSemiLepEvtPartons::LightQ] < combi[TtSemiLepEvtPartons::LightQBar]
-	 || useOnlyMatch_ ) && doBTagging(useBTag_, jets, combi, bTagAlgo_, minBTagValueBJet_, maxBTagValueNonBJet_) ){
-	
-	std::vector<pat::Jet> jetCombi;
-	jetCombi.resize(nPartons);
-	jetCombi[TtSemiLepEvtPartons::LightQ   ] = (*jets)[combi[TtSemiLepEvtPartons::LightQ   ]];
-	jetCombi[TtSemiLepEvtPartons::LightQBar] = (*jets)[combi[TtSemiLepEvtPartons::LightQBar]];
-	jetCombi[TtSemiLepEvtPartons::HadB     ] = (*jets)[combi[TtSemiLepEvtPartons::HadB     ]];
-	jetCombi[TtSemiLepEvtPartons::LepB     ] = (*jets)[combi[TtSemiLepEvtPartons::LepB     ]];
-
-	// do the kinematic fit
-	const int status = fitter->fit(jetCombi, (*leps)[0], (*mets)[0]);
-
-	if( status == 0 ) { // only take into account converged fits
-	  KinFitResult result;
-	  result.Status = status;
-	  result.Chi2 = fitter->fitS();
-	  result.Prob = fitter->fitProb();
-	  result.HadB = fitter->fittedHadB();
-	  result.HadP = fitter->fittedHadP();
-	  result.HadQ = fitter->fittedHadQ();
-	  result.LepB = fitter->fittedLepB();
-	  result.LepL = fitter->fittedLepton();
-	  result.LepN = fitter->fittedNeutrino();
-	  result.JetCombi = combi;
-
-	  FitResultList.push_back(result);
-	}
+  // best combination with and without the rescued fits (validation events only)
+  std::vector<int> bestCombi, bestTunedCombi;
+  double bestChi2 = -1., bestTunedChi2 = -1.;
+  unsigned int nRescued = 0;
+
+  // record the fit inputs if requested
+  TopKinFitterRecord record(TopKinFitterRecord::kSemiLep);
+  if(fitInputDumpFile_.is_open()){
+    record.jetParam    = jetParam_;
+    record.lepParam    = lepParam_;
+    record.metParam    = metParam_;
+    record.fixLepton   = fixLepton_;
+    record.constraints = std::vector<int>(constraints_.begin(), constraints_.end());
+    record.mW          = mW_;
+    record.mTop        = mTop_;
+    record.jetEnergyResolutionScaleFactors = jetEnergyResolutionScaleFactors_;
+    record.jetEnergyResolutionEtaBinning   = jetEnergyResolutionEtaBinning_;
+    for(std::vector<pat::Jet>::const_iterator jet = jets->begin(); jet != jets->end(); ++jet){
+      record.jets .push_back(TLorentzVector(jet->px(), jet->py(), jet->pz(), jet->energy()));
+      record.bJets.push_back(record.jets.back());
+    }
+    const reco::Candidate& lepton = (*leps)[0];
+    record.lepton       = TLorentzVector(lepton.px(), lepton.py(), lepton.pz(), lepton.energy());
+    record.leptonCharge = lepton.charge();
+    record.leptonType   = (dynamic_cast<const reco::Muon*>(&lepton) ? CovarianceMatrix::kMuon : CovarianceMatrix::kElectron);
+    record.neutrino     = TLorentzVector((*mets)[0].px(), (*mets)[0].py(), 0, (*mets)[0].et());
+  }
 
+  for(unsigned int worker=0; worker<bestResults_.size(); ++worker)
+    bestResults_[worker].clear();
+
+  // fit the jet combinations distributed over the threads, each with its own fitter; the
+  // outcomes are stored by position and the results ranked by chi2 and position, such
+  // that the result does not depend on the number of threads
+  std::vector<CombiFit> fits(combis.size());
+  for(unsigned int idx=0; validateBeam && idx<combis.size(); ++idx)
+    fits[idx].offBeam = (beamCombis.count(combis[idx])==0);
+  if( factorised_ ) {
+    fitFactorised(*jets, (*leps)[0], (*mets)[0], combis, deadline, fits);
+  }
+  else {
+    // lower bounds on the chi2: estimated from the mass pulls (approximate) or fitted
+    // without the coupling constraints (only from converged fits); the combinations are
+    // fitted lowest bound first and skipped once the bound exceeds the worst kept chi2
+    std::vector<double> bounds;
+    if(chi2Bound_==kEstimatedBound){
+      const std::vector<TtSemiLepKinFitter::Constraint> masses = constraints(constraints_);
+      for(unsigned int idx=0; idx<combis.size(); ++idx)
+	bounds.push_back(massChi2(pulls, combis[idx], masses));
+    }
+    else if(chi2Bound_==kFittedBound){
+      std::vector<SubFit> hadFits, lepFits;
+      std::vector<unsigned int> hadOf, lepOf;
+      fitSides(*jets, (*leps)[0], (*mets)[0], combis, deadline, hadFits, lepFits, hadOf, lepOf);
+      bounds.assign(combis.size(), 0.);
+      for(unsigned int idx=0; idx<combis.size(); ++idx){
+	if(!hadFits.empty() && hadFits[hadOf[idx]].hasResult && hadFits[hadOf[idx]].status==0) bounds[idx] += hadFits[hadOf[idx]].chi2;
+	if(!lepFits.empty() && lepFits[lepOf[idx]].hasResult && lepFits[lepOf[idx]].status==0) bounds[idx] += lepFits[lepOf[idx]].chi2;
+      }
+    }
+    std::vector<unsigned int> order(combis.size());
+    for(unsigned int idx=0; idx<combis.size(); ++idx)
+      order[idx] = idx;
+    if(!bounds.empty())
+      std::stable_sort(order.begin(), order.end(), [&](const unsigned int lhs, const unsigned int rhs) { return bounds[lhs]<bounds[rhs]; });
+
+    // with a bound the pruning depends on the results fitted before, and with a time budget
+    // the fits done in time depend on the order: run them serially, in the order of the bound,
+    // such that the fitted set does not depend on the number of threads
+    pool_.run(combis.size(), [&](const unsigned int worker, const unsigned int pos) {
+        TtSemiLepKinFitter* kinFitter = (worker==0 ? fitter : workers_[worker-1]);
+        const unsigned int idx = order[pos];
+        const std::vector<int>& combi = combis[idx];
+
+        std::vector<pat::Jet> jetCombi;
+        jetCombi.resize(nPartons);
+        jetCombi[TtSemiLepEvtPartons::LightQ   ] = (*jets)[combi[TtSemiLepEvtPartons::LightQ   ]];
+        jetCombi[TtSemiLepEvtPartons::LightQBar] = (*jets)[combi[TtSemiLepEvtPartons::LightQBar]];
+        jetCombi[TtSemiLepEvtPartons::HadB     ] = (*jets)[combi[TtSemiLepEvtPartons::HadB     ]];
+        jetCombi[TtSemiLepEvtPartons::LepB     ] = (*jets)[combi[TtSemiLepEvtPartons::LepB     ]];
+
+        // do the kinematic fit unless the time budget is used up or the bound on its
+        // chi2 excludes it from the best maxNComb so far; only the fitted bound is safe
+        CombiFit& fit = fits[idx];
+        if(maxFitTime_>0. && std::chrono::steady_clock::now()>deadline) return;
+        if(!bounds.empty() && !bestResults_[worker].accepts(bounds[idx], idx)){
+          fit.pruned = (chi2Bound_==kFittedBound);
+          return;
+        }
+        fit.fitted = true;
+        fit.status = kinFitter->fit(jetCombi, (*leps)[0], (*mets)[0]);
+        fit.chi2 = kinFitter->fitS();
+        fit.hasResult = kinFitter->hasFitResult();
+        fit.rescued = kinFitter->fitRescued();
+        fit.rescuedChi2 = kinFitter->fitRescuedS();
+
+        // only take into account converged fits (and fits that stopped
+        // at the maximal number of iterations if keepUnconverged=true);
+        // only those among the best maxNComb so far are materialised,
+        // those outside the beam are only fitted for its validation
+        if( fit.offBeam || !fit.hasResult || !bestResults_[worker].accepts(fit.chi2, idx) ) return;
+        KinFitResult result;
+        result.Status = fit.status;
+        result.Chi2 = fit.chi2;
+        result.Prob = kinFitter->fitProb();
+        result.Residual = kinFitter->fitF();
+        result.HadB = kinFitter->fittedHadB();
+        result.HadP = kinFitter->fittedHadP();
+        result.HadQ = kinFitter->fittedHadQ();
+        result.LepB = kinFitter->fittedLepB();
+        result.LepL = kinFitter->fittedLepton();
+        result.LepN = kinFitter->fittedNeutrino();
+        result.JetCombi = combi;
+        bestResults_[worker].push(fit.chi2, idx, result);
+      }, !bounds.empty() || maxFitTime_>0.);
+    // count the fits of the worker threads in the statistics of the main fitter
+    for(unsigned int i=0; i<workers_.size(); ++i)
+      fitter->takeFitStats(*workers_[i]);
+  }
+
+  // best chi2 of the converged fits inside and outside the beam (validation events only)
+  double bestBeamChi2 = -1., bestOffBeamChi2 = -1.;
+  unsigned int nFitted = 0, nPruned = 0;
+  for(unsigned int idx=0; idx<fits.size(); ++idx){
+    const CombiFit& fit = fits[idx];
+    if( fit.pruned ) ++nPruned;
+    if( !fit.fitted ) continue;
+    ++nFitted;
+    if( fit.offBeam ){
+      if(fit.hasResult && fit.status == 0 && (bestOffBeamChi2<0. || fit.chi2<bestOffBeamChi2)) bestOffBeamChi2 = fit.chi2;
+      continue;
+    }
+    if(validateBeam && fit.hasResult && fit.status == 0 && (bestBeamChi2<0. || fit.chi2<bestBeamChi2)) bestBeamChi2 = fit.chi2;
+    if(fitInputDumpFile_.is_open()) record.combis.push_back(combis[idx]);
+
+    if(tuning_.validateEvent() && ((fit.hasResult && fit.status == 0) || fit.rescued)){
+      const double chi2 = (fit.rescued ? fit.rescuedChi2 : fit.chi2);
+      if(bestCombi.empty() || chi2<bestChi2){
+	bestCombi = combis[idx];
+	bestChi2  = chi2;
+      }
+      if(fit.rescued)
+	++nRescued;
+      else if(bestTunedCombi.empty() || fit.chi2<bestTunedChi2){
+	bestTunedCombi = combis[idx];
+	bestTunedChi2  = fit.chi2;
       }
-      if(useOnlyMatch_) break; // don't go through combinatorics if useOnlyMatch was chosen
-      next_permutation( combi.begin(), combi.end() );
     }
-    if(useOnlyMatch_) break; // don't go through combinatorics if useOnlyMatch was chosen
   }
-  while(stdcomb::next_combination( jetIndices.begin(), jetIndices.end(), combi.begin(), combi.end() ));
 
-  // sort results w.r.t. chi2 values
-  FitResultList.sort();
+  // combinations skipped by the fitted bound cannot be among the best ones, those
+  // skipped by the estimated one might be, as well as those dropped from the beam
+  *pExhaustive = (nFitted+nPruned==nCombis && !beamTruncated);
+
+  if(validateBeam)
+    beamSearch_.fillValidation(bestBeamChi2>=0. || bestOffBeamChi2>=0., bestOffBeamChi2>=0. && (bestBeamChi2<0. || bestOffBeamChi2<bestBeamChi2));
+
+  if(tuning_.validateEvent())
+    tuning_.fillValidation(bestCombi, bestChi2, bestTunedCombi, bestTunedChi2, nRescued);
+  if(fitInputDumpFile_.is_open())
+    record.write(fitInputDumpFile_);
+
+  // best maxNComb results of all threads, sorted w.r.t. chi2 values
+  for(unsigned int worker=1; worker<bestResults_.size(); ++worker)
+    bestResults_[0].merge(bestResults_[worker]);
+  std::vector<KinFitResult> FitResultList;
+  bestResults_[0].extract(FitResultList);
   
   // -----------------------------------------------------
   // feed out result
@@ -332,12 +1104,13 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
   // -----------------------------------------------------
 
   if( (unsigned)FitResultList.size() < 1 ) { // in case no fit results were stored in the list (all fits aborted)
-    pPartonsHadP->push_back( fitter->fittedHadP()     );
-    pPartonsHadQ->push_back( fitter->fittedHadQ()     );
-    pPartonsHadB->push_back( fitter->fittedHadB()     );
-    pPartonsLepB->push_back( fitter->fittedLepB()     );
-    pLeptons    ->push_back( fitter->fittedLepton()   );
-    pNeutrinos  ->push_back( fitter->fittedNeutrino() );
+    // empty objects, independent of which fitter did the last fit
+    pPartonsHadP->push_back( pat::Particle() );
+    pPartonsHadQ->push_back( pat::Particle() );
+    pPartonsHadB->push_back( pat::Particle() );
+    pPartonsLepB->push_back( pat::Particle() );
+    pLeptons    ->push_back( pat::Particle() );
+    pNeutrinos  ->push_back( pat::Particle() );
     // indices referring to the jet combination
     std::vector<int> invalidCombi;
     for(unsigned int i = 0; i < nPartons; ++i) 
@@ -349,12 +1122,47 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
     pProb->push_back( -1. );
     // status of the fitter
     pStatus->push_back( -1 );
+    // distance from the constraints
+    pResidual->push_back( -1. );
   }
   else {
+    // the fitted covariance matrices are only exported for the combinations written
+    // to the event: these are refitted here, not to spend time on discarded ones
+    if(exportFitCovariance_) fitter->setFillStats(false);
     unsigned int iComb = 0;
-    for(typename std::list<KinFitResult>::const_iterator result = FitResultList.begin(); result != FitResultList.end(); ++result) {
+    for(typename std::vector<KinFitResult>::iterator result = FitResultList.begin(); result != FitResultList.end(); ++result) {
       if(maxNComb_ >= 1 && iComb == (unsigned int) maxNComb_) break;
       iComb++;
+      if(exportFitCovariance_){
+	std::vector<pat::Jet> jetCombi;
+	jetCombi.resize(nPartons);
+	jetCombi[TtSemiLepEvtPartons::LightQ   ] = (*jets)[result->JetCombi[TtSemiLepEvtPartons::LightQ   ]];
+	jetCombi[TtSemiLepEvtPartons::LightQBar] = (*jets)[result->JetCombi[TtSemiLepEvtPartons::LightQBar]];
+	jetCombi[TtSemiLepEvtPartons::HadB     ] = (*jets)[result->JetCombi[TtSemiLepEvtPartons::HadB     ]];
+	jetCombi[TtSemiLepEvtPartons::LepB     ] = (*jets)[result->JetCombi[TtSemiLepEvtPartons::LepB     ]];
+	fitter->fit(jetCombi, (*leps)[0], (*mets)[0]);
+	// keep the objects of the original fit if the refit has no result; factorised
+	// results keep their objects and only take the covariance matrices of the joint fit
+	if(fitter->hasFitResult()){
+	  fitter->embedFitResolutions();
+	  if(factorised_){
+	    TopKinFitter::copyKinResolution(result->HadP, fitter->fittedHadP());
+	    TopKinFitter::copyKinResolution(result->HadQ, fitter->fittedHadQ());
+	    TopKinFitter::copyKinResolution(result->HadB, fitter->fittedHadB());
+	    TopKinFitter::copyKinResolution(result->LepB, fitter->fittedLepB());
+	    TopKinFitter::copyKinResolution(result->LepL, fitter->fittedLepton());
+	    TopKinFitter::copyKinResolution(result->LepN, fitter->fittedNeutrino());
+	  }
+	  else{
+	    result->HadP = fitter->fittedHadP();
+	    result->HadQ = fitter->fittedHadQ();
+	    result->HadB = fitter->fittedHadB();
+	    result->LepB = fitter->fittedLepB();
+	    result->LepL = fitter->fittedLepton();
+	    result->LepN = fitter->fittedNeutrino();
+	  }
+	}
+      }
       // partons
       pPartonsHadP->push_back( result->HadP );
       pPartonsHadQ->push_back( result->HadQ );
@@ -372,19 +1180,43 @@ void TtSemiLepKinFitProducer<LeptonCollection>::produce(edm::Event& evt, const e
       pProb->push_back( result->Prob );
       // status of the fitter
       pStatus->push_back( result->Status );
+      // distance from the constraints
+      pResidual->push_back( result->Residual );
     }
+    fitter->setFillStats(true);
   }
-  evt.put(pCombi);
-  evt.put(pPartonsHadP, "PartonsHadP");
-  evt.put(pPartonsHadQ, "PartonsHadQ");
-  evt.put(pPartonsHadB, "PartonsHadB");
-  evt.put(pPartonsLepB, "PartonsLepB");
-  evt.put(pLeptons    , "Leptons"    );
-  evt.put(pNeutrinos  , "Neutrinos"  );
-  evt.put(pChi2       , "Chi2"       );
-  evt.put(pProb       , "Prob"       );
-  evt.put(pStatus     , "Status"     );
-  evt.put(pJetsConsidered, "NumberOfConsideredJets");
+  if(cost_.enabled())
+    cost_.fill(nPredicted, fitter->fitStats().nFits()-nFitsBefore, fitter->fitStats().time()-fitTimeBefore);
+  fitter->endEvent();
+}
+
+template<typename LeptonCollection>
+std::unique_ptr<TopKinFitterGlobalCache> TtSemiLepKinFitProducer<LeptonCollection>::initializeGlobalCache(const edm::ParameterSet& cfg)
+{
+  return std::unique_ptr<TopKinFitterGlobalCache>(new TopKinFitterGlobalCache(cfg.getParameter<std::string>("fitStatsJSON"),
+									      cfg.getParameter<unsigned>   ("offloadThreads")));
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::endStream()
+{
+  std::ostringstream table;
+  tuning_.print(table, "TtSemiLepKinFitter");
+  if(keepUnconverged_)
+    table << "  TtSemiLepKinFitter: " << fitter->fitStats().nFits(TopKinFitterStats::kMaxIterations)
+	  << " fits stopped at maxNrIter and were kept with their last iterate\n";
+  this->globalCache()->summary.add(stream_, fitter->fitStats(), TopKinFitterPruning(), beamSearch_, cost_, preselection_, table.str());
+}
+
+template<typename LeptonCollection>
+void TtSemiLepKinFitProducer<LeptonCollection>::globalEndJob(const TopKinFitterGlobalCache* cache)
+{
+  std::ostringstream table;
+  cache->summary.print(table, "TtSemiLepKinFitter");
+  edm::LogVerbatim("TtSemiLepKinFitProducer") << table.str();
+
+  if(!cache->summary.printJSON("TtSemiLepKinFitter"))
+    edm::LogWarning("TtSemiLepKinFitProducer") << "Cannot open file '" << cache->summary.fitStatsJSON() << "' to write the fit statistics.";
 }
  
 template<typename LeptonCollection>
@@ -395,6 +1227,7 @@ TtSemiLepKinFitter::Param TtSemiLepKinFitProducer<LeptonCollection>::param(unsig
   case TtSemiLepKinFitter::kEMom       : result=TtSemiLepKinFitter::kEMom;       break;
   case TtSemiLepKinFitter::kEtEtaPhi   : result=TtSemiLepKinFitter::kEtEtaPhi;   break;
   case TtSemiLepKinFitter::kEtThetaPhi : result=TtSemiLepKinFitter::kEtThetaPhi; break;
+  case TtSemiLepKinFitter::kEtPhiPz    : result=TtSemiLepKinFitter::kEtPhiPz;    break;
   default: 
     throw cms::Exception("Configuration") 
       << "Chosen jet parametrization is not supported: " << val << "\n";
@@ -15,6 +15,17 @@ kinFitTtFullHadEvent = cms.EDProducer("TtFullHadKinFitProducer",
     # ------------------------------------------------
     maxNJets = cms.int32(6),
 
+    # ------------------------------------------------
+    # choose the maxNJets jets by the sum of their rank
+    # in pt and their rank in the b-tag discriminator
+    # (bTagAlgo) scaled by jetPreselectionBTagWeight,
+    # instead of taking the leading jets; with
+    # useBTagging the b-tagged jets (minBTagValueBJet)
+    # needed for the b partons are always kept
+    # ------------------------------------------------
+    jetPreselection = cms.bool(False),
+    jetPreselectionBTagWeight = cms.double(1.),
+
     #-------------------------------------------------
     # maximum number of jet combinations finally
     # written into the event, starting from the "best"
@@ -23,12 +34,111 @@ kinFitTtFullHadEvent = cms.EDProducer("TtFullHadKinFitProducer",
     #-------------------------------------------------
     maxNComb = cms.int32(1),
 
+    #-------------------------------------------------
+    # embed the fitted covariance matrices of the
+    # particles as kinematic resolutions; computed only
+    # for the maxNComb combinations written (by
+    # refitting them), not for discarded ones
+    #-------------------------------------------------
+    exportFitCovariance = cms.bool(False),
+
+    #-------------------------------------------------
+    # number of threads to distribute the fits of the
+    # jet combinations of an event over, each with its
+    # own fitter (1: no additional threads); the result
+    # does not depend on the number of threads; they
+    # come in addition to the streams of the job.
+    # Limitation: with factoriseFits and constraint 5
+    # (pruning) or with a maxFitTime the fits are done
+    # serially, the threads are not used for them
+    #-------------------------------------------------
+    numThreads = cms.uint32(1),
+
+    #-------------------------------------------------
+    # events with at least offloadMinFits predicted
+    # fits (0: never) are fitted on offloadThreads
+    # dedicated threads shared by the streams of the
+    # module, which frees the framework thread for
+    # other modules until the result is put into the
+    # event (0 threads: all fits on the framework one)
+    #-------------------------------------------------
+    offloadThreads = cms.uint32(0),
+    offloadMinFits = cms.uint32(1000),
+
+    #-------------------------------------------------
+    # write the fit results as one compact product
+    # (TopKinFitResults, instance label "Compact")
+    # instead of the separate collections per parton
+    # and the Chi2/Prob/Status/ConstraintResidual
+    # products; the fitted covariances are not kept
+    # and the event hypotheses need the separate
+    # collections
+    #-------------------------------------------------
+    compactResults = cms.bool(False),
+
+    #-------------------------------------------------
+    # write the fit results as one product encoding
+    # the fitted objects as quantised shifts of
+    # log(pt), eta, phi and log(E) relative to the
+    # input jets (TopKinFitPulls, instance
+    # label "Pulls"); the fitted 4-vectors are read
+    # back from the same input collections
+    #-------------------------------------------------
+    pullResults = cms.bool(False),
+
+    #-------------------------------------------------
+    # budget for the fits of an event: at most
+    # maxNFittedCombis jet combinations are fitted (a
+    # cap on the combinations, the separate fits of the
+    # jet triplets (factoriseFits) are not counted) and
+    # maxFitTime seconds of wall time are spent (0: no
+    # limit); with a budget the jet combinations are
+    # fitted in the order of the pulls of their two W
+    # candidates (dijet mass - mW over its resolution),
+    # the product 'Exhaustive' tells whether all of
+    # them were fitted. A time budget makes the result
+    # depend on the machine load
+    #-------------------------------------------------
+    maxNFittedCombis = cms.uint32(0),
+    maxFitTime       = cms.double(0.),
+
+    #-------------------------------------------------
+    # skip jet combinations with a W candidate whose
+    # dijet mass is more than maxWPull resolutions away
+    # from mW (0: no cut); in every n-th event (n =
+    # wPullValidationPrescale, 0: never) they are fitted
+    # without entering the result, to count how often
+    # the best combination would have been cut
+    #-------------------------------------------------
+    maxWPull                = cms.double(0.),
+    wPullValidationPrescale = cms.uint32(100),
+
+    #-------------------------------------------------
+    # approximate search for the best jet assignment
+    # (0: all combinations): the jets are assigned to
+    # the first W, its b, the second W and its b one
+    # after the other, keeping the beamWidth best
+    # partial assignments by the pulls of the W and top
+    # masses; only the completed ones are fitted and
+    # 'Exhaustive' is false if any were dropped. In
+    # every n-th event (n = beamValidationPrescale, 0:
+    # never) all combinations are fitted to monitor
+    # how often the best one is lost
+    #-------------------------------------------------
+    beamWidth              = cms.uint32(0),
+    beamValidationPrescale = cms.uint32(100),
+
     # ------------------------------------------------
     # option to take only a given jet combination
     # instead of going through the full combinatorics
     # ------------------------------------------------
     match = cms.InputTag(""),
     useOnlyMatch = cms.bool(False),
+    # number of combinations taken from the beginning
+    # of the match collection (e.g. the best ones of an
+    # external ranking) with useOnlyMatch; they are all
+    # fitted and ranked by chi2, invalid ones skipped
+    maxNMatch = cms.uint32(1),
 
     # ------------------------------------------------
     # option to use b-tagging
@@ -55,6 +165,57 @@ kinFitTtFullHadEvent = cms.EDProducer("TtFullHadKinFitProducer",
     maxNrIter = cms.uint32(500),
     maxDeltaS = cms.double(5e-05),
     maxF      = cms.double(0.0001),
+
+    # ------------------------------------------------
+    # keep fits that stopped at maxNrIter (status 1)
+    # with their last state, chi2 and distance from
+    # the constraints; they are ranked together with
+    # the converged fits. The state kept is the last
+    # iterate, not the one of lowest chi2 seen during
+    # the fit (the TKinFitter keeps no history); the
+    # number of kept fits is reported at end of job
+    # ------------------------------------------------
+    keepUnconverged = cms.bool(False),
+
+    # ------------------------------------------------
+    # the fit statistics (number of fits, iterations,
+    # status, wall time, fits per event) are printed
+    # at the end of the job; they are additionally
+    # written in JSON format to this file if not empty
+    # ------------------------------------------------
+    fitStatsJSON = cms.string(""),
+
+    # ------------------------------------------------
+    # report at the end of the job the number of fits
+    # per event predicted from the jets, their b-tags
+    # and the configuration (full enumeration) against
+    # the actual number of fits and the time per fit
+    # ------------------------------------------------
+    costReport = cms.bool(False),
+
+    # ------------------------------------------------
+    # adaptive limit on the number of iterations: after
+    # adaptiveWarmUpFits fits, maxNrIter is lowered to
+    # the adaptiveQuantile of the iterations needed by
+    # converged fits; in every n-th event afterwards
+    # (n = adaptiveValidationPrescale, 0 for none) fits
+    # hitting the lowered limit are repeated with the
+    # configured one to monitor the ranking quality
+    # ------------------------------------------------
+    adaptiveMaxNrIter          = cms.bool(False),
+    adaptiveWarmUpFits         = cms.uint32(10000),
+    adaptiveQuantile           = cms.double(0.999),
+    adaptiveValidationPrescale = cms.uint32(100),
+
+    # ------------------------------------------------
+    # record the inputs of the fits (jets, lepton, MET
+    # and fitted jet combinations) to this file if not
+    # empty; they can be replayed with different fit
+    # settings by the topKinFitterParetoScan tool; in
+    # multithreaded jobs every further stream writes
+    # to its own file with the stream index appended
+    # ------------------------------------------------
+    fitInputDump = cms.string(""),
                                       
     # ------------------------------------------------
     # select parametrisation
@@ -70,6 +231,16 @@ kinFitTtFullHadEvent = cms.EDProducer("TtFullHadKinFitProducer",
     # ------------------------------------------------                                   
     constraints = cms.vuint32(1, 2, 5),
 
+    # ------------------------------------------------
+    # fit each jet triplet (b, q, q') of a top branch
+    # once per event: without constraint 5 the chi2 of
+    # a combination is the sum of its two triplets, with
+    # it this sum is a lower bound used to order the
+    # fits and to skip combinations that cannot be
+    # among the best maxNComb
+    # ------------------------------------------------
+    factoriseFits = cms.bool(False),
+
     # ------------------------------------------------
     # set mass values used in the constraints
     # ------------------------------------------------    
@@ -12,6 +12,17 @@ kinFitTtSemiLepEvent = cms.EDProducer("TtSemiLepKinFitProducerMuon",
     # ------------------------------------------------
     maxNJets = cms.int32(4),
 
+    # ------------------------------------------------
+    # choose the maxNJets jets by the sum of their rank
+    # in pt and their rank in the b-tag discriminator
+    # (bTagAlgo) scaled by jetPreselectionBTagWeight,
+    # instead of taking the leading jets; with
+    # useBTagging the b-tagged jets (minBDiscBJets)
+    # needed for the b partons are always kept
+    # ------------------------------------------------
+    jetPreselection = cms.bool(False),
+    jetPreselectionBTagWeight = cms.double(1.),
+
     #-------------------------------------------------
     # maximum number of jet combinations finally
     # written into the event, starting from the "best"
@@ -20,12 +31,87 @@ kinFitTtSemiLepEvent = cms.EDProducer("TtSemiLepKinFitProducerMuon",
     #-------------------------------------------------
     maxNComb = cms.int32(1),
 
+    #-------------------------------------------------
+    # embed the fitted covariance matrices of the
+    # particles as kinematic resolutions; computed only
+    # for the maxNComb combinations written (by
+    # refitting them), not for discarded ones
+    #-------------------------------------------------
+    exportFitCovariance = cms.bool(False),
+
+    #-------------------------------------------------
+    # number of threads to distribute the fits of the
+    # jet combinations of an event over, each with its
+    # own fitter (1: no additional threads); the result
+    # does not depend on the number of threads; they
+    # come in addition to the streams of the job.
+    # Limitation: with a chi2Bound (pruning) or with
+    # a maxFitTime the fits are done serially, the
+    # threads are not used for them
+    #-------------------------------------------------
+    numThreads = cms.uint32(1),
+
+    #-------------------------------------------------
+    # events with at least offloadMinFits predicted
+    # fits (0: never) are fitted on offloadThreads
+    # dedicated threads shared by the streams of the
+    # module, which frees the framework thread for
+    # other modules until the result is put into the
+    # event (0 threads: all fits on the framework one)
+    #-------------------------------------------------
+    offloadThreads = cms.uint32(0),
+    offloadMinFits = cms.uint32(1000),
+
+    #-------------------------------------------------
+    # write the fit results as one compact product
+    # (TopKinFitResults, instance label "Compact")
+    # instead of the separate collections per parton
+    # and the Chi2/Prob/Status/ConstraintResidual
+    # products; the fitted covariances are not kept
+    # and the event hypotheses need the separate
+    # collections
+    #-------------------------------------------------
+    compactResults = cms.bool(False),
+
+    #-------------------------------------------------
+    # write the fit results as one product encoding
+    # the fitted objects as quantised shifts of
+    # log(pt), eta, phi and log(E) relative to the
+    # input jets, the first lepton and the first MET
+    # (TopKinFitPulls, instance label "Pulls"); the
+    # fitted 4-vectors are read back from the same
+    # input collections
+    #-------------------------------------------------
+    pullResults = cms.bool(False),
+
+    #-------------------------------------------------
+    # budget for the fits of an event: at most
+    # maxNFittedCombis jet combinations are fitted (a
+    # cap on the combinations, the separate fits of the
+    # sides (chi2Bound 2, factorised constraints) are
+    # not counted) and maxFitTime seconds of wall time
+    # are spent (0: no limit); with a budget the jet
+    # combinations are fitted in the order of the
+    # compatibility of their hadronic W and top
+    # candidates with mW and mTop, the product
+    # 'Exhaustive' tells whether all of them were
+    # fitted. A time budget makes the result depend on
+    # the machine load
+    #-------------------------------------------------
+    maxNFittedCombis = cms.uint32(0),
+    maxFitTime       = cms.double(0.),
+
     # ------------------------------------------------
     # option to take only a given jet combination
     # instead of going through the full combinatorics
     # ------------------------------------------------
     match = cms.InputTag("findTtSemiLepJetCombMVA"),
     useOnlyMatch = cms.bool(False),
+    # number of combinations taken from the beginning
+    # of the match collection (e.g. the best ones of an
+    # external ranking) with useOnlyMatch; they are all
+    # fitted and ranked by chi2, invalid ones skipped
+    maxNMatch = cms.uint32(1),
                                       
     # ------------------------------------------------
     # option to use b-tagging
@@ -41,13 +127,73 @@ kinFitTtSemiLepEvent = cms.EDProducer("TtSemiLepKinFitProducerMuon",
     maxNrIter = cms.uint32(500),
     maxDeltaS = cms.double(5e-05),
     maxF      = cms.double(0.0001),
+
+    # ------------------------------------------------
+    # keep fits that stopped at maxNrIter (status 1)
+    # with their last state, chi2 and distance from
+    # the constraints; they are ranked together with
+    # the converged fits. The state kept is the last
+    # iterate, not the one of lowest chi2 seen during
+    # the fit (the TKinFitter keeps no history); the
+    # number of kept fits is reported at end of job
+    # ------------------------------------------------
+    keepUnconverged = cms.bool(False),
+
+    # ------------------------------------------------
+    # the fit statistics (number of fits, iterations,
+    # status, wall time, fits per event) are printed
+    # at the end of the job; they are additionally
+    # written in JSON format to this file if not empty
+    # ------------------------------------------------
+    fitStatsJSON = cms.string(""),
+
+    # ------------------------------------------------
+    # report at the end of the job the number of fits
+    # per event predicted from the jets, their b-tags
+    # and the configuration (full enumeration) against
+    # the actual number of fits and the time per fit
+    # ------------------------------------------------
+    costReport = cms.bool(False),
+
+    # ------------------------------------------------
+    # adaptive limit on the number of iterations: after
+    # adaptiveWarmUpFits fits, maxNrIter is lowered to
+    # the adaptiveQuantile of the iterations needed by
+    # converged fits; in every n-th event afterwards
+    # (n = adaptiveValidationPrescale, 0 for none) fits
+    # hitting the lowered limit are repeated with the
+    # configured one to monitor the ranking quality
+    # ------------------------------------------------
+    adaptiveMaxNrIter          = cms.bool(False),
+    adaptiveWarmUpFits         = cms.uint32(10000),
+    adaptiveQuantile           = cms.double(0.999),
+    adaptiveValidationPrescale = cms.uint32(100),
+
+    # ------------------------------------------------
+    # record the inputs of the fits (jets, lepton, MET
+    # and fitted jet combinations) to this file if not
+    # empty; they can be replayed with different fit
+    # settings by the topKinFitterParetoScan tool; in
+    # multithreaded jobs every further stream writes
+    # to its own file with the stream index appended
+    # ------------------------------------------------
+    fitInputDump = cms.string(""),
     # ------------------------------------------------
     # select parametrisation
     # 0: EMom, 1: EtEtaPhi, 2: EtThetaPhi
+    # 3: EtPhiPz (MET only; Et and phi measured, pz
+    #    unmeasured; requires a leptonic mass constraint
+    #    and excludes the neutrino mass constraint)
     # ------------------------------------------------
     jetParametrisation = cms.uint32(1),
     lepParametrisation = cms.uint32(1),
     metParametrisation = cms.uint32(1),
+
+    # ------------------------------------------------
+    # keep the lepton as fixed 4-vector: it enters the
+    # leptonic mass constraints but is not fitted
+    # ------------------------------------------------
+    fixLepton = cms.bool(False),
                                       
     # ------------------------------------------------
     # set constraints
@@ -56,6 +202,43 @@ kinFitTtSemiLepEvent = cms.EDProducer("TtSemiLepKinFitProducerMuon",
     # 7: sum-pt conservation
     # ------------------------------------------------                                   
     constraints = cms.vuint32(1, 2),
+
+    # ------------------------------------------------
+    # without the constraints 6 and 7 the hadronic and
+    # the leptonic side are independent: fit each jet
+    # triplet and leptonic b jet once and add the chi2
+    # ------------------------------------------------
+    factoriseFits = cms.bool(False),
+
+    # ------------------------------------------------
+    # lower bound on the chi2 of the combinations that
+    # are not factorised: they are fitted lowest bound
+    # first and skipped once it exceeds the worst of
+    # the maxNComb kept fits
+    # 0: none
+    # 1: estimated from the pulls of the constrained
+    #    masses (cheap, but not safe: 'Exhaustive' is
+    #    false if combinations were skipped)
+    # 2: fits without the constraints 6 and 7, each jet
+    #    triplet and leptonic b jet once (safe up to
+    #    the convergence criteria)
+    # ------------------------------------------------
+    chi2Bound = cms.uint32(0),
+
+    # ------------------------------------------------
+    # approximate search for the best jet assignment
+    # (0: all combinations): the jets are assigned to
+    # the hadronic W, the hadronic and the leptonic b
+    # one after the other, keeping the beamWidth best
+    # partial assignments by the pulls of the W and top
+    # masses; only the completed ones are fitted and
+    # 'Exhaustive' is false if any were dropped. In
+    # every n-th event (n = beamValidationPrescale, 0
+    # for none) all combinations are fitted to monitor
+    # how often the best one is lost
+    # ------------------------------------------------
+    beamWidth              = cms.uint32(0),
+    beamValidationPrescale = cms.uint32(100),
                                       
     # ------------------------------------------------
     # set mass values used in the constraints
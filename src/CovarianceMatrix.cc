@@ -137,6 +137,7 @@ double CovarianceMatrix::getResolution(const TLorentzVector& object, const Objec
 
 TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const ObjectType objType, const TopKinFitter::Param param)
 {
+  TMatrixD CovM2 (2,2); CovM2.Zero();
   TMatrixD CovM3 (3,3); CovM3.Zero();
   TMatrixD CovM4 (4,4); CovM4.Zero();
   const double pt  = object.Pt();
@@ -173,6 +174,8 @@ TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const Objec
 	CovM3(1,1) = pow(jetRes.theta(pt, eta, res::HelperJet::kUds), 2);
 	CovM3(2,2) = pow(jetRes.phi  (pt, eta, res::HelperJet::kUds), 2);
 	return CovM3;
+      case TopKinFitter::kEtPhiPz :
+	throw cms::Exception("Configuration") << "The parametrisation EtPhiPz is only supported for the MET!\n";
       }
     }
     break;
@@ -207,6 +210,8 @@ TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const Objec
 	CovM3(1,1) = pow(jetRes.theta(pt, eta, res::HelperJet::kB), 2);
 	CovM3(2,2) = pow(jetRes.phi  (pt, eta, res::HelperJet::kB), 2);
 	return CovM3;
+      case TopKinFitter::kEtPhiPz :
+	throw cms::Exception("Configuration") << "The parametrisation EtPhiPz is only supported for the MET!\n";
       }
     }
     break;
@@ -237,6 +242,8 @@ TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const Objec
 	CovM3(1,1) = pow(muonRes.theta(pt, eta), 2); 
 	CovM3(2,2) = pow(muonRes.phi  (pt, eta), 2);
 	return CovM3;
+      case TopKinFitter::kEtPhiPz :
+	throw cms::Exception("Configuration") << "The parametrisation EtPhiPz is only supported for the MET!\n";
       }
     }
     break;
@@ -267,6 +274,8 @@ TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const Objec
 	CovM3(1,1) = pow(elecRes.theta(pt, eta), 2); 
 	CovM3(2,2) = pow(elecRes.phi  (pt, eta), 2);
 	return CovM3;
+      case TopKinFitter::kEtPhiPz :
+	throw cms::Exception("Configuration") << "The parametrisation EtPhiPz is only supported for the MET!\n";
       }
     }
     break;
@@ -297,6 +306,16 @@ TMatrixD CovarianceMatrix::setupMatrix(const TLorentzVector& object, const Objec
 	CovM3(1,1) = pow(        9999. , 2);
 	CovM3(2,2) = pow(metRes.phi(pt), 2);
 	return CovM3;
+      case TopKinFitter::kEtPhiPz :
+	if(!binsMet_.size()){
+	  CovM2(0,0) = pow(metRes.et(pt) , 2);
+	  CovM2(1,1) = pow(metRes.phi(pt), 2);
+	}
+	else{
+	  CovM2(0,0) = pow(getResolution(object, objType, "et") , 2);
+	  CovM2(1,1) = pow(getResolution(object, objType, "phi"), 2);
+	}
+	return CovM2;
       }
     }
     break;
@@ -2,6 +2,8 @@
 // $Id: StKinFitter.cc,v 1.8 2010/09/06 13:46:16 snaumann Exp $
 //
 
+#include <algorithm>
+
 #include "PhysicsTools/KinFitter/interface/TKinFitter.h"
 #include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
 #include "PhysicsTools/KinFitter/interface/TFitConstraintM.h"
@@ -9,6 +11,10 @@
 #include "PhysicsTools/KinFitter/interface/TFitParticleEScaledMomDev.h"
 #include "PhysicsTools/KinFitter/interface/TFitParticleEtEtaPhi.h"
 #include "PhysicsTools/KinFitter/interface/TFitParticleEtThetaPhi.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticleEtPhi.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticlePz.h"
+
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "DataFormats/PatCandidates/interface/Particle.h"
 #include "TopQuarkAnalysis/TopKinFitter/interface/StKinFitter.h"
@@ -27,6 +33,7 @@
 
 StKinFitter::StKinFitter() :
   TopKinFitter(),
+  fitNeutrinoPz_(0),
   jetParam_(kEMom), 
   lepParam_(kEMom), 
   metParam_(kEMom)
@@ -37,6 +44,7 @@ StKinFitter::StKinFitter() :
 StKinFitter::StKinFitter(int jetParam, int lepParam, int metParam,
 			 int maxNrIter, double maxDeltaS, double maxF, const std::vector<int>& constraints) :
   TopKinFitter(maxNrIter, maxDeltaS, maxF),
+  fitNeutrinoPz_(0),
   jetParam_((Param) jetParam), 
   lepParam_((Param) lepParam), 
   metParam_((Param) metParam),
@@ -48,6 +56,7 @@ StKinFitter::StKinFitter(int jetParam, int lepParam, int metParam,
 StKinFitter::StKinFitter(Param jetParam, Param lepParam, Param metParam,
                          int maxNrIter, double maxDeltaS, double maxF, const std::vector<int>& constraints) :
   TopKinFitter(maxNrIter, maxDeltaS, maxF),
+  fitNeutrinoPz_(0),
   jetParam_(jetParam),
   lepParam_(lepParam),
   metParam_(metParam),
@@ -59,7 +68,8 @@ StKinFitter::StKinFitter(Param jetParam, Param lepParam, Param metParam,
 StKinFitter::~StKinFitter() 
 {
   delete cons1_; delete cons2_; delete cons3_;
-  delete fitBottom_; delete fitLight_; delete fitLepton_; delete fitNeutrino_;
+  delete fitBottom_; delete fitLight_; delete fitLepton_; delete fitNeutrino_; delete fitNeutrinoPz_;
+  delete covM_;
 }
 
 StEvtSolution StKinFitter::addKinFitInfo(StEvtSolution * asol) 
@@ -72,6 +82,7 @@ StEvtSolution StKinFitter::addKinFitInfo(StEvtSolution * asol)
   m1.Zero();  m2.Zero();
   m1b.Zero(); m2b.Zero();
   m3.Zero();  m4.Zero();
+  if (metParam_ == kEtPhiPz) m4.ResizeTo(2,2);
   
   TLorentzVector bottomVec(fitsol.getBottom().px(),fitsol.getBottom().py(),
                            fitsol.getBottom().pz(),fitsol.getBottom().energy());
@@ -175,25 +186,14 @@ StEvtSolution StKinFitter::addKinFitInfo(StEvtSolution * asol)
       m4(0,0) = pow(metRes.met(met), 2);
       m4(1,1) = pow(         9999.,  2);
       m4(2,2) = pow(metRes.phi(met), 2);
+    } else if (metParam_ == kEtPhiPz) {
+      m4(0,0) = pow(metRes.met(met), 2);
+      m4(1,1) = pow(metRes.phi(met), 2);
     }
   }
-  // set the kinematics of the objects to be fitted
-  fitBottom_->setIni4Vec(&bottomVec);
-  fitLight_->setIni4Vec(&lightVec);
-  fitLepton_->setIni4Vec(&leplVec);
-  fitNeutrino_->setIni4Vec(&lepnVec);
-  if (jetParam_ == kEMom) {
-    fitBottom_->setCovMatrix(&m1b);
-    fitLight_->setCovMatrix(&m2b);
-  } else {
-    fitBottom_->setCovMatrix(&m1);
-    fitLight_->setCovMatrix(&m2);
-  }
-  fitLepton_->setCovMatrix(&m3);
-  fitNeutrino_->setCovMatrix(&m4);
-
   // perform the fit!
-  fitter_->fit();
+  if (jetParam_ == kEMom) fit(bottomVec, lightVec, leplVec, lepnVec, m1b, m2b, m3, m4);
+  else                    fit(bottomVec, lightVec, leplVec, lepnVec, m1 , m2 , m3, m4);
   
   // add fitted information to the solution
   if (fitter_->getStatus() == 0) {
@@ -204,8 +204,13 @@ StEvtSolution StKinFitter::addKinFitInfo(StEvtSolution * asol)
     // read back the lepton kinematics and resolutions
     pat::Particle aFitLepton(reco::LeafCandidate(0, math::XYZTLorentzVector(fitLepton_->getCurr4Vec()->X(), fitLepton_->getCurr4Vec()->Y(), fitLepton_->getCurr4Vec()->Z(), fitLepton_->getCurr4Vec()->E()), math::XYZPoint()));
 
-    // read back the MET kinematics and resolutions
-    pat::Particle aFitNeutrino(reco::LeafCandidate(0, math::XYZTLorentzVector(fitNeutrino_->getCurr4Vec()->X(), fitNeutrino_->getCurr4Vec()->Y(), fitNeutrino_->getCurr4Vec()->Z(), fitNeutrino_->getCurr4Vec()->E()), math::XYZPoint()));   
+    // read back the MET kinematics and resolutions (adding the fitted pz for the EtPhiPz parametrisation)
+    TLorentzVector p4FitNeutrino(*fitNeutrino_->getCurr4Vec());
+    if (fitNeutrinoPz_) {
+      p4FitNeutrino.SetPz(fitNeutrinoPz_->getCurr4Vec()->Z());
+      p4FitNeutrino.SetE (p4FitNeutrino.P());
+    }
+    pat::Particle aFitNeutrino(reco::LeafCandidate(0, math::XYZTLorentzVector(p4FitNeutrino.X(), p4FitNeutrino.Y(), p4FitNeutrino.Z(), p4FitNeutrino.E()), math::XYZPoint()));   
     
     // finally fill the fitted particles
     fitsol.setFitBottom(aFitBottom);
@@ -221,6 +226,38 @@ StEvtSolution StKinFitter::addKinFitInfo(StEvtSolution * asol)
 
 }
 
+int StKinFitter::fit(const TLorentzVector& p4Bottom, const TLorentzVector& p4Light, const TLorentzVector& p4Lepton,
+		     const TLorentzVector& p4Neutrino, const CovarianceMatrix::ObjectType leptonType)
+{
+  // initialize covariance matrices
+  TMatrixD covBottom   = covM_->setupMatrix(p4Bottom,   CovarianceMatrix::kBJet,    jetParam_);
+  TMatrixD covLight    = covM_->setupMatrix(p4Light,    CovarianceMatrix::kUdscJet, jetParam_);
+  TMatrixD covLepton   = covM_->setupMatrix(p4Lepton,   leptonType,                 lepParam_);
+  TMatrixD covNeutrino = covM_->setupMatrix(p4Neutrino, CovarianceMatrix::kMet,     metParam_);
+
+  return fit(p4Bottom, p4Light, p4Lepton, p4Neutrino, covBottom, covLight, covLepton, covNeutrino);
+}
+
+int StKinFitter::fit(const TLorentzVector& p4Bottom, const TLorentzVector& p4Light, const TLorentzVector& p4Lepton,
+		     const TLorentzVector& p4Neutrino, const TMatrixD& covBottom, const TMatrixD& covLight,
+		     const TMatrixD& covLepton, const TMatrixD& covNeutrino)
+{
+  // set the kinematics of the objects to be fitted
+  fitBottom_->setIni4Vec(&p4Bottom);
+  fitLight_->setIni4Vec(&p4Light);
+  fitLepton_->setIni4Vec(&p4Lepton);
+  // the neutrino pz has to be set before the Et/phi part, which needs it for the energy
+  if (fitNeutrinoPz_) fitNeutrinoPz_->setIni4Vec(&p4Neutrino);
+  fitNeutrino_->setIni4Vec(&p4Neutrino);
+  fitBottom_->setCovMatrix(&covBottom);
+  fitLight_->setCovMatrix(&covLight);
+  fitLepton_->setCovMatrix(&covLepton);
+  fitNeutrino_->setCovMatrix(&covNeutrino);
+
+  // perform the fit!
+  return runFit();
+}
+
 //
 // Setup the fitter
 //
@@ -245,7 +282,19 @@ void StKinFitter::setupFitter() {
   std::cout<<"Max. F: "<<maxF_<<std::endl;
   std::cout<<"++++++++++++++++++++++++++++++++++++++++++++"<<std::endl<<std::endl<<std::endl;
 
-  TMatrixD empty3(3,3); TMatrixD empty4(4,4);
+  // the reduced Et/phi parametrisation only describes the neutrino, whose pz has
+  // to be fixed by one of the mass constraints involving it
+  if (jetParam_ == kEtPhiPz || lepParam_ == kEtPhiPz)
+    throw cms::Exception("Configuration") << "The parametrisation EtPhiPz is only supported for the MET\n";
+  if (metParam_ == kEtPhiPz) {
+    if (std::find(constraints_.begin(), constraints_.end(), 3) != constraints_.end())
+      throw cms::Exception("Configuration") << "The neutrino mass constraint cannot be used with the MET parametrisation EtPhiPz\n";
+    if (std::find(constraints_.begin(), constraints_.end(), 1) == constraints_.end() &&
+	std::find(constraints_.begin(), constraints_.end(), 2) == constraints_.end())
+      throw cms::Exception("Configuration") << "The MET parametrisation EtPhiPz requires a W-mass or top-mass constraint\n";
+  }
+
+  TMatrixD empty2(2,2); TMatrixD empty3(3,3); TMatrixD empty4(4,4);
   if (jetParam_ == kEMom) {
     fitBottom_ = new TFitParticleEMomDev("Jet1", "Jet1", 0, &empty4);
     fitLight_  = new TFitParticleEMomDev("Jet2", "Jet2", 0, &empty4);
@@ -269,6 +318,12 @@ void StKinFitter::setupFitter() {
     fitNeutrino_ = new TFitParticleEtEtaPhi("Neutrino", "Neutrino", 0, &empty3);
   } else if (metParam_ == kEtThetaPhi) {
     fitNeutrino_ = new TFitParticleEtThetaPhi("Neutrino", "Neutrino", 0, &empty3);
+  } else if (metParam_ == kEtPhiPz) {
+    TFitParticlePz*    pz    = new TFitParticlePz("NeutrinoPz", "NeutrinoPz", 0);
+    TFitParticleEtPhi* etPhi = new TFitParticleEtPhi("Neutrino", "Neutrino", 0, &empty2, pz);
+    pz->setEtPhi(etPhi);
+    fitNeutrino_   = etPhi;
+    fitNeutrinoPz_ = pz;
   }
 
   cons1_ = new TFitConstraintM("MassConstraint", "Mass-Constraint", 0, 0 , mW_);
@@ -277,6 +332,10 @@ void StKinFitter::setupFitter() {
   cons2_->addParticles1(fitLepton_, fitNeutrino_, fitBottom_);
   cons3_ = new TFitConstraintM("MassConstraint", "Mass-Constraint", 0, 0, 0.);
   cons3_->addParticle1(fitNeutrino_);
+  if (fitNeutrinoPz_) {
+    cons1_->addParticle1(fitNeutrinoPz_);
+    cons2_->addParticle1(fitNeutrinoPz_);
+  }
 
   for (unsigned int i=0; i<constraints_.size(); i++) {
     if (constraints_[i] == 1) fitter_->addConstraint(cons1_);
@@ -287,5 +346,8 @@ void StKinFitter::setupFitter() {
   fitter_->addMeasParticle(fitLight_);
   fitter_->addMeasParticle(fitLepton_);
   fitter_->addMeasParticle(fitNeutrino_);
-  
+  if (fitNeutrinoPz_) fitter_->addUnmeasParticle(fitNeutrinoPz_);
+
+  // the plain 4-vec interface uses the default resolutions
+  covM_ = new CovarianceMatrix();
 }
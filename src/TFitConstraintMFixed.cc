@@ -0,0 +1,66 @@
+#include <algorithm>
+
+#include "TMath.h"
+
+#include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitConstraintMFixed.h"
+
+/// constructor
+TFitConstraintMFixed::TFitConstraintMFixed(const TString& name, const TString& title, std::vector<TAbsFitParticle*>* particles1,
+					   std::vector<TAbsFitParticle*>* particles2, Double_t mass):
+  TFitConstraintM(name, title, particles1, particles2, mass)
+{
+}
+
+/// sum of the 4-vectors of the given particles and the fixed 4-vector
+TLorentzVector
+TFitConstraintMFixed::sum(const std::vector<TAbsFitParticle*>& particles, const TLorentzVector& fixed, bool initial) const
+{
+  TLorentzVector p4(fixed);
+  for(unsigned int i=0; i<particles.size(); ++i)
+    p4 += (initial ? *particles[i]->getIni4Vec() : *particles[i]->getCurr4Vec());
+  return p4;
+}
+
+/// value of the constraint for the initial parameters
+Double_t
+TFitConstraintMFixed::getInitValue()
+{
+  return sum(_ParList1, fixed1_, true).M() - sum(_ParList2, fixed2_, true).M() - _TheMassConstraint;
+}
+
+/// value of the constraint for the current parameters
+Double_t
+TFitConstraintMFixed::getCurrentValue()
+{
+  return sum(_ParList1, fixed1_, false).M() - sum(_ParList2, fixed2_, false).M() - _TheMassConstraint;
+}
+
+/// derivative of the constraint w.r.t. the parameters of the given particle:
+/// dM/dp = (-px, -py, -pz, E)/M of the summed 4-vector times the derivative
+/// of the 4-vector of the particle w.r.t. its parameters
+TMatrixD*
+TFitConstraintMFixed::getDerivative(TAbsFitParticle* particle)
+{
+  TMatrixD derivative(1,4);
+  derivative.Zero();
+  TLorentzVector p4;
+  double factor = 0.;
+  if(std::find(_ParList1.begin(), _ParList1.end(), particle)!=_ParList1.end()){
+    p4 = sum(_ParList1, fixed1_, false);
+    factor = ( p4.M()>0. ? 1./p4.M() : 0.);
+  }
+  else if(std::find(_ParList2.begin(), _ParList2.end(), particle)!=_ParList2.end()){
+    p4 = sum(_ParList2, fixed2_, false);
+    factor = ( p4.M()>0. ? -1./p4.M() : 0.);
+  }
+  derivative(0,0) = -p4.Px()*factor;
+  derivative(0,1) = -p4.Py()*factor;
+  derivative(0,2) = -p4.Pz()*factor;
+  derivative(0,3) =  p4.E ()*factor;
+
+  TMatrixD* derivativeParticle = particle->getDerivative();
+  TMatrixD* result = new TMatrixD(derivative, TMatrixD::kMult, *derivativeParticle);
+  delete derivativeParticle;
+  return result;
+}
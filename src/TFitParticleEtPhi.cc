@@ -0,0 +1,94 @@
+#include "TMath.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticleEtPhi.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticlePz.h"
+
+/// constructor
+TFitParticleEtPhi::TFitParticleEtPhi(const TString& name, const TString& title, const TLorentzVector* pini, const TMatrixD* theCovMatrix, TFitParticlePz* pz):
+  TAbsFitParticle(name, title), pz_(pz)
+{
+  _nPar = 2;
+  setIni4Vec(pini);
+  setCovMatrix(theCovMatrix);
+}
+
+/// clone the particle
+TAbsFitParticle*
+TFitParticleEtPhi::clone(TString newname) const
+{
+  TAbsFitParticle* myclone = new TFitParticleEtPhi(*this);
+  if(newname.Length()>0) myclone->SetName(newname);
+  return myclone;
+}
+
+/// calculate the 4-vector from the parameters
+TLorentzVector*
+TFitParticleEtPhi::calc4Vec(const TMatrixD* params)
+{
+  if(params==0 || params->GetNcols()!=1 || params->GetNrows()!=_nPar) return 0;
+  const double et  = (*params)(0,0);
+  const double phi = (*params)(1,0);
+  const double pz  = (pz_ ? pz_->pz() : 0.);
+  return new TLorentzVector(et*TMath::Cos(phi), et*TMath::Sin(phi), 0., TMath::Sqrt(et*et+pz*pz));
+}
+
+/// set the initial 4-vector
+void
+TFitParticleEtPhi::setIni4Vec(const TLorentzVector* pini)
+{
+  _iniparameters.ResizeTo(_nPar,1);
+  _parameters   .ResizeTo(_nPar,1);
+  if(pini==0){
+    _iniparameters(0,0) = 0.;
+    _iniparameters(1,0) = 0.;
+    _u1.SetXYZ(0., 0., 0.);
+    _u2.SetXYZ(0., 0., 0.);
+    _u3.SetXYZ(0., 0., 0.);
+  }
+  else{
+    const double phi = pini->Phi();
+    _iniparameters(0,0) = pini->Pt();
+    _iniparameters(1,0) = phi;
+    _u1.SetXYZ( TMath::Cos(phi), TMath::Sin(phi), 0.);
+    _u2.SetXYZ(-TMath::Sin(phi), TMath::Cos(phi), 0.);
+    _u3.SetXYZ(0., 0., 1.);
+  }
+  _parameters = _iniparameters;
+  TLorentzVector* vec = calc4Vec(&_parameters);
+  _pini  = *vec;
+  _pcurr = _pini;
+  delete vec;
+}
+
+/// derivative of the 4-vector w.r.t. the parameters (Et, phi)
+TMatrixD*
+TFitParticleEtPhi::getDerivative()
+{
+  TMatrixD* derivativeMatrix = new TMatrixD(4,2);
+  (*derivativeMatrix) *= 0.;
+  const double et  = _parameters(0,0);
+  const double phi = _parameters(1,0);
+  const double pz  = (pz_ ? pz_->pz() : 0.);
+  const double e   = TMath::Sqrt(et*et+pz*pz);
+  // 1st column: dP/d(Et)
+  (*derivativeMatrix)(0,0) = TMath::Cos(phi);
+  (*derivativeMatrix)(1,0) = TMath::Sin(phi);
+  (*derivativeMatrix)(2,0) = 0.;
+  (*derivativeMatrix)(3,0) = (e>0. ? et/e : 1.);
+  // 2nd column: dP/d(phi)
+  (*derivativeMatrix)(0,1) = -et*TMath::Sin(phi);
+  (*derivativeMatrix)(1,1) =  et*TMath::Cos(phi);
+  (*derivativeMatrix)(2,1) = 0.;
+  (*derivativeMatrix)(3,1) = 0.;
+  return derivativeMatrix;
+}
+
+/// convert a 4-vector to the parameters (Et, phi)
+TMatrixD*
+TFitParticleEtPhi::transform(const TLorentzVector& vec)
+{
+  TMatrixD* tparams = new TMatrixD(_nPar,1);
+  (*tparams)(0,0) = vec.Pt();
+  (*tparams)(1,0) = vec.Phi();
+  return tparams;
+}
@@ -0,0 +1,69 @@
+#include "TMath.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticlePz.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticleEtPhi.h"
+
+/// constructor
+TFitParticlePz::TFitParticlePz(const TString& name, const TString& title, const TLorentzVector* pini, TFitParticleEtPhi* etPhi):
+  TAbsFitParticle(name, title), etPhi_(etPhi)
+{
+  _nPar = 1;
+  setIni4Vec(pini);
+  setCovMatrix(0);
+}
+
+/// clone the particle
+TAbsFitParticle*
+TFitParticlePz::clone(TString newname) const
+{
+  TAbsFitParticle* myclone = new TFitParticlePz(*this);
+  if(newname.Length()>0) myclone->SetName(newname);
+  return myclone;
+}
+
+/// calculate the 4-vector from the parameters
+TLorentzVector*
+TFitParticlePz::calc4Vec(const TMatrixD* params)
+{
+  if(params==0 || params->GetNcols()!=1 || params->GetNrows()!=_nPar) return 0;
+  return new TLorentzVector(0., 0., (*params)(0,0), 0.);
+}
+
+/// set the initial 4-vector
+void
+TFitParticlePz::setIni4Vec(const TLorentzVector* pini)
+{
+  _iniparameters.ResizeTo(_nPar,1);
+  _parameters   .ResizeTo(_nPar,1);
+  _iniparameters(0,0) = (pini ? pini->Pz() : 0.);
+  _parameters = _iniparameters;
+  _u1.SetXYZ(0., 0., 1.);
+  _u2.SetXYZ(0., 0., 0.);
+  _u3.SetXYZ(0., 0., 0.);
+  _pini.SetXYZT(0., 0., _iniparameters(0,0), 0.);
+  _pcurr = _pini;
+}
+
+/// derivative of the 4-vector w.r.t. the parameter pz; includes the
+/// dependence of the energy of the companion on pz
+TMatrixD*
+TFitParticlePz::getDerivative()
+{
+  TMatrixD* derivativeMatrix = new TMatrixD(4,1);
+  (*derivativeMatrix) *= 0.;
+  const double pz = _parameters(0,0);
+  const double et = (etPhi_ ? etPhi_->et() : 0.);
+  const double e  = TMath::Sqrt(et*et+pz*pz);
+  (*derivativeMatrix)(2,0) = 1.;
+  (*derivativeMatrix)(3,0) = (e>0. ? pz/e : 0.);
+  return derivativeMatrix;
+}
+
+/// convert a 4-vector to the parameter pz
+TMatrixD*
+TFitParticlePz::transform(const TLorentzVector& vec)
+{
+  TMatrixD* tparams = new TMatrixD(_nPar,1);
+  (*tparams)(0,0) = vec.Pz();
+  return tparams;
+}
@@ -0,0 +1,103 @@
+#include <cmath>
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "DataFormats/Math/interface/deltaPhi.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitPulls.h"
+
+const short TopKinFitPulls::kInvalid;
+
+/// default constructor (for the dictionary)
+TopKinFitPulls::TopKinFitPulls():
+  nJets_(0)
+{
+}
+
+/// constructor with the position in the jet combination of the jet measuring each role
+/// (-1 for roles measured by other objects) and the number of jets per combination
+TopKinFitPulls::TopKinFitPulls(const std::vector<int>& roleJets, const unsigned int nJets):
+  nJets_(nJets), roleJets_(roleJets.begin(), roleJets.end())
+{
+}
+
+/// return the quantisation unit of a parameter
+double
+TopKinFitPulls::unit(const unsigned int par)
+{
+  // the range of the log ratios and of eta (+-6.5) covers the neutrino, measured at eta=0
+  switch(par){
+  case kPhi : return 1.e-4;
+  default   : return 2.e-4;
+  }
+}
+
+/// quantise the shift of a parameter
+short
+TopKinFitPulls::encode(const double shift, const unsigned int par)
+{
+  const double code = std::floor(shift/unit(par)+0.5);
+  if(code> 32767.) return  32767;
+  if(code<-32767.) return -32767;
+  return (short)code;
+}
+
+/// add a combination: fitted and measured objects per role (the measured objects of the jet
+/// roles are the jets of jetCombi), jet indices, chi2, probability, status and constraint residual
+void
+TopKinFitPulls::push_back(const std::vector<const reco::Candidate*>& fitted, const std::vector<const reco::Candidate*>& measured,
+			  const std::vector<int>& jetCombi, const double chi2, const double prob, const int status, const double residual)
+{
+  if(fitted.size()!=nRoles() || measured.size()!=nRoles() || jetCombi.size()!=nJets_)
+    throw cms::Exception("LogicError") << "TopKinFitPulls expects " << nRoles() << " fitted and measured objects and " << nJets_
+				       << " jet indices per combination, got " << fitted.size() << ", " << measured.size()
+				       << " and " << jetCombi.size() << "\n";
+  for(unsigned int role=0; role<nRoles(); ++role){
+    const reco::Candidate* fit = fitted[role];
+    const reco::Candidate* mes = measured[role];
+    if(!fit || !mes || fit->pt()<=0 || fit->energy()<=0 || mes->pt()<=0 || mes->energy()<=0){
+      codes_.insert(codes_.end(), kNParameters, kInvalid);
+      continue;
+    }
+    codes_.push_back(encode(std::log(fit->pt()/mes->pt()), kLogPt));
+    codes_.push_back(encode(fit->eta()-mes->eta(), kEta));
+    codes_.push_back(encode(reco::deltaPhi(fit->phi(), mes->phi()), kPhi));
+    codes_.push_back(encode(std::log(fit->energy()/mes->energy()), kLogE));
+  }
+  for(unsigned int k=0; k<nJets_; ++k)
+    jets_.push_back(jetCombi[k]);
+  chi2_  .push_back(chi2);
+  prob_  .push_back(prob);
+  status_.push_back(status);
+  residual_.push_back(residual);
+}
+
+/// reserve the space for n combinations
+void
+TopKinFitPulls::reserve(const unsigned int n)
+{
+  codes_.reserve(n*nRoles()*kNParameters);
+  jets_.reserve(n*nJets_);
+  chi2_  .reserve(n);
+  prob_  .reserve(n);
+  status_.reserve(n);
+  residual_.reserve(n);
+}
+
+/// return the fitted 4-vector of a role of combination i given its measured object
+math::XYZTLorentzVector
+TopKinFitPulls::p4(const unsigned int i, const unsigned int role, const reco::Candidate& measured) const
+{
+  if(code(i, role, kLogPt)==kInvalid)
+    return math::XYZTLorentzVector();
+  const double pt  = measured.pt()*std::exp(code(i, role, kLogPt)*unit(kLogPt));
+  const double eta = measured.eta()+code(i, role, kEta)*unit(kEta);
+  const double phi = measured.phi()+code(i, role, kPhi)*unit(kPhi);
+  const double e   = measured.energy()*std::exp(code(i, role, kLogE)*unit(kLogE));
+  return math::XYZTLorentzVector(pt*std::cos(phi), pt*std::sin(phi), pt*std::sinh(eta), e);
+}
+
+/// return the jet indices of combination i
+std::vector<int>
+TopKinFitPulls::jetCombi(const unsigned int i) const
+{
+  return std::vector<int>(jets_.begin()+i*nJets_, jets_.begin()+(i+1)*nJets_);
+}
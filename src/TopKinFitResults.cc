@@ -0,0 +1,84 @@
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitResults.h"
+
+/// default constructor (for the dictionary)
+TopKinFitResults::TopKinFitResults():
+  nRoles_(0), nJets_(0)
+{
+}
+
+/// constructor with the number of roles and of jets per combination
+TopKinFitResults::TopKinFitResults(const unsigned int nRoles, const unsigned int nJets):
+  nRoles_(nRoles), nJets_(nJets)
+{
+}
+
+/// add a combination: fitted objects per role, jet indices, chi2, probability, status and constraint residual
+void
+TopKinFitResults::push_back(const std::vector<const reco::Candidate*>& fitted, const std::vector<int>& jetCombi,
+			    const double chi2, const double prob, const int status, const double residual)
+{
+  if(fitted.size()!=nRoles_ || jetCombi.size()!=nJets_)
+    throw cms::Exception("LogicError") << "TopKinFitResults expects " << nRoles_ << " fitted objects and " << nJets_
+				       << " jet indices per combination, got " << fitted.size() << " and " << jetCombi.size() << "\n";
+  for(unsigned int role=0; role<nRoles_; ++role){
+    px_.push_back(fitted[role]->px());
+    py_.push_back(fitted[role]->py());
+    pz_.push_back(fitted[role]->pz());
+    e_ .push_back(fitted[role]->energy());
+  }
+  for(unsigned int k=0; k<nJets_; ++k)
+    jets_.push_back(jetCombi[k]);
+  chi2_  .push_back(chi2);
+  prob_  .push_back(prob);
+  status_.push_back(status);
+  residual_.push_back(residual);
+}
+
+/// reserve the space for n combinations
+void
+TopKinFitResults::reserve(const unsigned int n)
+{
+  px_.reserve(n*nRoles_);
+  py_.reserve(n*nRoles_);
+  pz_.reserve(n*nRoles_);
+  e_ .reserve(n*nRoles_);
+  jets_.reserve(n*nJets_);
+  chi2_  .reserve(n);
+  prob_  .reserve(n);
+  status_.reserve(n);
+  residual_.reserve(n);
+}
+
+/// return the fitted 4-vector of a role of combination i
+math::XYZTLorentzVector
+TopKinFitResults::p4(const unsigned int i, const unsigned int role) const
+{
+  const unsigned int idx = i*nRoles_+role;
+  return math::XYZTLorentzVector(px_[idx], py_[idx], pz_[idx], e_[idx]);
+}
+
+/// return the fitted object of a role of combination i as pat::Particle
+pat::Particle
+TopKinFitResults::particle(const unsigned int i, const unsigned int role) const
+{
+  return pat::Particle(reco::LeafCandidate(0, p4(i, role), math::XYZPoint()));
+}
+
+/// return the fitted objects of a role of all combinations, as the separate collections
+std::vector<pat::Particle>
+TopKinFitResults::particles(const unsigned int role) const
+{
+  std::vector<pat::Particle> result;
+  result.reserve(size());
+  for(unsigned int i=0; i<size(); ++i)
+    result.push_back(particle(i, role));
+  return result;
+}
+
+/// return the jet indices of combination i
+std::vector<int>
+TopKinFitResults::jetCombi(const unsigned int i) const
+{
+  return std::vector<int>(jets_.begin()+i*nJets_, jets_.begin()+(i+1)*nJets_);
+}
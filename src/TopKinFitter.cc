@@ -1,9 +1,16 @@
+#include <cmath>
+#include <chrono>
+
+#include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
+#include "DataFormats/PatCandidates/interface/CandKinResolution.h"
+
 #include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitter.h"
 
 /// default configuration is: max iterations = 200, max deltaS = 5e-5, maxF = 1e-4
 TopKinFitter::TopKinFitter(const int maxNrIter, const double maxDeltaS, const double maxF,
 			   const double mW, const double mTop): 
-  maxNrIter_(maxNrIter), maxDeltaS_(maxDeltaS), maxF_(maxF), mW_(mW), mTop_(mTop)
+  maxNrIter_(maxNrIter), nrIterLimit_(maxNrIter), validate_(false), rescued_(false), rescuedS_(-1.), keepUnconverged_(false),
+  maxDeltaS_(maxDeltaS), maxF_(maxF), mW_(mW), mTop_(mTop), fillStats_(true)
 {
   fitter_ = new TKinFitter("TopKinFitter", "TopKinFitter");
   fitter_->setMaxNbIter(maxNrIter_);
@@ -27,6 +34,87 @@ TopKinFitter::param(const Param& param) const
   case kEMom       : parName="EMom";       break;
   case kEtEtaPhi   : parName="EtEtaPhi";   break;
   case kEtThetaPhi : parName="EtThetaPhi"; break;    
+  case kEtPhiPz    : parName="EtPhiPz";    break;
   }
   return parName;
 }
+
+/// perform the fit, fill the fit statistics and return the fit status
+int
+TopKinFitter::runFit()
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  fitter_->fit();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if(fillStats_)
+    stats_.fill(fitter_->getStatus(), fitter_->getNbIter(), elapsed.count());
+  rescued_ = false;
+  rescuedS_ = -1.;
+  if(validate_ && fitter_->getStatus()==1 && nrIterLimit_<maxNrIter_){
+    // repeat the fit with the configured iteration limit for the validation only and
+    // restore the result of the lowered limit (each fit starts from the measured
+    // parameters), such that the output does not depend on the validated events
+    fitter_->setMaxNbIter(maxNrIter_);
+    fitter_->fit();
+    rescued_ = (fitter_->getStatus()==0);
+    rescuedS_ = fitter_->getS();
+    fitter_->setMaxNbIter(nrIterLimit_);
+    fitter_->fit();
+  }
+  return fitter_->getStatus();
+}
+
+/// embed the fitted covariance matrix of a fit particle as kinematic resolution into the
+/// corresponding fitted pat::Particle (jets and leptons/MET differ for kEMom)
+void
+TopKinFitter::embedCovMatrixFit(pat::Particle& particle, TAbsFitParticle* fitParticle, const Param& param, const bool isJet) const
+{
+  pat::CandKinResolution::Parametrization parametrization;
+  switch(param){
+  case kEMom       : parametrization = (isJet ? pat::CandKinResolution::EMomDev : pat::CandKinResolution::EScaledMomDev); break;
+  case kEtEtaPhi   : parametrization = pat::CandKinResolution::EtEtaPhi;   break;
+  case kEtThetaPhi : parametrization = pat::CandKinResolution::EtThetaPhi; break;
+  default: 
+    // no corresponding parametrization of the kinematic resolution (e.g. kEtPhiPz)
+    return;
+  }
+  const TMatrixD* cov = fitParticle->getCovMatrixFit();
+  if(!cov || cov->GetNrows()!=fitParticle->getNPar()) return;
+  // upper triangle of the covariance matrix, row by row
+  std::vector<pat::CandKinResolution::Scalar> covariances;
+  for(int i=0; i<cov->GetNrows(); ++i)
+    for(int j=i; j<cov->GetNcols(); ++j)
+      covariances.push_back((*cov)(i,j));
+  particle.setKinResolution(pat::CandKinResolution(parametrization, covariances));
+}
+
+/// take over the kinematic resolution (e.g. an embedded fitted covariance matrix) of another particle, if it has one
+void
+TopKinFitter::copyKinResolution(pat::Particle& particle, const pat::Particle& from)
+{
+  if(from.hasKinResolution())
+    particle.setKinResolution(from.getKinResolution());
+}
+
+/// change the maximal number of iterations used for the following fits (at most the configured one)
+void
+TopKinFitter::setMaxNrIter(const int maxNrIter)
+{
+  nrIterLimit_ = (maxNrIter<maxNrIter_ ? maxNrIter : maxNrIter_);
+  fitter_->setMaxNbIter(nrIterLimit_);
+}
+
+/// mass of a sum of 4-vectors and its uncertainty from the relative energy resolutions of the summands
+void
+TopKinFitter::massResolution(const std::vector<TLorentzVector>& p4s, const std::vector<double>& resolutions, double& mass, double& sigma)
+{
+  // scaling a summand by (1+d) changes the squared mass by 2*d*(p_i*P)
+  TLorentzVector sum;
+  for(unsigned int i=0; i<p4s.size(); ++i)
+    sum += p4s[i];
+  double variance = 0.;
+  for(unsigned int i=0; i<p4s.size(); ++i)
+    variance += std::pow(2.*resolutions[i]*(p4s[i]*sum), 2);
+  mass  = (sum.M2()>0. ? sum.M() : 0.);
+  sigma = (mass>0. ? std::sqrt(variance)/(2.*mass) : 0.);
+}
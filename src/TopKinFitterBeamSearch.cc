@@ -0,0 +1,75 @@
+#include <iomanip>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterBeamSearch.h"
+
+/// default constructor (no beam search)
+TopKinFitterBeamSearch::TopKinFitterBeamSearch():
+  beamWidth_(0), validationPrescale_(0), nEvents_(0), validate_(false),
+  nSearched_(0), nTruncated_(0), nValidated_(0), nConverged_(0), nLost_(0)
+{
+}
+
+/// constructor with the width of the beam (0 for the full enumeration) and the validation prescale
+TopKinFitterBeamSearch::TopKinFitterBeamSearch(const unsigned int beamWidth, const unsigned int validationPrescale):
+  beamWidth_(beamWidth), validationPrescale_(validationPrescale), nEvents_(0), validate_(false),
+  nSearched_(0), nTruncated_(0), nValidated_(0), nConverged_(0), nLost_(0)
+{
+}
+
+/// to be called at the beginning of each event
+void
+TopKinFitterBeamSearch::beginEvent()
+{
+  ++nEvents_;
+  validate_ = (enabled() && validationPrescale_>0 && nEvents_%validationPrescale_==0);
+}
+
+/// add an event searched with the beam: whether partial assignments were dropped
+void
+TopKinFitterBeamSearch::fill(const bool truncated)
+{
+  ++nSearched_;
+  if(truncated) ++nTruncated_;
+}
+
+/// add the outcome of a validation event
+void
+TopKinFitterBeamSearch::fillValidation(const bool converged, const bool bestLost)
+{
+  ++nValidated_;
+  if(converged) ++nConverged_;
+  if(bestLost) ++nLost_;
+}
+
+/// add the counters of the report of another stream; the configuration is taken from it
+void
+TopKinFitterBeamSearch::merge(const TopKinFitterBeamSearch& other)
+{
+  beamWidth_          = other.beamWidth_;
+  validationPrescale_ = other.validationPrescale_;
+  nEvents_    += other.nEvents_;
+  nSearched_  += other.nSearched_;
+  nTruncated_ += other.nTruncated_;
+  nValidated_ += other.nValidated_;
+  nConverged_ += other.nConverged_;
+  nLost_      += other.nLost_;
+}
+
+/// report the searched events and the validation
+void
+TopKinFitterBeamSearch::print(std::ostream& out, const std::string& label) const
+{
+  if(!enabled()) return;
+  out << "\n"
+      << "+++++++++++ Beam search (approximate): " << label << " ++++++++++++ \n"
+      << "  Beam width        : " << beamWidth_ << "\n"
+      << "  Searched events   : " << nSearched_ << " of " << nEvents_ << "\n"
+      << "   * with dropped assignments      : " << nTruncated_ << " ("
+      << std::setprecision(4) << (nSearched_>0 ? (double)nTruncated_/nSearched_ : 0.) << ") \n"
+      << "  Validation events : " << nValidated_ << " (every " << validationPrescale_ << ". event) \n";
+  if(nValidated_>0)
+    out << "   * with converged fit            : " << nConverged_ << "\n"
+	<< "   * best combination not in beam  : " << nLost_ << " ("
+	<< std::setprecision(4) << (nConverged_>0 ? (double)nLost_/nConverged_ : 0.) << ") \n";
+  out << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
@@ -0,0 +1,110 @@
+#include <iomanip>
+#include <algorithm>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterCost.h"
+
+/// default constructor (no report)
+TopKinFitterCost::TopKinFitterCost():
+  enabled_(false)
+{
+}
+
+/// constructor with the switch for the report
+TopKinFitterCost::TopKinFitterCost(const bool enabled):
+  enabled_(enabled)
+{
+}
+
+/// predicted number of fits of TtSemiLepKinFitProducer for nJets jets of which nBTags are b-tagged
+unsigned long
+TopKinFitterCost::semiLepFits(const unsigned int nJets, const unsigned int nBTags, const int maxNJets, const bool useBTagging,
+			      const bool useOnlyMatch, const unsigned int nMatches)
+{
+  if(nJets<TtSemiLepTopology::nPartons) return 0;
+  if(useOnlyMatch) return nMatches;
+  // the first maxNJets jets are considered; with b-tagging both b partons need b-tagged jets
+  const unsigned int n = (maxNJets>=(int)TtSemiLepTopology::nPartons ? std::min(nJets, (unsigned int)maxNJets) : nJets);
+  return nCombinations<TtSemiLepTopology>(n, std::min(nBTags, n), useBTagging ? TtSemiLepTopology::nBPartons : 0);
+}
+
+/// predicted number of fits of TtFullHadKinFitProducer for nJets jets of which nBTags are b-tagged
+unsigned long
+TopKinFitterCost::fullHadFits(const unsigned int nJets, const unsigned int nBTags, const int maxNJets, const bool useBTagging,
+			      const unsigned int bTags, const bool useOnlyMatch, const unsigned int nMatches)
+{
+  if(nJets<TtFullHadTopology::nPartons) return 0;
+  if(useOnlyMatch) return nMatches;
+  const unsigned int n = (maxNJets>=(int)TtFullHadTopology::nPartons ? std::min(nJets, (unsigned int)maxNJets) : nJets);
+  const unsigned int nTagged = std::min(nBTags, n);
+  if(!useBTagging) return nCombinations<TtFullHadTopology>(n, nTagged, 0);
+  // as in TtFullHadKinFitter::KinFit: with bTags=2 both b partons need b-tagged jets, otherwise
+  // as many as there are b-tagged jets (at most two), at least bTags of them
+  if(bTags==2) return nCombinations<TtFullHadTopology>(n, nTagged, 2);
+  if(nTagged<bTags) return 0;
+  return nCombinations<TtFullHadTopology>(n, nTagged, std::min(nTagged, 2u));
+}
+
+/// add an event: predicted number of fits, actual number of fits and their wall time in seconds
+void
+TopKinFitterCost::fill(const unsigned long predicted, const unsigned long actual, const double seconds)
+{
+  std::map<unsigned long, Bin>::iterator bin = bins_.find(predicted);
+  if(bin == bins_.end()){
+    const Bin empty = { 0, 0, 0, 0. };
+    bin = bins_.insert(std::make_pair(predicted, empty)).first;
+  }
+  ++bin->second.nEvents;
+  bin->second.nFits += actual;
+  bin->second.maxFits = std::max(bin->second.maxFits, actual);
+  bin->second.time += seconds;
+}
+
+/// add the counters of the report of another stream; the configuration is taken from it
+void
+TopKinFitterCost::merge(const TopKinFitterCost& other)
+{
+  enabled_ = other.enabled_;
+  for(std::map<unsigned long, Bin>::const_iterator bin = other.bins_.begin(); bin != other.bins_.end(); ++bin){
+    std::map<unsigned long, Bin>::iterator merged = bins_.find(bin->first);
+    if(merged == bins_.end()){
+      bins_.insert(*bin);
+      continue;
+    }
+    merged->second.nEvents += bin->second.nEvents;
+    merged->second.nFits   += bin->second.nFits;
+    merged->second.maxFits  = std::max(merged->second.maxFits, bin->second.maxFits);
+    merged->second.time    += bin->second.time;
+  }
+}
+
+/// report the actual number of fits and the fit time per predicted number of fits
+void
+TopKinFitterCost::print(std::ostream& out, const std::string& label) const
+{
+  if(!enabled_) return;
+  unsigned long nEvents = 0, nPredicted = 0, nFits = 0;
+  double time = 0.;
+  for(std::map<unsigned long, Bin>::const_iterator bin = bins_.begin(); bin != bins_.end(); ++bin){
+    nEvents    += bin->second.nEvents;
+    nPredicted += bin->first*bin->second.nEvents;
+    nFits      += bin->second.nFits;
+    time       += bin->second.time;
+  }
+  out << "\n"
+      << "+++++++++++ Fit cost: " << label << " ++++++++++++ \n"
+      << "  Events            : " << nEvents << "\n"
+      << "  Predicted fits    : " << nPredicted << " (" << std::setprecision(4) << (nEvents ? (double)nPredicted/nEvents : 0.) << " per event) \n"
+      << "  Actual fits       : " << nFits << " (" << std::setprecision(4) << (nEvents ? (double)nFits/nEvents : 0.) << " per event) \n"
+      << "  Wall time per fit : " << std::setprecision(4) << (nFits ? 1e3*time/nFits : 0.) << " ms \n"
+      << "  Predicted :    events   actual fits (mean / max)   time/event [ms]   time/fit [ms] \n";
+  for(std::map<unsigned long, Bin>::const_iterator bin = bins_.begin(); bin != bins_.end(); ++bin){
+    const Bin& b = bin->second;
+    out << "   " << std::setw(9) << bin->first
+	<< std::setw(12) << b.nEvents
+	<< std::setw(14) << std::setprecision(4) << (b.nEvents ? (double)b.nFits/b.nEvents : 0.)
+	<< " / " << std::setw(6) << b.maxFits
+	<< std::setw(18) << std::setprecision(4) << (b.nEvents ? 1e3*b.time/b.nEvents : 0.)
+	<< std::setw(16) << std::setprecision(4) << (b.nFits ? 1e3*b.time/b.nFits : 0.) << "\n";
+  }
+  out << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
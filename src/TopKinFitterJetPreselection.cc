@@ -0,0 +1,114 @@
+#include <iomanip>
+#include <algorithm>
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJetPreselection.h"
+
+/// default constructor (first maxNJets jets)
+TopKinFitterJetPreselection::TopKinFitterJetPreselection():
+  enabled_(false), bTagWeight_(0.),
+  nTruncated_(0), nChanged_(0), nKept_(0)
+{
+}
+
+/// constructor with the switch for the preselection and the weight of the rank in the b-tag discriminator
+TopKinFitterJetPreselection::TopKinFitterJetPreselection(const bool enabled, const double bTagWeight):
+  enabled_(enabled), bTagWeight_(bTagWeight),
+  nTruncated_(0), nChanged_(0), nKept_(0)
+{
+  if(bTagWeight_<0.)
+    throw cms::Exception("Configuration") << "Weight of the b-tag rank in the jet preselection has to be positive: " << bTagWeight_ << "\n";
+}
+
+/// fill the indices of the jets to be considered
+void
+TopKinFitterJetPreselection::select(const std::vector<pat::Jet>& jets, const int maxNJets, const unsigned int minNJets,
+				    const unsigned int nBTags, const std::string& bTagAlgo, const double minBTagValueBJet,
+				    std::vector<int>& indices)
+{
+  indices.clear();
+  const bool truncate = (maxNJets>=(int)minNJets && (int)jets.size()>maxNJets);
+  if(!truncate || !enabled_){
+    for(unsigned int idx=0; idx<jets.size(); ++idx){
+      if(truncate && (int)idx==maxNJets) break;
+      indices.push_back(idx);
+    }
+    return;
+  }
+  ++nTruncated_;
+
+  // ranks in pt and in the b-tag discriminator (0 for the leading jet)
+  std::vector<std::pair<double, unsigned int> > pt, bDisc;
+  for(unsigned int idx=0; idx<jets.size(); ++idx){
+    pt   .push_back(std::make_pair(-jets[idx].pt(), idx));
+    bDisc.push_back(std::make_pair(-jets[idx].bDiscriminator(bTagAlgo), idx));
+  }
+  std::stable_sort(pt.begin(), pt.end());
+  std::stable_sort(bDisc.begin(), bDisc.end());
+  std::vector<unsigned int> ptRank(jets.size()), bDiscRank(jets.size());
+  for(unsigned int rank=0; rank<jets.size(); ++rank){
+    ptRank   [pt   [rank].second] = rank;
+    bDiscRank[bDisc[rank].second] = rank;
+  }
+  // combined ranking, equal scores are ordered in pt
+  std::vector<std::pair<std::pair<double, unsigned int>, unsigned int> > ranking;
+  for(unsigned int idx=0; idx<jets.size(); ++idx)
+    ranking.push_back(std::make_pair(std::make_pair(ptRank[idx]+bTagWeight_*bDiscRank[idx], ptRank[idx]), idx));
+  std::sort(ranking.begin(), ranking.end());
+
+  // the best ranked b-tagged jets are kept first, as many as required and available
+  std::vector<bool> selected(jets.size(), false);
+  unsigned int nSelected = 0, nTagged = 0;
+  for(unsigned int rank=0; rank<ranking.size() && nTagged<nBTags; ++rank){
+    const unsigned int idx = ranking[rank].second;
+    if(jets[idx].bDiscriminator(bTagAlgo)<minBTagValueBJet) continue;
+    selected[idx] = true;
+    ++nSelected;
+    ++nTagged;
+  }
+  // the window is filled up in the order of the ranking; a b-tagged jet was kept
+  // if it would not have been among the maxNJets best ranked jets
+  bool kept = false;
+  for(unsigned int rank=0; rank<ranking.size(); ++rank){
+    const unsigned int idx = ranking[rank].second;
+    if(selected[idx]){
+      if(rank>=(unsigned int)maxNJets) kept = true;
+      continue;
+    }
+    if(nSelected==(unsigned int)maxNJets) continue;
+    selected[idx] = true;
+    ++nSelected;
+  }
+  for(unsigned int idx=0; idx<jets.size(); ++idx)
+    if(selected[idx]) indices.push_back(idx);
+
+  if(kept) ++nKept_;
+  if(indices.back()>=maxNJets) ++nChanged_;
+}
+
+/// add the counters of the report of another stream; the configuration is taken from it
+void
+TopKinFitterJetPreselection::merge(const TopKinFitterJetPreselection& other)
+{
+  enabled_    = other.enabled_;
+  bTagWeight_ = other.bTagWeight_;
+  nTruncated_ += other.nTruncated_;
+  nChanged_   += other.nChanged_;
+  nKept_      += other.nKept_;
+}
+
+/// report the events with a changed window
+void
+TopKinFitterJetPreselection::print(std::ostream& out, const std::string& label) const
+{
+  if(!enabled_) return;
+  out << "\n"
+      << "+++++++++++ Jet preselection: " << label << " ++++++++++++ \n"
+      << "  Weight of b-tag rank : " << bTagWeight_ << "\n"
+      << "  Events > maxNJets    : " << nTruncated_ << "\n"
+      << "   * window changed w.r.t. leading jets : " << nChanged_ << " ("
+      << std::setprecision(4) << (nTruncated_>0 ? (double)nChanged_/nTruncated_ : 0.) << ") \n"
+      << "   * b-tagged jets kept beyond ranking  : " << nKept_ << " ("
+      << std::setprecision(4) << (nTruncated_>0 ? (double)nKept_/nTruncated_ : 0.) << ") \n"
+      << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
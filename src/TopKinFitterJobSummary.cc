@@ -0,0 +1,64 @@
+#include <fstream>
+#include <sstream>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterJobSummary.h"
+
+/// constructor with the file to write the merged fit statistics to in JSON format (empty for none)
+TopKinFitterJobSummary::TopKinFitterJobSummary(const std::string& fitStatsJSON):
+  fitStatsJSON_(fitStatsJSON), nStreams_(0)
+{
+}
+
+/// name of the file of a stream derived from a common file name (the name itself for the first stream)
+std::string
+TopKinFitterJobSummary::streamFileName(const std::string& fileName, const unsigned int stream)
+{
+  if(stream==0) return fileName;
+  std::ostringstream name;
+  name << fileName << "." << stream;
+  return name.str();
+}
+
+/// add the fit statistics, the reports to be merged and the remaining reports of a stream (as given by newStream) at its end
+void
+TopKinFitterJobSummary::add(const unsigned int stream, const TopKinFitterStats& stats, const TopKinFitterPruning& pruning,
+			    const TopKinFitterBeamSearch& beamSearch, const TopKinFitterCost& cost,
+			    const TopKinFitterJetPreselection& preselection, const std::string& reports) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.merge(stats);
+  pruning_.merge(pruning);
+  beamSearch_.merge(beamSearch);
+  cost_.merge(cost);
+  preselection_.merge(preselection);
+  if(!reports.empty()) reports_[stream] = reports;
+}
+
+/// print the merged fit statistics and reports, followed by the remaining reports of all streams
+void
+TopKinFitterJobSummary::print(std::ostream& out, const std::string& label) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.print(out, label);
+  pruning_.print(out, label);
+  beamSearch_.print(out, label);
+  cost_.print(out, label);
+  preselection_.print(out, label);
+  // labelled by the stream index, which is also the suffix of the files of the stream
+  for(std::map<unsigned int, std::string>::const_iterator report = reports_.begin(); report != reports_.end(); ++report){
+    if(nStreams_>1) out << "\n" << "  --- " << label << ": stream " << report->first << " ---\n";
+    out << report->second;
+  }
+}
+
+/// write the merged fit statistics in JSON format, return false if the file cannot be opened
+bool
+TopKinFitterJobSummary::printJSON(const std::string& label) const
+{
+  if(fitStatsJSON_.empty()) return true;
+  std::ofstream json(fitStatsJSON_.c_str());
+  if(!json) return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.printJSON(json, label);
+  return true;
+}
@@ -0,0 +1,53 @@
+#include "TROOT.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterOffloadQueue.h"
+
+/// constructor with the number of threads (0 for none)
+TopKinFitterOffloadQueue::TopKinFitterOffloadQueue(const unsigned int nThreads):
+  stop_(false)
+{
+  // the fits create ROOT objects (matrices, 4-vectors) on all threads
+  if(nThreads>0) ROOT::EnableThreadSafety();
+  for(unsigned int i=0; i<nThreads; ++i)
+    threads_.push_back(std::thread(&TopKinFitterOffloadQueue::loop, this));
+}
+
+/// default destructor; runs the remaining tasks, stops and joins the threads
+TopKinFitterOffloadQueue::~TopKinFitterOffloadQueue()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for(unsigned int i=0; i<threads_.size(); ++i)
+    threads_[i].join();
+}
+
+/// add a task to be run by the next free thread
+void
+TopKinFitterOffloadQueue::push(const Task& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(task);
+  }
+  wake_.notify_one();
+}
+
+/// main loop of the threads
+void
+TopKinFitterOffloadQueue::loop()
+{
+  while(true){
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while(tasks_.empty() && !stop_) wake_.wait(lock);
+      if(tasks_.empty()) return;
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
@@ -0,0 +1,84 @@
+#include <iomanip>
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterPruning.h"
+
+/// default constructor (no cut)
+TopKinFitterPruning::TopKinFitterPruning():
+  maxWPull_(0.), validationPrescale_(0), nEvents_(0), validate_(false),
+  nCombis_(0), nCut_(0), nBounded_(0), nValidated_(0), nConverged_(0), nLost_(0)
+{
+}
+
+/// constructor with the maximal pull of the W candidates (0 for no cut) and the validation prescale
+TopKinFitterPruning::TopKinFitterPruning(const double maxWPull, const unsigned int validationPrescale):
+  maxWPull_(maxWPull), validationPrescale_(validationPrescale), nEvents_(0), validate_(false),
+  nCombis_(0), nCut_(0), nBounded_(0), nValidated_(0), nConverged_(0), nLost_(0)
+{
+  if(maxWPull_<0.)
+    throw cms::Exception("Configuration") << "Maximal pull of the W candidates has to be positive (0 for no cut): " << maxWPull_ << "\n";
+}
+
+/// to be called at the beginning of each event
+void
+TopKinFitterPruning::beginEvent()
+{
+  ++nEvents_;
+  validate_ = (enabled() && validationPrescale_>0 && nEvents_%validationPrescale_==0);
+}
+
+/// add the number of combinations of an event, of those failing the cut and of those skipped by their chi2 bound
+void
+TopKinFitterPruning::fill(const unsigned int nCombis, const unsigned int nCut, const unsigned int nBounded)
+{
+  nCombis_  += nCombis;
+  nCut_     += nCut;
+  nBounded_ += nBounded;
+}
+
+/// add the outcome of a validation event
+void
+TopKinFitterPruning::fillValidation(const bool converged, const bool bestCut)
+{
+  ++nValidated_;
+  if(converged) ++nConverged_;
+  if(bestCut) ++nLost_;
+}
+
+/// add the counters of the report of another stream; the configuration is taken from it
+void
+TopKinFitterPruning::merge(const TopKinFitterPruning& other)
+{
+  maxWPull_           = other.maxWPull_;
+  validationPrescale_ = other.validationPrescale_;
+  nEvents_    += other.nEvents_;
+  nCombis_    += other.nCombis_;
+  nCut_       += other.nCut_;
+  nBounded_   += other.nBounded_;
+  nValidated_ += other.nValidated_;
+  nConverged_ += other.nConverged_;
+  nLost_      += other.nLost_;
+}
+
+/// report the pruned combinations and the validation
+void
+TopKinFitterPruning::print(std::ostream& out, const std::string& label) const
+{
+  if(nCut_==0 && nBounded_==0 && !enabled()) return;
+  out << "\n"
+      << "+++++++++++ Pruned jet combinations: " << label << " ++++++++++++ \n"
+      << "  Jet combinations  : " << nCombis_ << " in " << nEvents_ << " events \n"
+      << "   * failing the W pull cut        : " << nCut_ << " ("
+      << std::setprecision(4) << (nCombis_>0 ? (double)nCut_/nCombis_ : 0.) << ") \n"
+      << "   * excluded by their chi2 bound  : " << nBounded_ << " ("
+      << std::setprecision(4) << (nCombis_>0 ? (double)nBounded_/nCombis_ : 0.) << ") \n";
+  if(enabled()){
+    out << "  Max(W pull)       : " << maxWPull_ << "\n"
+	<< "  Validation events : " << nValidated_ << " (every " << validationPrescale_ << ". event) \n";
+    if(nValidated_>0)
+      out << "   * with converged fit            : " << nConverged_ << "\n"
+	  << "   * best combination failed cut   : " << nLost_ << " ("
+	  << std::setprecision(4) << (nConverged_>0 ? (double)nLost_/nConverged_ : 0.) << ") \n";
+  }
+  out << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
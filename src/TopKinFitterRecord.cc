@@ -0,0 +1,155 @@
+#include <iomanip>
+#include <string>
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterRecord.h"
+
+/// write a 4-vector
+static void writeP4(std::ostream& out, const TLorentzVector& p4)
+{
+  out << " " << p4.Px() << " " << p4.Py() << " " << p4.Pz() << " " << p4.E();
+}
+
+/// read a 4-vector
+static TLorentzVector readP4(std::istream& in)
+{
+  double px, py, pz, e;
+  in >> px >> py >> pz >> e;
+  return TLorentzVector(px, py, pz, e);
+}
+
+/// write a list of values preceded by its size
+template <typename T>
+static void writeList(std::ostream& out, const std::vector<T>& values)
+{
+  out << " " << values.size();
+  for(unsigned int idx=0; idx<values.size(); ++idx)
+    out << " " << values[idx];
+}
+
+/// read a list of values preceded by its size
+template <typename T>
+static std::vector<T> readList(std::istream& in)
+{
+  unsigned int size = 0;
+  in >> size;
+  std::vector<T> values(in ? size : 0);
+  for(unsigned int idx=0; idx<values.size(); ++idx)
+    in >> values[idx];
+  return values;
+}
+
+/// read a keyword and check it against the expected one
+static void expect(std::istream& in, const std::string& keyword)
+{
+  std::string word;
+  in >> word;
+  if(!in || word!=keyword)
+    throw cms::Exception("TopKinFitterRecord") << "Corrupted record: expected '" << keyword << "' but found '" << word << "'\n";
+}
+
+/// default constructor
+TopKinFitterRecord::TopKinFitterRecord():
+  channel(kSemiLep), jetParam(1), lepParam(1), metParam(1), fixLepton(false), mW(80.4), mTop(173.),
+  leptonCharge(0), leptonType(CovarianceMatrix::kMuon)
+{
+}
+
+/// constructor for a given channel
+TopKinFitterRecord::TopKinFitterRecord(const Channel channel):
+  channel(channel), jetParam(1), lepParam(1), metParam(1), fixLepton(false), mW(80.4), mTop(173.),
+  leptonCharge(0), leptonType(CovarianceMatrix::kMuon)
+{
+}
+
+/// write record to a stream
+void
+TopKinFitterRecord::write(std::ostream& out) const
+{
+  const std::streamsize precision = out.precision(12);
+  out << "record " << channel << " " << jets.size() << " " << combis.size() << "\n";
+  out << "config " << jetParam << " " << lepParam << " " << metParam << " " << fixLepton << " " << mW << " " << mTop;
+  writeList(out, constraints);
+  writeList(out, jetEnergyResolutionScaleFactors);
+  writeList(out, jetEnergyResolutionEtaBinning);
+  out << "\n";
+  for(unsigned int idx=0; idx<jets.size(); ++idx){
+    out << "jet";
+    writeP4(out, jets[idx]);
+    writeP4(out, bJets[idx]);
+    out << "\n";
+  }
+  out << "lepton " << leptonType << " " << leptonCharge;
+  writeP4(out, lepton);
+  out << "\n";
+  out << "neutrino";
+  writeP4(out, neutrino);
+  out << "\n";
+  for(unsigned int idx=0; idx<combis.size(); ++idx){
+    out << "combi " << combis[idx].size();
+    for(unsigned int jdx=0; jdx<combis[idx].size(); ++jdx)
+      out << " " << combis[idx][jdx];
+    out << "\n";
+  }
+  out.precision(precision);
+}
+
+/// read the next record from a stream; returns false if no further record is found
+bool
+TopKinFitterRecord::read(std::istream& in)
+{
+  std::string word;
+  if(!(in >> word)) return false;
+  if(word!="record")
+    throw cms::Exception("TopKinFitterRecord") << "Corrupted record: expected 'record' but found '" << word << "'\n";
+
+  int ch;
+  unsigned int nJets, nCombis;
+  in >> ch >> nJets >> nCombis;
+  channel = (Channel)ch;
+
+  expect(in, "config");
+  in >> jetParam >> lepParam >> metParam >> fixLepton >> mW >> mTop;
+  constraints = readList<int>(in);
+  jetEnergyResolutionScaleFactors = readList<double>(in);
+  jetEnergyResolutionEtaBinning   = readList<double>(in);
+
+  jets .clear();
+  bJets.clear();
+  for(unsigned int idx=0; idx<nJets; ++idx){
+    expect(in, "jet");
+    jets .push_back(readP4(in));
+    bJets.push_back(readP4(in));
+  }
+  int type;
+  expect(in, "lepton");
+  in >> type >> leptonCharge;
+  leptonType = (CovarianceMatrix::ObjectType)type;
+  lepton = readP4(in);
+  expect(in, "neutrino");
+  neutrino = readP4(in);
+
+  combis.clear();
+  for(unsigned int idx=0; idx<nCombis; ++idx){
+    expect(in, "combi");
+    unsigned int size;
+    in >> size;
+    std::vector<int> combi(size);
+    for(unsigned int jdx=0; jdx<size; ++jdx)
+      in >> combi[jdx];
+    combis.push_back(combi);
+  }
+  if(!in)
+    throw cms::Exception("TopKinFitterRecord") << "Corrupted record: unexpected end of input\n";
+  return true;
+}
+
+/// return whether the fitter configuration agrees with the one of another record
+bool
+TopKinFitterRecord::sameConfiguration(const TopKinFitterRecord& other) const
+{
+  return (channel==other.channel && jetParam==other.jetParam && lepParam==other.lepParam && metParam==other.metParam &&
+	  fixLepton==other.fixLepton && constraints==other.constraints && mW==other.mW && mTop==other.mTop &&
+	  jetEnergyResolutionScaleFactors==other.jetEnergyResolutionScaleFactors &&
+	  jetEnergyResolutionEtaBinning==other.jetEnergyResolutionEtaBinning);
+}
@@ -0,0 +1,183 @@
+#include <iomanip>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterStats.h"
+
+/// default constructor
+TopKinFitterStats::TopKinFitterStats()
+{
+  reset();
+}
+
+/// add the result of a single fit
+void
+TopKinFitterStats::fill(const int status, const int nrIter, const double seconds)
+{
+  const StatusType type = statusType(status);
+  const unsigned int bin = (nrIter>0 ? nrIter : 0);
+  if(nrIter_[type].size()<=bin)
+    nrIter_[type].resize(bin+1, 0);
+  ++nrIter_[type][bin];
+  ++nFits_[type];
+  time_[type] += seconds;
+  if(seconds>maxTime_) maxTime_ = seconds;
+  ++fitsInEvent_;
+}
+
+/// close the current event and fill the number of fits per event
+void
+TopKinFitterStats::endEvent()
+{
+  ++fitsPerEvent_[fitsInEvent_];
+  fitsInEvent_ = 0;
+  ++nEvents_;
+}
+
+/// add the counters of another instance to this one, including the fits of its current event
+void
+TopKinFitterStats::merge(const TopKinFitterStats& other)
+{
+  for(unsigned int type=0; type<kNStatusTypes; ++type){
+    if(nrIter_[type].size()<other.nrIter_[type].size())
+      nrIter_[type].resize(other.nrIter_[type].size(), 0);
+    for(unsigned int bin=0; bin<other.nrIter_[type].size(); ++bin)
+      nrIter_[type][bin] += other.nrIter_[type][bin];
+    nFits_[type] += other.nFits_[type];
+    time_ [type] += other.time_ [type];
+  }
+  if(other.maxTime_>maxTime_) maxTime_ = other.maxTime_;
+  for(std::map<unsigned long, unsigned long>::const_iterator it = other.fitsPerEvent_.begin(); it != other.fitsPerEvent_.end(); ++it)
+    fitsPerEvent_[it->first] += it->second;
+  nEvents_ += other.nEvents_;
+  fitsInEvent_ += other.fitsInEvent_;
+}
+
+/// reset all counters
+void
+TopKinFitterStats::reset()
+{
+  for(unsigned int type=0; type<kNStatusTypes; ++type){
+    nFits_[type] = 0;
+    time_ [type] = 0.;
+    nrIter_[type].clear();
+  }
+  maxTime_ = 0.;
+  fitsPerEvent_.clear();
+  fitsInEvent_ = 0;
+  nEvents_ = 0;
+}
+
+/// return number of fits
+unsigned long
+TopKinFitterStats::nFits() const
+{
+  unsigned long sum = 0;
+  for(unsigned int type=0; type<kNStatusTypes; ++type)
+    sum += nFits_[type];
+  return sum;
+}
+
+/// return wall time spent in the fits in seconds
+double
+TopKinFitterStats::time() const
+{
+  double sum = 0.;
+  for(unsigned int type=0; type<kNStatusTypes; ++type)
+    sum += time_[type];
+  return sum;
+}
+
+/// return the q-quantile (0<=q<=1) of the number of iterations for fits of a given status type
+int
+TopKinFitterStats::nrIterQuantile(const double q, const StatusType type) const
+{
+  if(nFits_[type]==0) return -1;
+  // smallest number of iterations such that a fraction q of the fits needed at most as many
+  const double threshold = q*nFits_[type];
+  unsigned long sum = 0;
+  for(unsigned int bin=0; bin<nrIter_[type].size(); ++bin){
+    sum += nrIter_[type][bin];
+    if(sum>0 && sum>=threshold) return bin;
+  }
+  return nrIter_[type].size()-1;
+}
+
+/// convert TKinFitter status to StatusType
+TopKinFitterStats::StatusType
+TopKinFitterStats::statusType(const int status)
+{
+  switch(status){
+  case 0  : return kConverged;
+  case 1  : return kMaxIterations;
+  default : return kDiverged;
+  }
+}
+
+/// convert StatusType to human readable form
+std::string
+TopKinFitterStats::statusName(const StatusType type)
+{
+  std::string name;
+  switch(type){
+  case kConverged     : name="converged";     break;
+  case kMaxIterations : name="maxIterations"; break;
+  default             : name="diverged";      break;
+  }
+  return name;
+}
+
+/// print counters as human readable table
+void
+TopKinFitterStats::print(std::ostream& out, const std::string& label) const
+{
+  const unsigned long fits = nFits();
+  unsigned long maxFitsPerEvent = (fitsPerEvent_.empty() ? 0 : fitsPerEvent_.rbegin()->first);
+  out << "\n"
+      << "+++++++++++ Fit statistics: " << label << " ++++++++++++ \n"
+      << "  Events            : " << nEvents_ << "\n"
+      << "  Fits              : " << fits << "\n"
+      << "  Fits per event    : " << std::setprecision(4) << (nEvents_ ? (double)fits/nEvents_ : 0.)
+      << " (max " << maxFitsPerEvent << ")\n"
+      << "  Wall time per fit : " << std::setprecision(4) << (fits ? 1e3*time()/fits : 0.) << " ms"
+      << " (max " << 1e3*maxTime_ << " ms, total " << time() << " s)\n"
+      << "  Status            :      fits    fraction   iterations (median / 90% / 99% / max)   time/fit [ms] \n";
+  for(unsigned int type=0; type<kNStatusTypes; ++type){
+    const StatusType t = (StatusType)type;
+    out << "   * " << std::left << std::setw(15) << statusName(t) << std::right
+	<< std::setw(10) << nFits_[t]
+	<< std::setw(11) << std::setprecision(4) << (fits ? (double)nFits_[t]/fits : 0.)
+	<< "   " << std::setw(6) << nrIterQuantile(0.5 , t)
+	<< " / " << std::setw(4) << nrIterQuantile(0.9 , t)
+	<< " / " << std::setw(4) << nrIterQuantile(0.99, t)
+	<< " / " << std::setw(4) << nrIterQuantile(1.  , t)
+	<< std::setw(20) << std::setprecision(4) << (nFits_[t] ? 1e3*time_[t]/nFits_[t] : 0.) << "\n";
+  }
+  out << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
+
+/// print counters in JSON format
+void
+TopKinFitterStats::printJSON(std::ostream& out, const std::string& label) const
+{
+  out << "{\n"
+      << "  \"label\": \"" << label << "\",\n"
+      << "  \"events\": " << nEvents_ << ",\n"
+      << "  \"fits\": " << nFits() << ",\n"
+      << "  \"time\": " << time() << ",\n"
+      << "  \"maxTime\": " << maxTime_ << ",\n"
+      << "  \"fitsPerEvent\": {";
+  for(std::map<unsigned long, unsigned long>::const_iterator it = fitsPerEvent_.begin(); it != fitsPerEvent_.end(); ++it)
+    out << (it==fitsPerEvent_.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+  out << "},\n"
+      << "  \"status\": {\n";
+  for(unsigned int type=0; type<kNStatusTypes; ++type){
+    out << "    \"" << statusName((StatusType)type) << "\": {"
+	<< "\"fits\": " << nFits_[type] << ", "
+	<< "\"time\": " << time_[type] << ", "
+	<< "\"nrIter\": [";
+    for(unsigned int bin=0; bin<nrIter_[type].size(); ++bin)
+      out << (bin ? ", " : "") << nrIter_[type][bin];
+    out << "]}" << (type+1<kNStatusTypes ? "," : "") << "\n";
+  }
+  out << "  }\n"
+      << "}\n";
+}
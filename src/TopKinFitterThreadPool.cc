@@ -0,0 +1,92 @@
+#include "TROOT.h"
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterThreadPool.h"
+
+/// constructor with the total number of threads including the calling one (0 is treated as 1)
+TopKinFitterThreadPool::TopKinFitterThreadPool(const unsigned int nThreads):
+  work_(0), n_(0), next_(0), generation_(0), busy_(0), stop_(false)
+{
+  // the fits create ROOT objects (matrices, 4-vectors) on all threads
+  if(nThreads>1) ROOT::EnableThreadSafety();
+  for(unsigned int worker=1; worker<nThreads; ++worker)
+    threads_.push_back(std::thread(&TopKinFitterThreadPool::loop, this, worker));
+}
+
+/// default destructor; stops and joins the threads
+TopKinFitterThreadPool::~TopKinFitterThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for(unsigned int i=0; i<threads_.size(); ++i)
+    threads_[i].join();
+}
+
+/// call work(worker, index) for index=0..n-1 distributed over the threads (serial: in order by worker 0)
+void
+TopKinFitterThreadPool::run(const unsigned int n, const Work& work, const bool serial)
+{
+  if(serial || threads_.empty()){
+    for(unsigned int idx=0; idx<n; ++idx)
+      work(0, idx);
+    return;
+  }
+  if(n==0) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    work_  = &work;
+    n_     = n;
+    next_  = 0;
+    busy_  = threads_.size();
+    error_ = std::exception_ptr();
+    ++generation_;
+  }
+  wake_.notify_all();
+  process(0);
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(busy_>0) done_.wait(lock);
+    work_ = 0;
+    error = error_;
+  }
+  if(error) std::rethrow_exception(error);
+}
+
+/// main loop of the additional threads
+void
+TopKinFitterThreadPool::loop(const unsigned int worker)
+{
+  unsigned long generation = 0;
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while(!stop_ && generation_==generation) wake_.wait(lock);
+      if(stop_) return;
+      generation = generation_;
+    }
+    process(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(--busy_==0) done_.notify_one();
+    }
+  }
+}
+
+/// process indices until none is left
+void
+TopKinFitterThreadPool::process(const unsigned int worker)
+{
+  for(unsigned int idx=next_++; idx<n_; idx=next_++){
+    try{
+      (*work_)(worker, idx);
+    }
+    catch(...){
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(!error_) error_ = std::current_exception();
+      next_ = n_;
+    }
+  }
+}
@@ -0,0 +1,99 @@
+#include <iomanip>
+
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitterTuning.h"
+
+/// default constructor (adaptive mode switched off)
+TopKinFitterTuning::TopKinFitterTuning():
+  enabled_(false), warmUpFits_(0), quantile_(1.), maxNrIter_(0), validationPrescale_(0),
+  tuned_(false), tunedNrIter_(0), nConvergedWarmUp_(0), nTunedEvents_(0), validate_(false),
+  nValidated_(0), nCompared_(0), nChanged_(0), nLost_(0), nRescued_(0), sumDeltaChi2_(0.)
+{
+}
+
+/// constructor with configuration
+TopKinFitterTuning::TopKinFitterTuning(const bool enabled, const unsigned int warmUpFits, const double quantile,
+				       const int maxNrIter, const unsigned int validationPrescale):
+  enabled_(enabled), warmUpFits_(warmUpFits), quantile_(quantile), maxNrIter_(maxNrIter), validationPrescale_(validationPrescale),
+  tuned_(false), tunedNrIter_(maxNrIter), nConvergedWarmUp_(0), nTunedEvents_(0), validate_(false),
+  nValidated_(0), nCompared_(0), nChanged_(0), nLost_(0), nRescued_(0), sumDeltaChi2_(0.)
+{
+  if(enabled_ && (quantile_<=0. || quantile_>1.))
+    throw cms::Exception("Configuration") << "Quantile for the adaptive iteration limit has to be in (0,1]: " << quantile_ << "\n";
+}
+
+/// to be called at the beginning of each event; returns true if the iteration limit changed
+bool
+TopKinFitterTuning::beginEvent(const TopKinFitterStats& stats)
+{
+  if(!enabled_) return false;
+  if(tuned_){
+    ++nTunedEvents_;
+    validate_ = (validationPrescale_>0 && nTunedEvents_%validationPrescale_==0);
+    return false;
+  }
+  if(stats.nFits()<warmUpFits_ || stats.nFits(TopKinFitterStats::kConverged)==0)
+    return false;
+
+  // derive the limit from the iterations of the converged fits seen so far;
+  // never exceed the configured limit and always allow for at least one iteration
+  tuned_ = true;
+  nConvergedWarmUp_ = stats.nFits(TopKinFitterStats::kConverged);
+  tunedNrIter_ = stats.nrIterQuantile(quantile_, TopKinFitterStats::kConverged);
+  if(tunedNrIter_>maxNrIter_) tunedNrIter_ = maxNrIter_;
+  if(tunedNrIter_<1) tunedNrIter_ = 1;
+
+  edm::LogInfo("TopKinFitterTuning")
+    << "Warm-up period over after " << stats.nFits() << " fits (" << nConvergedWarmUp_ << " converged):"
+    << " lowering Max(No iterations) from " << maxNrIter_ << " to " << tunedNrIter_
+    << " (" << quantile_ << "-quantile of converged fits).";
+  return true;
+}
+
+/// add the outcome of a validation event
+void
+TopKinFitterTuning::fillValidation(const std::vector<int>& bestCombi, const double bestChi2,
+				   const std::vector<int>& bestTunedCombi, const double bestTunedChi2,
+				   const unsigned int nRescued)
+{
+  ++nValidated_;
+  nRescued_ += nRescued;
+  // no converged fit with the configured limit either: nothing to compare
+  if(bestCombi.empty()) return;
+  if(bestTunedCombi.empty()){
+    ++nLost_;
+    return;
+  }
+  ++nCompared_;
+  if(bestCombi!=bestTunedCombi) ++nChanged_;
+  sumDeltaChi2_ += bestTunedChi2-bestChi2;
+}
+
+/// report the chosen settings and the ranking quality
+void
+TopKinFitterTuning::print(std::ostream& out, const std::string& label) const
+{
+  if(!enabled_) return;
+  out << "\n"
+      << "+++++++++++ Adaptive iteration limit: " << label << " ++++++++++++ \n";
+  if(!tuned_){
+    out << "  Warm-up period (" << warmUpFits_ << " fits) not completed, \n"
+	<< "  Max(No iterations) kept at " << maxNrIter_ << "\n";
+  }
+  else{
+    out << "  Max(No iterations): " << tunedNrIter_ << " (configured " << maxNrIter_ << ", "
+	<< quantile_ << "-quantile of " << nConvergedWarmUp_ << " converged fits) \n"
+	<< "  Validation events : " << nValidated_ << " (every " << validationPrescale_ << ". event) \n";
+    if(nValidated_>0){
+      out << "   * rescued fits                   : " << nRescued_ << "\n"
+	  << "   * best combination changed       : " << nChanged_ << " ("
+	  << std::setprecision(4) << (double)nChanged_/nValidated_ << ") \n"
+	  << "   * no converged fit with new limit: " << nLost_ << " ("
+	  << std::setprecision(4) << (double)nLost_/nValidated_ << ") \n"
+	  << "   * mean chi2 shift of best fit    : "
+	  << (nCompared_>0 ? sumDeltaChi2_/nCompared_ : 0.) << "\n";
+    }
+  }
+  out << "+++++++++++++++++++++++++++++++++++++++++++++++++ \n";
+}
@@ -1,3 +1,9 @@
+#include <map>
+#include <set>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
 #include "PhysicsTools/KinFitter/interface/TFitConstraintM.h"
 #include "PhysicsTools/KinFitter/interface/TAbsFitParticle.h"
 #include "PhysicsTools/KinFitter/interface/TFitParticleEMomDev.h"
@@ -142,6 +148,8 @@ TtFullHadKinFitter::setupJets()
     lightP_   = new TFitParticleEtThetaPhi("Jet5", "Jet5", 0, &empty3x3);
     lightPBar_= new TFitParticleEtThetaPhi("Jet6", "Jet6", 0, &empty3x3);
     break;
+  case kEtPhiPz :
+    throw edm::Exception( edm::errors::Configuration, "The parametrisation EtPhiPz is only supported for the MET" );
   }
 }
 
@@ -226,6 +234,35 @@ TtFullHadKinFitter::fit(const std::vector<pat::Jet>& jets)
   TMatrixD m5 = covM_->setupMatrix(lightPBar, jetParam_);
   TMatrixD m6 = covM_->setupMatrix(bBar     , jetParam_, "bjets");
 
+  // now do the part that is fully independent of PAT features
+  return fit(p4LightQ, p4LightQBar, p4B, p4LightP, p4LightPBar, p4BBar,
+	     m1, m2, m3, m4, m5, m6);
+}
+
+/// kinematic fit interface for plain 4-vecs
+int
+TtFullHadKinFitter::fit(const TLorentzVector& p4LightQ, const TLorentzVector& p4LightQBar, const TLorentzVector& p4B,
+			const TLorentzVector& p4LightP, const TLorentzVector& p4LightPBar, const TLorentzVector& p4BBar)
+{
+  // initialize covariance matrices
+  TMatrixD m1 = covM_->setupMatrix(p4LightQ,    CovarianceMatrix::kUdscJet, jetParam_);
+  TMatrixD m2 = covM_->setupMatrix(p4LightQBar, CovarianceMatrix::kUdscJet, jetParam_);
+  TMatrixD m3 = covM_->setupMatrix(p4B,         CovarianceMatrix::kBJet,    jetParam_);
+  TMatrixD m4 = covM_->setupMatrix(p4LightP,    CovarianceMatrix::kUdscJet, jetParam_);
+  TMatrixD m5 = covM_->setupMatrix(p4LightPBar, CovarianceMatrix::kUdscJet, jetParam_);
+  TMatrixD m6 = covM_->setupMatrix(p4BBar,      CovarianceMatrix::kBJet,    jetParam_);
+
+  return fit(p4LightQ, p4LightQBar, p4B, p4LightP, p4LightPBar, p4BBar,
+	     m1, m2, m3, m4, m5, m6);
+}
+
+/// common core of the fit interface
+int
+TtFullHadKinFitter::fit(const TLorentzVector& p4LightQ, const TLorentzVector& p4LightQBar, const TLorentzVector& p4B,
+			const TLorentzVector& p4LightP, const TLorentzVector& p4LightPBar, const TLorentzVector& p4BBar,
+			const TMatrixD& covLightQ, const TMatrixD& covLightQBar, const TMatrixD& covB,
+			const TMatrixD& covLightP, const TMatrixD& covLightPBar, const TMatrixD& covBBar)
+{
   // set the kinematics of the objects to be fitted
   b_        ->setIni4Vec(&p4B        );
   bBar_     ->setIni4Vec(&p4BBar     );
@@ -235,18 +272,18 @@ TtFullHadKinFitter::fit(const std::vector<pat::Jet>& jets)
   lightPBar_->setIni4Vec(&p4LightPBar);
   
   // initialize covariance matrices
-  lightQ_   ->setCovMatrix( &m1);
-  lightQBar_->setCovMatrix( &m2);
-  b_        ->setCovMatrix( &m3);
-  lightP_   ->setCovMatrix( &m4);
-  lightPBar_->setCovMatrix( &m5);
-  bBar_     ->setCovMatrix( &m6);
+  lightQ_   ->setCovMatrix( &covLightQ   );
+  lightQBar_->setCovMatrix( &covLightQBar);
+  b_        ->setCovMatrix( &covB        );
+  lightP_   ->setCovMatrix( &covLightP   );
+  lightPBar_->setCovMatrix( &covLightPBar);
+  bBar_     ->setCovMatrix( &covBBar     );
   
   // perform the fit!
-  fitter_->fit();
+  runFit();
   
   // add fitted information to the solution
-  if( fitter_->getStatus()==0 ){
+  if( hasFitResult() ){
     // read back jet kinematics
     fittedB_= pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(b_->getCurr4Vec()->X(), b_->getCurr4Vec()->Y(), b_->getCurr4Vec()->Z(), b_->getCurr4Vec()->E()), math::XYZPoint()));
     fittedLightQ_   = pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(lightQ_->getCurr4Vec()->X(), lightQ_->getCurr4Vec()->Y(), lightQ_->getCurr4Vec()->Z(), lightQ_->getCurr4Vec()->E()), math::XYZPoint()));
@@ -260,6 +297,19 @@ TtFullHadKinFitter::fit(const std::vector<pat::Jet>& jets)
   return fitter_->getStatus();
 }
 
+/// embed the fitted covariance matrices as kinematic resolutions into the fitted particles of the last fit
+void
+TtFullHadKinFitter::embedFitResolutions()
+{
+  if(!hasFitResult()) return;
+  embedCovMatrixFit(fittedB_        , b_        , jetParam_, true);
+  embedCovMatrixFit(fittedBBar_     , bBar_     , jetParam_, true);
+  embedCovMatrixFit(fittedLightQ_   , lightQ_   , jetParam_, true);
+  embedCovMatrixFit(fittedLightQBar_, lightQBar_, jetParam_, true);
+  embedCovMatrixFit(fittedLightP_   , lightP_   , jetParam_, true);
+  embedCovMatrixFit(fittedLightPBar_, lightPBar_, jetParam_, true);
+}
+
 /// add kin fit information to the old event solution (in for legacy reasons)
 TtHadEvtSolution 
 TtFullHadKinFitter::addKinFitInfo(TtHadEvtSolution * asol) 
@@ -308,6 +358,7 @@ TtFullHadKinFitter::KinFit::KinFit() :
   jetCorrectionLevel_("L3Absolute"),
   maxNJets_(-1),
   maxNComb_(1),
+  maxNResults_(0),
   maxNrIter_(500),
   maxDeltaS_(5e-5),
   maxF_(0.0001),
@@ -315,8 +366,20 @@ TtFullHadKinFitter::KinFit::KinFit() :
   mW_(80.4),
   mTop_(173.),
   useOnlyMatch_(false),
-  match_(std::vector<int>(0)),
-  invalidMatch_(false)
+  matches_(std::vector<std::vector<int> >(0)),
+  invalidMatch_(false),
+  nDijetJets_(0),
+  covM_(0),
+  fitInputDump_(0),
+  exportFitCovariance_(false),
+  keepUnconverged_(false),
+  maxNFittedCombis_(0),
+  maxFitTime_(0.),
+  exhaustive_(true),
+  factoriseFits_(false),
+  coupled_(false),
+  symmetric_(false),
+  pool_(new TopKinFitterThreadPool(1))
 {
   constraints_.push_back(1);
   constraints_.push_back(2);
@@ -341,6 +404,7 @@ TtFullHadKinFitter::KinFit::KinFit(bool useBTagging, unsigned int bTags, std::st
   jetCorrectionLevel_(jetCorrectionLevel),
   maxNJets_(maxNJets),
   maxNComb_(maxNComb),
+  maxNResults_(0),
   maxNrIter_(maxNrIter),
   maxDeltaS_(maxDeltaS),
   maxF_(maxF),
@@ -349,83 +413,201 @@ TtFullHadKinFitter::KinFit::KinFit(bool useBTagging, unsigned int bTags, std::st
   mW_(mW),
   mTop_(mTop),
   useOnlyMatch_(false),
-  invalidMatch_(false)
+  invalidMatch_(false),
+  nDijetJets_(0),
+  covM_(0),
+  fitInputDump_(0),
+  exportFitCovariance_(false),
+  keepUnconverged_(false),
+  maxNFittedCombis_(0),
+  maxFitTime_(0.),
+  exhaustive_(true),
+  factoriseFits_(false),
+  coupled_(false),
+  symmetric_(false),
+  pool_(new TopKinFitterThreadPool(1))
 {
   // define kinematic fit interface
-  fitter = new TtFullHadKinFitter(param(jetParam_), maxNrIter_, maxDeltaS_, maxF_, TtFullHadKinFitter::KinFit::constraints(constraints_), mW_, mTop_,
-				  &udscResolutions_, &bResolutions_, &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_);
+  fitter = newFitter();
+  setupTripletFitters();
 }
 
 /// default destructor  
 TtFullHadKinFitter::KinFit::~KinFit()
 {
   delete fitter;
+  for(unsigned int i=0; i<workers_.size(); ++i)
+    delete workers_[i];
+  for(unsigned int branch=0; branch<2; ++branch)
+    for(unsigned int i=0; i<tripletFitters_[branch].size(); ++i)
+      delete tripletFitters_[branch][i];
+  delete covM_;
+  delete pool_;
 }    
 
-bool
-TtFullHadKinFitter::KinFit::doBTagging(const std::vector<pat::Jet>& jets, const unsigned int& bJetCounter, std::vector<int>& combi){
-  
-  if( !useBTagging_ ) {
-    return true;
+/// create a kinematic fit interface with the configured parameters
+TtFullHadKinFitter*
+TtFullHadKinFitter::KinFit::newFitter()
+{
+  return new TtFullHadKinFitter(param(jetParam_), maxNrIter_, maxDeltaS_, maxF_, TtFullHadKinFitter::KinFit::constraints(constraints_), mW_, mTop_,
+				&udscResolutions_, &bResolutions_, &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_);
+}
+
+/// set the number of threads to distribute the fits of the jet combinations of an event over
+void
+TtFullHadKinFitter::KinFit::setNumThreads(unsigned int numThreads)
+{
+  for(unsigned int i=0; i<workers_.size(); ++i)
+    delete workers_[i];
+  workers_.clear();
+  delete pool_;
+  pool_ = new TopKinFitterThreadPool(numThreads);
+  // one fit context per additional thread
+  for(unsigned int worker=1; worker<pool_->nThreads(); ++worker){
+    workers_.push_back(newFitter());
+    workers_.back()->setKeepUnconverged(keepUnconverged_);
   }
-  if( bTags_ == 2 &&
-      jets[combi[TtFullHadEvtPartons::B        ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-      jets[combi[TtFullHadEvtPartons::BBar     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-      jets[combi[TtFullHadEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-      jets[combi[TtFullHadEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-      jets[combi[TtFullHadEvtPartons::LightP   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-      jets[combi[TtFullHadEvtPartons::LightPBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-    return true;
+  setupTripletFitters();
+}
+
+/// create the kinematic fit interfaces for the jet triplets if the constraints allow for it
+void
+TtFullHadKinFitter::KinFit::setupTripletFitters()
+{
+  for(unsigned int branch=0; branch<2; ++branch){
+    for(unsigned int i=0; i<tripletFitters_[branch].size(); ++i)
+      delete tripletFitters_[branch][i];
+    tripletFitters_[branch].clear();
+    tripletConstraints_[branch].clear();
   }
-  else if( bTags_ == 1 ){  
-    if( bJetCounter == 1 &&
-        (jets[combi[TtFullHadEvtPartons::B        ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ ||
-         jets[combi[TtFullHadEvtPartons::BBar     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_) &&
-	 jets[combi[TtFullHadEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	 jets[combi[TtFullHadEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	 jets[combi[TtFullHadEvtPartons::LightP   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	 jets[combi[TtFullHadEvtPartons::LightPBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-      return true;
-    }
-    else if( bJetCounter > 1 &&
-	     jets[combi[TtFullHadEvtPartons::B        ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::BBar     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightP   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightPBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-      return true;
+  if( !factoriseFits_ ) return;
+
+  // the mass constraints of the two branches, the second one mapped onto the first one
+  coupled_ = false;
+  const std::vector<TtFullHadKinFitter::Constraint> allConstraints = constraints(constraints_);
+  for(unsigned int i=0; i<allConstraints.size(); ++i){
+    switch(allConstraints[i]){
+    case TtFullHadKinFitter::kWPlusMass      : tripletConstraints_[0].push_back(TtFullHadKinFitter::kWPlusMass); break;
+    case TtFullHadKinFitter::kTopMass        : tripletConstraints_[0].push_back(TtFullHadKinFitter::kTopMass  ); break;
+    case TtFullHadKinFitter::kWMinusMass     : tripletConstraints_[1].push_back(TtFullHadKinFitter::kWPlusMass); break;
+    case TtFullHadKinFitter::kTopBarMass     : tripletConstraints_[1].push_back(TtFullHadKinFitter::kTopMass  ); break;
+    case TtFullHadKinFitter::kEqualTopMasses : coupled_ = true; break;
     }
   }
-  else if( bTags_ == 0 ){  
-    if( bJetCounter == 0){
-      return true;
-    }
-    else if( bJetCounter == 1 &&
-	     (jets[combi[TtFullHadEvtPartons::B        ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ ||
-	      jets[combi[TtFullHadEvtPartons::BBar     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_) &&
-	      jets[combi[TtFullHadEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	      jets[combi[TtFullHadEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	      jets[combi[TtFullHadEvtPartons::LightP   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	      jets[combi[TtFullHadEvtPartons::LightPBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-      return true;
+  // independent branches both need constraints to gain anything; bounds need at least one
+  const bool useTriplets = (coupled_ ? !(tripletConstraints_[0].empty() && tripletConstraints_[1].empty())
+			    : !(tripletConstraints_[0].empty() || tripletConstraints_[1].empty()));
+  if( !useTriplets ){
+    tripletConstraints_[0].clear();
+    tripletConstraints_[1].clear();
+    return;
+  }
+  for(unsigned int branch=0; branch<2; ++branch)
+    std::sort(tripletConstraints_[branch].begin(), tripletConstraints_[branch].end());
+  symmetric_ = (tripletConstraints_[0] == tripletConstraints_[1]);
+
+  // one fit context per branch with constraints and thread
+  for(unsigned int branch=0; branch<2; ++branch){
+    if( tripletConstraints_[branch].empty() || (branch==1 && symmetric_) ) continue;
+    for(unsigned int worker=0; worker<pool_->nThreads(); ++worker){
+      tripletFitters_[branch].push_back(new TtFullHadKinFitter(param(jetParam_), maxNrIter_, maxDeltaS_, maxF_, tripletConstraints_[branch], mW_, mTop_,
+							       &udscResolutions_, &bResolutions_, &jetEnergyResolutionScaleFactors_, &jetEnergyResolutionEtaBinning_));
+      tripletFitters_[branch].back()->setKeepUnconverged(keepUnconverged_);
     }
-    else if( bJetCounter > 1 &&
-	     jets[combi[TtFullHadEvtPartons::B        ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::BBar     ]].bDiscriminator(bTagAlgo_) >= minBTagValueBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightQ   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightQBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightP   ]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ &&
-	     jets[combi[TtFullHadEvtPartons::LightPBar]].bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ ) {
-      return true;
+  }
+}
+
+/// fit the distinct jet triplets of the combinations; tripletOf gives the triplet fit per branch and combination
+void
+TtFullHadKinFitter::KinFit::fitTriplets(const std::vector<pat::Jet>& jets, const std::vector<std::vector<int> >& combis, const std::chrono::steady_clock::time_point& deadline,
+					std::vector<TripletFit>& tripletFits, std::vector<unsigned int> (&tripletOf)[2])
+{
+  static const int slots[2][3] = {
+    { TtFullHadEvtPartons::B   , TtFullHadEvtPartons::LightQ, TtFullHadEvtPartons::LightQBar },
+    { TtFullHadEvtPartons::BBar, TtFullHadEvtPartons::LightP, TtFullHadEvtPartons::LightPBar }
+  };
+  // distinct triplets as (fitter, b, q, q'); symmetric branches share them
+  std::map<std::vector<int>, unsigned int> index;
+  std::vector<std::vector<int> > triplets;
+  for(unsigned int branch=0; branch<2; ++branch){
+    tripletOf[branch].assign(combis.size(), 0);
+    if( tripletConstraints_[branch].empty() ) continue;
+    for(unsigned int idx=0; idx<combis.size(); ++idx){
+      std::vector<int> triplet(4);
+      triplet[0] = (symmetric_ ? 0 : branch);
+      for(unsigned int i=0; i<3; ++i)
+	triplet[i+1] = combis[idx][slots[branch][i]];
+      std::map<std::vector<int>, unsigned int>::const_iterator known = index.find(triplet);
+      if(known == index.end()){
+	tripletOf[branch][idx] = index[triplet] = triplets.size();
+	triplets.push_back(triplet);
+      }
+      else tripletOf[branch][idx] = known->second;
     }
   }
-  else if( bTags_ > 2 ){
+
+  // fit each of them once, distributed over the threads (serially under a time budget); all
+  // fitters use the slots of the first branch, the jets in the slots of the second one do
+  // not enter any constraint
+  tripletFits.assign(triplets.size(), TripletFit());
+  pool_->run(triplets.size(), [&](const unsigned int worker, const unsigned int idx) {
+      if(maxFitTime_>0. && std::chrono::steady_clock::now()>deadline) return;
+      const std::vector<int>& triplet = triplets[idx];
+      TtFullHadKinFitter* kinFitter = tripletFitters_[triplet[0]][worker];
+      std::vector<int> combi(nPartons);
+      combi[TtFullHadEvtPartons::B        ] = combi[TtFullHadEvtPartons::BBar     ] = triplet[1];
+      combi[TtFullHadEvtPartons::LightQ   ] = combi[TtFullHadEvtPartons::LightP   ] = triplet[2];
+      combi[TtFullHadEvtPartons::LightQBar] = combi[TtFullHadEvtPartons::LightPBar] = triplet[3];
+
+      TripletFit& fit = tripletFits[idx];
+      fit.fitted    = true;
+      fit.status    = kinFitter->fit(jetCombination(jets, combi));
+      fit.chi2      = kinFitter->fitS();
+      fit.residual  = kinFitter->fitF();
+      fit.ndf       = kinFitter->fitNDF();
+      fit.hasResult = kinFitter->hasFitResult();
+      fit.rescued   = kinFitter->fitRescued();
+      fit.rescuedChi2 = kinFitter->fitRescuedS();
+      if( !fit.hasResult ) return;
+      fit.b         = kinFitter->fittedB();
+      fit.lightQ    = kinFitter->fittedLightQ();
+      fit.lightQBar = kinFitter->fittedLightQBar();
+    }, maxFitTime_>0.);
+  // count the triplet fits in the statistics of the main fitter
+  for(unsigned int branch=0; branch<2; ++branch)
+    for(unsigned int i=0; i<tripletFitters_[branch].size(); ++i)
+      fitter->takeFitStats(*tripletFitters_[branch][i]);
+}
+
+/// restrict the jet assignments to those compatible with the b-tagging; returns false if there are none
+bool
+TtFullHadKinFitter::KinFit::setupBTagging(const std::vector<pat::Jet>& jets, JetCombinationGenerator<TtFullHadTopology>& combinations)
+{
+  if( !useBTagging_ ) {
+    return true;
+  }
+  if( bTags_ > 2 ){
     throw cms::Exception("Configuration")
       << "Wrong number of bTags (" << bTags_ << " bTags not supported)!\n";
-    return true;
   }
-  return false;
+  // flag the jets once as b-tagged and/or light
+  std::vector<bool> bTagged, light;
+  unsigned int bJetCounter = 0;
+  for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet < jets.end(); ++jet){
+    bTagged.push_back( jet->bDiscriminator(bTagAlgo_) >= minBTagValueBJet_    );
+    light  .push_back( jet->bDiscriminator(bTagAlgo_) <  maxBTagValueNonBJet_ );
+    if(bTagged.back()) ++bJetCounter;
+  }
+  // with bTags=2 both b partons need b-tagged jets; otherwise as many as there are
+  // b-tagged jets in the event (at most two), at least bTags of them; without any
+  // b-tagged jet and bTags=0 all assignments are used
+  if( bTags_ == 2 )
+    combinations.setBTagging(bTagged, light, 2);
+  else if( bJetCounter < bTags_ )
+    return false;
+  else if( bJetCounter > 0 )
+    combinations.setBTagging(bTagged, light, std::min(bJetCounter, 2u));
+  return true;
 }
 
 /// helper function to construct the proper corrected jet for its corresponding quarkType
@@ -454,10 +636,142 @@ TtFullHadKinFitter::KinFit::corJet(const pat::Jet& jet, const std::string& quark
   return ret;
 }
 
+/// helper function to construct the corrected jets of a given jet combination
+std::vector<pat::Jet>
+TtFullHadKinFitter::KinFit::jetCombination(const std::vector<pat::Jet>& jets, const std::vector<int>& combi)
+{
+  std::vector<pat::Jet> jetCombi;
+  jetCombi.resize(nPartons);
+  jetCombi[TtFullHadEvtPartons::LightQ   ] = corJet(jets[combi[TtFullHadEvtPartons::LightQ   ]], "wMix");
+  jetCombi[TtFullHadEvtPartons::LightQBar] = corJet(jets[combi[TtFullHadEvtPartons::LightQBar]], "wMix");
+  jetCombi[TtFullHadEvtPartons::B        ] = corJet(jets[combi[TtFullHadEvtPartons::B        ]], "bottom");
+  jetCombi[TtFullHadEvtPartons::BBar     ] = corJet(jets[combi[TtFullHadEvtPartons::BBar     ]], "bottom");
+  jetCombi[TtFullHadEvtPartons::LightP   ] = corJet(jets[combi[TtFullHadEvtPartons::LightP   ]], "wMix");
+  jetCombi[TtFullHadEvtPartons::LightPBar] = corJet(jets[combi[TtFullHadEvtPartons::LightPBar]], "wMix");
+  return jetCombi;
+}
+
+/// fill the W candidates of all jet pairs of the event
+void
+TtFullHadKinFitter::KinFit::fillDijetTable(const std::vector<pat::Jet>& jets)
+{
+  if(!covM_){
+    if(udscResolutions_.size() && bResolutions_.size())
+      covM_ = new CovarianceMatrix(udscResolutions_, bResolutions_, jetEnergyResolutionScaleFactors_, jetEnergyResolutionEtaBinning_);
+    else
+      covM_ = new CovarianceMatrix();
+  }
+  // corrected 4-vectors of the jets as light and as b jets and their relative energy
+  // resolution, approximated by the relative resolution of the transverse energy
+  wJets_.clear();
+  bJets_.clear();
+  wJetResolutions_.clear();
+  bJetResolutions_.clear();
+  for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet < jets.end(); ++jet){
+    const pat::Jet wJet = corJet(*jet, "wMix");
+    const pat::Jet bJet = corJet(*jet, "bottom");
+    wJets_.push_back(TLorentzVector(wJet.px(), wJet.py(), wJet.pz(), wJet.energy()));
+    bJets_.push_back(TLorentzVector(bJet.px(), bJet.py(), bJet.pz(), bJet.energy()));
+    const TMatrixD wCov = covM_->setupMatrix(wJets_.back(), CovarianceMatrix::kUdscJet, TopKinFitter::kEtEtaPhi);
+    const TMatrixD bCov = covM_->setupMatrix(bJets_.back(), CovarianceMatrix::kBJet   , TopKinFitter::kEtEtaPhi);
+    wJetResolutions_.push_back(wJets_.back().Et()>0. ? std::sqrt(wCov(0,0))/wJets_.back().Et() : 0.);
+    bJetResolutions_.push_back(bJets_.back().Et()>0. ? std::sqrt(bCov(0,0))/bJets_.back().Et() : 0.);
+  }
+  const std::vector<TLorentzVector>& p4s = wJets_;
+  const std::vector<double>& resolutions = wJetResolutions_;
+  // the neglect of the angular resolutions gives a relative mass resolution of half
+  // the relative energy resolutions of both jets added in quadrature
+  nDijetJets_ = jets.size();
+  dijets_.resize(nDijetJets_*nDijetJets_);
+  for(unsigned int i=0; i<nDijetJets_; ++i){
+    for(unsigned int j=i; j<nDijetJets_; ++j){
+      DijetW& w = dijets_[i*nDijetJets_+j];
+      w.mass = (p4s[i]+p4s[j]).M();
+      const double sigma = 0.5*w.mass*std::sqrt(resolutions[i]*resolutions[i]+resolutions[j]*resolutions[j]);
+      w.pull = (sigma>0. ? (w.mass-mW_)/sigma : 0.);
+      dijets_[j*nDijetJets_+i] = w;
+    }
+  }
+}
+
+/// return whether one of the W candidates of a jet combination fails the pull cut
+bool
+TtFullHadKinFitter::KinFit::hopelessW(const std::vector<int>& combi) const
+{
+  return (std::fabs(dijet(combi[TtFullHadEvtPartons::LightQ], combi[TtFullHadEvtPartons::LightQBar]).pull)>pruning_.maxWPull() ||
+	  std::fabs(dijet(combi[TtFullHadEvtPartons::LightP], combi[TtFullHadEvtPartons::LightPBar]).pull)>pruning_.maxWPull());
+}
+
+/// sum of the squared pulls of the W and top candidates of the assigned branches of a (partial) jet combination
+double
+TtFullHadKinFitter::KinFit::beamScore(const std::vector<int>& combi) const
+{
+  static const int slots[2][3] = {
+    { TtFullHadEvtPartons::LightQ, TtFullHadEvtPartons::LightQBar, TtFullHadEvtPartons::B    },
+    { TtFullHadEvtPartons::LightP, TtFullHadEvtPartons::LightPBar, TtFullHadEvtPartons::BBar }
+  };
+  double score = 0.;
+  for(unsigned int branch=0; branch<2; ++branch){
+    const int lightQ = combi[slots[branch][0]], lightQBar = combi[slots[branch][1]], b = combi[slots[branch][2]];
+    if(lightQ<0 || lightQBar<0) continue;
+    const double wPull = dijet(lightQ, lightQBar).pull;
+    score += wPull*wPull;
+    if(b<0) continue;
+    // the top candidates are compared to mTop, also if only their equality is constrained
+    std::vector<TLorentzVector> summands(1, wJets_[lightQ]);
+    summands.push_back(wJets_[lightQBar]);
+    summands.push_back(bJets_[b]);
+    std::vector<double> resolutions(1, wJetResolutions_[lightQ]);
+    resolutions.push_back(wJetResolutions_[lightQBar]);
+    resolutions.push_back(bJetResolutions_[b]);
+    double top, topSigma;
+    TopKinFitter::massResolution(summands, resolutions, top, topSigma);
+    if(topSigma>0.) score += std::pow((top-mTop_)/topSigma, 2);
+  }
+  return score;
+}
+
+/// order the jet combinations by the pulls of their W candidates (best first)
+void
+TtFullHadKinFitter::KinFit::orderCombinations(std::vector<std::vector<int> >& combis)
+{
+  // sum of the squared pulls of both W candidates; equal scores keep the enumeration order
+  std::vector<std::pair<double, unsigned int> > scores;
+  for(unsigned int idx=0; idx<combis.size(); ++idx){
+    const std::vector<int>& combi = combis[idx];
+    const double wPlus  = dijet(combi[TtFullHadEvtPartons::LightQ], combi[TtFullHadEvtPartons::LightQBar]).pull;
+    const double wMinus = dijet(combi[TtFullHadEvtPartons::LightP], combi[TtFullHadEvtPartons::LightPBar]).pull;
+    scores.push_back(std::make_pair(wPlus*wPlus + wMinus*wMinus, idx));
+  }
+  std::sort(scores.begin(), scores.end());
+  std::vector<std::vector<int> > ordered;
+  ordered.reserve(combis.size());
+  for(unsigned int i=0; i<scores.size(); ++i)
+    ordered.push_back(combis[scores[i].second]);
+  combis.swap(ordered);
+}
+
 std::list<TtFullHadKinFitter::KinFitResult> 
 TtFullHadKinFitter::KinFit::fit(const std::vector<pat::Jet>& jets){
 
   std::list<TtFullHadKinFitter::KinFitResult>  fitResults;
+  exhaustive_ = true;
+
+  // adapt the iteration limit at the event boundary only
+  const bool newMaxNrIter = tuning_.beginEvent(fitter->fitStats());
+  pruning_.beginEvent();
+  beamSearch_.beginEvent();
+  // fits and fit time so far, for the actual cost of the event
+  const unsigned long nFitsBefore = fitter->fitStats().nFits();
+  const double fitTimeBefore = fitter->fitStats().time();
+  std::vector<TtFullHadKinFitter*> kinFitters(1, fitter);
+  kinFitters.insert(kinFitters.end(), workers_.begin(), workers_.end());
+  for(unsigned int branch=0; branch<2; ++branch)
+    kinFitters.insert(kinFitters.end(), tripletFitters_[branch].begin(), tripletFitters_[branch].end());
+  for(unsigned int i=0; i<kinFitters.size(); ++i){
+    if(newMaxNrIter) kinFitters[i]->setMaxNrIter(tuning_.maxNrIter());
+    kinFitters[i]->setValidation(tuning_.validateEvent());
+  }
 
   /**
    // --------------------------------------------------------
@@ -477,16 +791,20 @@ TtFullHadKinFitter::KinFit::fit(const std::vector<pat::Jet>& jets){
     result.Chi2     = -1.;
     // chi2 probability
     result.Prob     = -1.;
-    // the kinFit getters return empty objects here
-    result.B        = fitter->fittedB();
-    result.BBar     = fitter->fittedBBar();
-    result.LightQ   = fitter->fittedLightQ();
-    result.LightQBar= fitter->fittedLightQBar();
-    result.LightP   = fitter->fittedLightP();
-    result.LightPBar= fitter->fittedLightPBar();
+    // distance from the constraints
+    result.Residual = -1.;
+    // empty objects, independent of which fitter did the last fit
+    result.B        = pat::Particle();
+    result.BBar     = pat::Particle();
+    result.LightQ   = pat::Particle();
+    result.LightQBar= pat::Particle();
+    result.LightP   = pat::Particle();
+    result.LightPBar= pat::Particle();
     result.JetCombi = invalidCombi;
     // push back fit result
     fitResults.push_back( result );
+    if(cost_.enabled()) cost_.fill(0, 0, 0.);
+    fitter->endEvent();
     return fitResults;
   }
 
@@ -495,80 +813,301 @@ TtFullHadKinFitter::KinFit::fit(const std::vector<pat::Jet>& jets){
      (or only a given jet combination if useOnlyMatch=true)
   **/
 
+  // the jets to be considered, with b-tagging as many b-tagged jets as there are b partons
   std::vector<int> jetIndices;
-  if(!useOnlyMatch_) {
-    for(unsigned int idx=0; idx<jets.size(); ++idx){
-      if(maxNJets_>=(int)nPartons && maxNJets_==(int)idx) break;
-      jetIndices.push_back(idx);
+  if(!useOnlyMatch_) preselection_.select(jets, maxNJets_, nPartons, useBTagging_ ? 2 : 0, bTagAlgo_, minBTagValueBJet_, jetIndices);
+  
+  // canonical assignments of the jets to the partons, taking into account the
+  // indistinguishability of the two jets from either W decay and of the two
+  // decay branches, which reduces the combinatorics by a factor of 2*2*2
+  JetCombinationGenerator<TtFullHadTopology> combinations(jetIndices);
+  const bool bTagsPossible = setupBTagging(jets, combinations);
+  // number of fits of the full enumeration, known before any fit
+  unsigned long nPredicted = (cost_.enabled() && bTagsPossible && !useOnlyMatch_ ? TopKinFitterCost::nCombinations(combinations) : 0);
+
+  // W candidates of all jet pairs, for the pull cut, the beam search and the order of the fits
+  const bool budget = (maxNFittedCombis_>0 || maxFitTime_>0.);
+  const bool useBeam = (beamSearch_.enabled() && !useOnlyMatch_);
+  if(budget || pruning_.enabled() || useBeam) fillDijetTable(jets);
+
+  // don't go through combinatorics if useOnlyMatch was chosen; the generated
+  // assignments are compatible with the b-tagging, given matches have to be checked
+  std::vector<std::vector<int> > combis;
+  std::set<std::vector<int> > beamCombis;
+  bool beamTruncated = false;
+  if( bTagsPossible ) {
+    if(useOnlyMatch_) {
+      for(unsigned int i=0; i<matches_.size(); ++i)
+	if(combinations.accept(matches_[i])) combis.push_back(matches_[i]);
+      nPredicted = combis.size();
+    }
+    else if(useBeam) {
+      // approximate search: the partial assignments are ranked by the pulls of their W
+      // and top candidates; in validation events all combinations are fitted, those
+      // outside the beam without entering the result
+      beamTruncated = !combinations.beamSearch(beamSearch_.beamWidth(), [this](const std::vector<int>& combi) { return beamScore(combi); }, combis);
+      beamSearch_.fill(beamTruncated);
+      if(beamSearch_.validateEvent()){
+	beamCombis.insert(combis.begin(), combis.end());
+	combis.clear();
+	std::vector<int> combi;
+	while(combinations.next(combi)) combis.push_back(combi);
+      }
+    }
+    else {
+      std::vector<int> combi;
+      while(combinations.next(combi)) combis.push_back(combi);
     }
   }
-  
-  std::vector<int> combi;
-  for(unsigned int idx=0; idx<nPartons; ++idx) {
-    useOnlyMatch_?combi.push_back(match_[idx]):combi.push_back(idx);
+  const bool validateBeam = (useBeam && beamSearch_.validateEvent());
+
+  // skip the combinations with a hopeless W candidate; in validation events they are
+  // fitted nevertheless, but do not enter the result
+  const unsigned int nCandidates = combis.size();
+  unsigned int nCut = 0;
+  if(pruning_.enabled()){
+    nCut = std::count_if(combis.begin(), combis.end(), [this](const std::vector<int>& combi) { return hopelessW(combi); });
+    if(!pruning_.validateEvent())
+      combis.erase(std::remove_if(combis.begin(), combis.end(), [this](const std::vector<int>& combi) { return hopelessW(combi); }), combis.end());
   }
+  const bool validateCut = pruning_.validateEvent();
+
+  // with a budget, the most promising combinations are fitted first, such that the
+  // best result so far is meaningful when the budget is used up
+  if(budget && combis.size()>1) orderCombinations(combis);
+  const unsigned int nCombis = combis.size();
+  if(maxNFittedCombis_>0 && combis.size()>maxNFittedCombis_) combis.resize(maxNFittedCombis_);
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(maxFitTime_));
 
   
-  unsigned int bJetCounter = 0;
-  for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet < jets.end(); ++jet){
-    if(jet->bDiscriminator(bTagAlgo_) >= minBTagValueBJet_) ++bJetCounter;
-  }
-
-  do{
-    for(int cnt=0; cnt<TMath::Factorial(combi.size()); ++cnt){
-      // take into account indistinguishability of the two jets from the two W decays,
-      // and the two decay branches, this reduces the combinatorics by a factor of 2*2*2
-      if( ((combi[TtFullHadEvtPartons::LightQ] < combi[TtFullHadEvtPartons::LightQBar] &&
-	    combi[TtFullHadEvtPartons::LightP] < combi[TtFullHadEvtPartons::LightPBar] &&
-	    combi[TtFullHadEvtPartons::B]      < combi[TtFullHadEvtPartons::BBar]    ) ||
-	   useOnlyMatch_) && doBTagging(jets, bJetCounter, combi) ) {
-
-	std::vector<pat::Jet> jetCombi;
-	jetCombi.resize(nPartons);
-	jetCombi[TtFullHadEvtPartons::LightQ   ] = corJet(jets[combi[TtFullHadEvtPartons::LightQ   ]], "wMix");
-	jetCombi[TtFullHadEvtPartons::LightQBar] = corJet(jets[combi[TtFullHadEvtPartons::LightQBar]], "wMix");
-	jetCombi[TtFullHadEvtPartons::B        ] = corJet(jets[combi[TtFullHadEvtPartons::B        ]], "bottom");
-	jetCombi[TtFullHadEvtPartons::BBar     ] = corJet(jets[combi[TtFullHadEvtPartons::BBar     ]], "bottom");
-	jetCombi[TtFullHadEvtPartons::LightP   ] = corJet(jets[combi[TtFullHadEvtPartons::LightP   ]], "wMix");
-	jetCombi[TtFullHadEvtPartons::LightPBar] = corJet(jets[combi[TtFullHadEvtPartons::LightPBar]], "wMix");
-	  
-	// do the kinematic fit
-	int status = fitter->fit(jetCombi);
-	  
-	if( status == 0 ) { 
-	  // fill struct KinFitResults if converged
-	  TtFullHadKinFitter::KinFitResult result;
-	  result.Status   = status;
-	  result.Chi2     = fitter->fitS();
-	  result.Prob     = fitter->fitProb();
-	  result.B        = fitter->fittedB();
-	  result.BBar     = fitter->fittedBBar();
-	  result.LightQ   = fitter->fittedLightQ();
-	  result.LightQBar= fitter->fittedLightQBar();
-	  result.LightP   = fitter->fittedLightP();
-	  result.LightPBar= fitter->fittedLightPBar();
-	  result.JetCombi = combi;
-	  // push back fit result
-	  fitResults.push_back( result );
+  // best combination with and without the rescued fits (validation events only)
+  std::vector<int> bestCombi, bestTunedCombi;
+  double bestChi2 = -1., bestTunedChi2 = -1.;
+  unsigned int nRescued = 0;
+
+  // record the fit inputs if requested
+  TopKinFitterRecord record(TopKinFitterRecord::kFullHad);
+  if(fitInputDump_){
+    record.jetParam    = record.lepParam = record.metParam = jetParam_;
+    record.constraints = std::vector<int>(constraints_.begin(), constraints_.end());
+    record.mW          = mW_;
+    record.mTop        = mTop_;
+    record.jetEnergyResolutionScaleFactors = jetEnergyResolutionScaleFactors_;
+    record.jetEnergyResolutionEtaBinning   = jetEnergyResolutionEtaBinning_;
+    for(std::vector<pat::Jet>::const_iterator jet = jets.begin(); jet < jets.end(); ++jet){
+      const pat::Jet wJet = corJet(*jet, "wMix");
+      const pat::Jet bJet = corJet(*jet, "bottom");
+      record.jets .push_back(TLorentzVector(wJet.px(), wJet.py(), wJet.pz(), wJet.energy()));
+      record.bJets.push_back(TLorentzVector(bJet.px(), bJet.py(), bJet.pz(), bJet.energy()));
+    }
+  }
+
+  // best maxNResults results per thread
+  if(bestResults_.size()!=pool_->nThreads() || bestResults_[0].capacity()!=maxNResults_)
+    bestResults_.assign(pool_->nThreads(), TopKinFitterTopK<TtFullHadKinFitter::KinFitResult>(maxNResults_));
+  for(unsigned int worker=0; worker<bestResults_.size(); ++worker)
+    bestResults_[worker].clear();
+
+  // fits of the distinct jet triplets of the two top branches: with independent branches
+  // the chi2 of a combination is the sum of the chi2 of its two triplets; with equal top
+  // masses this sum is a lower bound, as the combination has to fulfil one more constraint
+  const bool useTriplets = !(tripletConstraints_[0].empty() && tripletConstraints_[1].empty());
+  std::vector<TripletFit> tripletFits;
+  std::vector<unsigned int> tripletOf[2];
+  if(useTriplets) fitTriplets(jets, combis, deadline, tripletFits, tripletOf);
+
+  std::vector<CombiFit> fits(combis.size());
+  for(unsigned int idx=0; validateBeam && idx<combis.size(); ++idx)
+    fits[idx].offBeam = (beamCombis.count(combis[idx])==0);
+  if(useTriplets && !coupled_){
+    for(unsigned int idx=0; idx<combis.size(); ++idx){
+      const TripletFit& top    = tripletFits[tripletOf[0][idx]];
+      const TripletFit& topBar = tripletFits[tripletOf[1][idx]];
+      CombiFit& fit = fits[idx];
+      fit.fitted = (top.fitted && topBar.fitted);
+      if( !fit.fitted ) continue;
+      fit.status    = (top.status!=0 ? top.status : topBar.status);
+      fit.chi2      = top.chi2 + topBar.chi2;
+      fit.hasResult = (top.hasResult && topBar.hasResult);
+      // converged with the configured iteration limit only
+      fit.rescued   = (fit.status!=0 && (top.status==0 || top.rescued) && (topBar.status==0 || topBar.rescued));
+      fit.rescuedChi2 = (top.rescued ? top.rescuedChi2 : top.chi2) + (topBar.rescued ? topBar.rescuedChi2 : topBar.chi2);
+      fit.cut       = (validateCut && hopelessW(combis[idx]));
+      if( fit.cut || fit.offBeam || !fit.hasResult || !bestResults_[0].accepts(fit.chi2, idx) ) continue;
+      TtFullHadKinFitter::KinFitResult result;
+      result.Status   = fit.status;
+      result.Chi2     = fit.chi2;
+      result.Prob     = TMath::Prob(fit.chi2, top.ndf+topBar.ndf);
+      result.Residual = top.residual + topBar.residual;
+      result.B        = top.b;
+      result.LightQ   = top.lightQ;
+      result.LightQBar= top.lightQBar;
+      result.BBar     = topBar.b;
+      result.LightP   = topBar.lightQ;
+      result.LightPBar= topBar.lightQBar;
+      result.JetCombi = combis[idx];
+      bestResults_[0].push(fit.chi2, idx, result);
+    }
+  }
+  else {
+    // lower bounds on the chi2 (only from converged triplet fits) and the order of the fits,
+    // lowest bound first, such that good results are found early and prune the rest
+    std::vector<double> bounds(combis.size(), 0.);
+    std::vector<unsigned int> order(combis.size());
+    for(unsigned int idx=0; idx<combis.size(); ++idx){
+      order[idx] = idx;
+      for(unsigned int branch=0; useTriplets && branch<2; ++branch){
+	if( tripletConstraints_[branch].empty() ) continue;
+	const TripletFit& triplet = tripletFits[tripletOf[branch][idx]];
+	if(triplet.hasResult && triplet.status == 0) bounds[idx] += triplet.chi2;
+      }
+    }
+    if(useTriplets)
+      std::stable_sort(order.begin(), order.end(), [&](const unsigned int lhs, const unsigned int rhs) { return bounds[lhs]<bounds[rhs]; });
+
+    // fit the jet combinations distributed over the threads, each with its own fitter; the
+    // outcomes are stored by position and the results ranked by chi2 and position, such
+    // that the result does not depend on the number of threads. The pruning depends on the
+    // results fitted before, and with a time budget the fits done in time depend on the
+    // order: these run serially, in the order of the bound
+    pool_->run(combis.size(), [&](const unsigned int worker, const unsigned int pos) {
+	TtFullHadKinFitter* kinFitter = (worker==0 ? fitter : workers_[worker-1]);
+	const unsigned int idx = order[pos];
+
+	// do the kinematic fit unless the time budget is used up or the lower bound
+	// on its chi2 already excludes it from the best maxNResults so far
+	CombiFit& fit = fits[idx];
+	if(maxFitTime_>0. && std::chrono::steady_clock::now()>deadline) return;
+	if(useTriplets && !bestResults_[worker].accepts(bounds[idx], idx)){
+	  fit.pruned = true;
+	  return;
 	}
+	fit.fitted = true;
+	fit.cut = (validateCut && hopelessW(combis[idx]));
+	fit.status = kinFitter->fit(jetCombination(jets, combis[idx]));
+	fit.chi2 = kinFitter->fitS();
+	fit.hasResult = kinFitter->hasFitResult();
+	fit.rescued = kinFitter->fitRescued();
+	fit.rescuedChi2 = kinFitter->fitRescuedS();
+
+	// fill struct KinFitResults if converged (or stopped at the
+	// maximal number of iterations if these fits are to be kept)
+	// and among the best maxNResults so far; combinations failing
+	// the W pull cut or outside the beam are only fitted for
+	// their validation
+	if( fit.cut || fit.offBeam || !fit.hasResult || !bestResults_[worker].accepts(fit.chi2, idx) ) return;
+	TtFullHadKinFitter::KinFitResult result;
+	result.Status   = fit.status;
+	result.Chi2     = fit.chi2;
+	result.Prob     = kinFitter->fitProb();
+	result.Residual = kinFitter->fitF();
+	result.B        = kinFitter->fittedB();
+	result.BBar     = kinFitter->fittedBBar();
+	result.LightQ   = kinFitter->fittedLightQ();
+	result.LightQBar= kinFitter->fittedLightQBar();
+	result.LightP   = kinFitter->fittedLightP();
+	result.LightPBar= kinFitter->fittedLightPBar();
+	result.JetCombi = combis[idx];
+	bestResults_[worker].push(fit.chi2, idx, result);
+      }, useTriplets || maxFitTime_>0.);
+    // count the fits of the worker threads in the statistics of the main fitter
+    for(unsigned int i=0; i<workers_.size(); ++i)
+      fitter->takeFitStats(*workers_[i]);
+  }
+
+  // best chi2 of the converged fits passing and failing the W pull cut, and inside and
+  // outside the beam (validation events only)
+  double bestKeptChi2 = -1., bestCutChi2 = -1., bestBeamChi2 = -1., bestOffBeamChi2 = -1.;
+  unsigned int nFitted = 0, nPruned = 0;
+  for(unsigned int idx=0; idx<fits.size(); ++idx){
+    const CombiFit& fit = fits[idx];
+    if( fit.pruned ) ++nPruned;
+    if( !fit.fitted ) continue;
+    ++nFitted;
+    if( fit.cut ){
+      if(fit.hasResult && fit.status == 0 && (bestCutChi2<0. || fit.chi2<bestCutChi2)) bestCutChi2 = fit.chi2;
+      continue;
+    }
+    if( fit.offBeam ){
+      if(fit.hasResult && fit.status == 0 && (bestOffBeamChi2<0. || fit.chi2<bestOffBeamChi2)) bestOffBeamChi2 = fit.chi2;
+      continue;
+    }
+    if(validateCut && fit.hasResult && fit.status == 0 && (bestKeptChi2<0. || fit.chi2<bestKeptChi2)) bestKeptChi2 = fit.chi2;
+    if(validateBeam && fit.hasResult && fit.status == 0 && (bestBeamChi2<0. || fit.chi2<bestBeamChi2)) bestBeamChi2 = fit.chi2;
+    if(fitInputDump_) record.combis.push_back(combis[idx]);
+
+    if(tuning_.validateEvent() && ((fit.hasResult && fit.status == 0) || fit.rescued)){
+      const double chi2 = (fit.rescued ? fit.rescuedChi2 : fit.chi2);
+      if(bestCombi.empty() || chi2<bestChi2){
+	bestCombi = combis[idx];
+	bestChi2  = chi2;
       }
-      // don't go through combinatorics if useOnlyMatch was chosen
-      if(useOnlyMatch_){
-	break; 
+      if(fit.rescued)
+	++nRescued;
+      else if(bestTunedCombi.empty() || fit.chi2<bestTunedChi2){
+	bestTunedCombi = combis[idx];
+	bestTunedChi2  = fit.chi2;
       }
-      // next permutation
-      std::next_permutation( combi.begin(), combi.end() );
-    }
-    // don't go through combinatorics if useOnlyMatch was chosen
-    if(useOnlyMatch_){
-      break;
     }
   }
-  while( stdcomb::next_combination( jetIndices.begin(), jetIndices.end(), combi.begin(), combi.end() ) );
 
 
-  // sort results w.r.t. chi2 values
-  fitResults.sort();
+  // pruned combinations cannot be among the best ones, those dropped from the beam or
+  // by the W pull cut can (in validation events the latter are fitted, but do not
+  // enter the result either)
+  exhaustive_ = (nFitted+nPruned==nCombis && !beamTruncated && nCut==0);
+
+  pruning_.fill(nCandidates, nCut, nPruned);
+  if(validateCut)
+    pruning_.fillValidation(bestKeptChi2>=0. || bestCutChi2>=0., bestCutChi2>=0. && (bestKeptChi2<0. || bestCutChi2<bestKeptChi2));
+
+  if(validateBeam)
+    beamSearch_.fillValidation(bestBeamChi2>=0. || bestOffBeamChi2>=0., bestOffBeamChi2>=0. && (bestBeamChi2<0. || bestOffBeamChi2<bestBeamChi2));
+
+  if(tuning_.validateEvent())
+    tuning_.fillValidation(bestCombi, bestChi2, bestTunedCombi, bestTunedChi2, nRescued);
+  if(fitInputDump_)
+    record.write(*fitInputDump_);
+
+  // (best maxNResults) results of all threads, sorted w.r.t. chi2 values
+  for(unsigned int worker=1; worker<bestResults_.size(); ++worker)
+    bestResults_[0].merge(bestResults_[worker]);
+  bestResults_[0].extract(fitResults);
+
+  // refit the combinations to be written to export their fitted covariance matrices; this
+  // is deliberately not done in the loop above to not spend time on discarded combinations.
+  // Results combined from the triplet fits keep their objects and only take the covariance
+  // matrices of the joint fit
+  if(exportFitCovariance_){
+    const bool factorised = (useTriplets && !coupled_);
+    fitter->setFillStats(false);
+    unsigned int iComb = 0;
+    for(std::list<TtFullHadKinFitter::KinFitResult>::iterator result = fitResults.begin(); result != fitResults.end(); ++result){
+      if(maxNComb_>=1 && iComb==(unsigned int)maxNComb_) break;
+      ++iComb;
+      fitter->fit(jetCombination(jets, result->JetCombi));
+      // keep the objects of the original fit if the refit has no result
+      if(!fitter->hasFitResult()) continue;
+      fitter->embedFitResolutions();
+      if(factorised){
+	TopKinFitter::copyKinResolution(result->B        , fitter->fittedB());
+	TopKinFitter::copyKinResolution(result->BBar     , fitter->fittedBBar());
+	TopKinFitter::copyKinResolution(result->LightQ   , fitter->fittedLightQ());
+	TopKinFitter::copyKinResolution(result->LightQBar, fitter->fittedLightQBar());
+	TopKinFitter::copyKinResolution(result->LightP   , fitter->fittedLightP());
+	TopKinFitter::copyKinResolution(result->LightPBar, fitter->fittedLightPBar());
+	continue;
+      }
+      result->B        = fitter->fittedB();
+      result->BBar     = fitter->fittedBBar();
+      result->LightQ   = fitter->fittedLightQ();
+      result->LightQBar= fitter->fittedLightQBar();
+      result->LightP   = fitter->fittedLightP();
+      result->LightPBar= fitter->fittedLightPBar();
+    }
+    fitter->setFillStats(true);
+  }
 
   /**
      feed out result starting with the 
@@ -585,19 +1124,24 @@ TtFullHadKinFitter::KinFit::fit(const std::vector<pat::Jet>& jets){
     result.Chi2     = -1.;
     // chi2 probability
     result.Prob     = -1.;
-    // the kinFit getters return empty objects here
-    result.B        = fitter->fittedB();
-    result.BBar     = fitter->fittedBBar();
-    result.LightQ   = fitter->fittedLightQ();
-    result.LightQBar= fitter->fittedLightQBar();
-    result.LightP   = fitter->fittedLightP();
-    result.LightPBar= fitter->fittedLightPBar();
+    // distance from the constraints
+    result.Residual = -1.;
+    // empty objects, independent of which fitter did the last fit
+    result.B        = pat::Particle();
+    result.BBar     = pat::Particle();
+    result.LightQ   = pat::Particle();
+    result.LightQBar= pat::Particle();
+    result.LightP   = pat::Particle();
+    result.LightPBar= pat::Particle();
     // indices referring to the jet combination
     std::vector<int> invalidCombi(nPartons, -1);
     result.JetCombi = invalidCombi;
     // push back fit result
     fitResults.push_back( result );
   }
+  if(cost_.enabled())
+    cost_.fill(nPredicted, fitter->fitStats().nFits()-nFitsBefore, fitter->fitStats().time()-fitTimeBefore);
+  fitter->endEvent();
   return fitResults;
 }
 
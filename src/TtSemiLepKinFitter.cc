@@ -5,6 +5,9 @@
 #include "PhysicsTools/KinFitter/interface/TFitParticleEtEtaPhi.h"
 #include "PhysicsTools/KinFitter/interface/TFitParticleEtThetaPhi.h"
 #include "PhysicsTools/KinFitter/interface/TFitParticleEScaledMomDev.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitConstraintMFixed.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticleEtPhi.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TFitParticlePz.h"
 
 #include "AnalysisDataFormats/TopObjects/interface/TtSemiLepEvtPartons.h"
 #include "TopQuarkAnalysis/TopKinFitter/interface/TtSemiLepKinFitter.h"
@@ -14,10 +17,10 @@
 /// default configuration is: Parametrization kEMom, Max iterations = 200, deltaS<= 5e-5, maxF<= 1e-4, no constraints
 TtSemiLepKinFitter::TtSemiLepKinFitter():
   TopKinFitter(),
-  hadB_(0), hadP_(0), hadQ_(0), lepB_(0), lepton_(0), neutrino_(0),
+  hadB_(0), hadP_(0), hadQ_(0), lepB_(0), lepton_(0), neutrino_(0), neutrinoPz_(0),
   udscResolutions_(0), bResolutions_(0), lepResolutions_(0), metResolutions_(0),
   jetEnergyResolutionScaleFactors_(0), jetEnergyResolutionEtaBinning_(0),
-  jetParam_(kEMom), lepParam_(kEMom), metParam_(kEMom)
+  jetParam_(kEMom), lepParam_(kEMom), metParam_(kEMom), fixLepton_(false)
 {
   setupFitter();
 }
@@ -30,12 +33,13 @@ TtSemiLepKinFitter::TtSemiLepKinFitter(Param jetParam, Param lepParam, Param met
 				       const std::vector<edm::ParameterSet>* lepResolutions,
 				       const std::vector<edm::ParameterSet>* metResolutions,
 				       const std::vector<double>* jetEnergyResolutionScaleFactors,
-				       const std::vector<double>* jetEnergyResolutionEtaBinning):
+				       const std::vector<double>* jetEnergyResolutionEtaBinning,
+				       const bool fixLepton):
   TopKinFitter(maxNrIter, maxDeltaS, maxF, mW, mTop),
-  hadB_(0), hadP_(0), hadQ_(0), lepB_(0), lepton_(0), neutrino_(0),
+  hadB_(0), hadP_(0), hadQ_(0), lepB_(0), lepton_(0), neutrino_(0), neutrinoPz_(0),
   udscResolutions_(udscResolutions), bResolutions_(bResolutions), lepResolutions_(lepResolutions), metResolutions_(metResolutions),
   jetEnergyResolutionScaleFactors_(jetEnergyResolutionScaleFactors), jetEnergyResolutionEtaBinning_(jetEnergyResolutionEtaBinning),
-  jetParam_(jetParam), lepParam_(lepParam), metParam_(metParam), constrList_(constraints)
+  jetParam_(jetParam), lepParam_(lepParam), metParam_(metParam), constrList_(constraints), fixLepton_(fixLepton)
 {
   setupFitter();
 }
@@ -48,6 +52,7 @@ TtSemiLepKinFitter::~TtSemiLepKinFitter()
   delete lepB_; 
   delete lepton_; 
   delete neutrino_;
+  delete neutrinoPz_;
   delete covM_;
   for(std::map<Constraint, TFitConstraintM*>::iterator it = massConstr_.begin(); it != massConstr_.end(); ++it)
     delete it->second;
@@ -74,7 +79,7 @@ void TtSemiLepKinFitter::printSetup() const
     << "+++++++++++ TtSemiLepKinFitter Setup ++++++++++++ \n"
     << "  Parametrization:                                \n" 
     << "   * jet : " << param(jetParam_) << "\n"
-    << "   * lep : " << param(lepParam_) << "\n"
+    << "   * lep : " << (fixLepton_ ? "fixed" : param(lepParam_)) << "\n"
     << "   * met : " << param(metParam_) << "\n"
     << "  Constraints:                                    \n"
     <<    constr.str()
@@ -107,6 +112,8 @@ void TtSemiLepKinFitter::setupJets()
     hadQ_= new TFitParticleEtThetaPhi("Jet3", "Jet3", 0, &empty3x3);
     lepB_= new TFitParticleEtThetaPhi("Jet4", "Jet4", 0, &empty3x3);
     break;
+  case kEtPhiPz :
+    throw edm::Exception( edm::errors::Configuration, "The parametrisation EtPhiPz is only supported for the MET" );
   }
 }
 
@@ -117,34 +124,72 @@ void TtSemiLepKinFitter::setupLeptons()
   case kEMom       : lepton_  = new TFitParticleEScaledMomDev("Lepton",   "Lepton",   0, &empty3x3); break;
   case kEtEtaPhi   : lepton_  = new TFitParticleEtEtaPhi     ("Lepton",   "Lepton",   0, &empty3x3); break;
   case kEtThetaPhi : lepton_  = new TFitParticleEtThetaPhi   ("Lepton",   "Lepton",   0, &empty3x3); break;
+  case kEtPhiPz    :
+    throw edm::Exception( edm::errors::Configuration, "The parametrisation EtPhiPz is only supported for the MET" );
   }
   switch(metParam_){ // setup neutrino according to parameterization
   case kEMom       : neutrino_= new TFitParticleEScaledMomDev("Neutrino", "Neutrino", 0, &empty3x3); break;
   case kEtEtaPhi   : neutrino_= new TFitParticleEtEtaPhi     ("Neutrino", "Neutrino", 0, &empty3x3); break;
   case kEtThetaPhi : neutrino_= new TFitParticleEtThetaPhi   ("Neutrino", "Neutrino", 0, &empty3x3); break;
+  case kEtPhiPz    :
+    {
+      // measured Et and phi of the MET plus unmeasured pz of the neutrino
+      TMatrixD empty2x2(2,2);
+      TFitParticlePz*    pz    = new TFitParticlePz   ("NeutrinoPz", "NeutrinoPz", 0);
+      TFitParticleEtPhi* etPhi = new TFitParticleEtPhi("Neutrino",   "Neutrino",   0, &empty2x2, pz);
+      pz->setEtPhi(etPhi);
+      neutrino_  = etPhi;
+      neutrinoPz_= pz;
+    }
+    break;
   }
 }
 
 void TtSemiLepKinFitter::setupConstraints() 
 {
   massConstr_[kWHadMass      ] = new TFitConstraintM("WMassHad",      "WMassHad",      0, 0, mW_  );
-  massConstr_[kWLepMass      ] = new TFitConstraintM("WMassLep",      "WMassLep",      0, 0, mW_  );
+  if(fixLepton_){
+    // the lepton enters the leptonic mass constraints as fixed 4-vector
+    massConstr_[kWLepMass      ] = new TFitConstraintMFixed("WMassLep",      "WMassLep",      0, 0, mW_  );
+    massConstr_[kTopLepMass    ] = new TFitConstraintMFixed("TopMassLep",    "TopMassLep",    0, 0, mTop_);
+    massConstr_[kEqualTopMasses] = new TFitConstraintMFixed("EqualTopMasses","EqualTopMasses",0, 0,    0.);
+  }
+  else{
+    massConstr_[kWLepMass      ] = new TFitConstraintM("WMassLep",      "WMassLep",      0, 0, mW_  );
+    massConstr_[kTopLepMass    ] = new TFitConstraintM("TopMassLep",    "TopMassLep",    0, 0, mTop_);
+    massConstr_[kEqualTopMasses] = new TFitConstraintM("EqualTopMasses","EqualTopMasses",0, 0,    0.);
+  }
   massConstr_[kTopHadMass    ] = new TFitConstraintM("TopMassHad",    "TopMassHad",    0, 0, mTop_);
-  massConstr_[kTopLepMass    ] = new TFitConstraintM("TopMassLep",    "TopMassLep",    0, 0, mTop_);
   massConstr_[kNeutrinoMass  ] = new TFitConstraintM("NeutrinoMass",  "NeutrinoMass",  0, 0,    0.);
-  massConstr_[kEqualTopMasses] = new TFitConstraintM("EqualTopMasses","EqualTopMasses",0, 0,    0.);
   sumPxConstr_                 = new TFitConstraintEp("SumPx",        "SumPx", 0, TFitConstraintEp::pX, 0.);
   sumPyConstr_                 = new TFitConstraintEp("SumPy",        "SumPy", 0, TFitConstraintEp::pY, 0.);
 
   massConstr_[kWHadMass      ]->addParticles1(hadP_,   hadQ_    );
-  massConstr_[kWLepMass      ]->addParticles1(lepton_, neutrino_);
   massConstr_[kTopHadMass    ]->addParticles1(hadP_, hadQ_, hadB_);
-  massConstr_[kTopLepMass    ]->addParticles1(lepton_, neutrino_, lepB_);
   massConstr_[kNeutrinoMass  ]->addParticle1 (neutrino_);
   massConstr_[kEqualTopMasses]->addParticles1(hadP_, hadQ_, hadB_);
-  massConstr_[kEqualTopMasses]->addParticles2(lepton_, neutrino_, lepB_);
-  sumPxConstr_->addParticles(lepton_, neutrino_, hadP_, hadQ_, hadB_, lepB_);
-  sumPyConstr_->addParticles(lepton_, neutrino_, hadP_, hadQ_, hadB_, lepB_);
+  if(fixLepton_){
+    massConstr_[kWLepMass      ]->addParticle1 (neutrino_);
+    massConstr_[kTopLepMass    ]->addParticles1(neutrino_, lepB_);
+    massConstr_[kEqualTopMasses]->addParticles2(neutrino_, lepB_);
+  }
+  else{
+    massConstr_[kWLepMass      ]->addParticles1(lepton_, neutrino_);
+    massConstr_[kTopLepMass    ]->addParticles1(lepton_, neutrino_, lepB_);
+    massConstr_[kEqualTopMasses]->addParticles2(lepton_, neutrino_, lepB_);
+  }
+  if(neutrinoPz_){
+    // the neutrino pz has to enter all mass constraints the neutrino enters
+    massConstr_[kWLepMass      ]->addParticle1 (neutrinoPz_);
+    massConstr_[kTopLepMass    ]->addParticle1 (neutrinoPz_);
+    massConstr_[kEqualTopMasses]->addParticle2 (neutrinoPz_);
+  }
+  sumPxConstr_->addParticles(neutrino_, hadP_, hadQ_, hadB_, lepB_);
+  sumPyConstr_->addParticles(neutrino_, hadP_, hadQ_, hadB_, lepB_);
+  if(!fixLepton_){
+    sumPxConstr_->addParticle(lepton_);
+    sumPyConstr_->addParticle(lepton_);
+  }
 
   if(std::find(constrList_.begin(), constrList_.end(), kSumPt)!=constrList_.end())
     constrainSumPt_ = true;
@@ -155,6 +200,19 @@ void TtSemiLepKinFitter::setupFitter()
 {
   printSetup();
 
+  // the reduced Et/phi parametrisation only describes the neutrino
+  if(jetParam_==kEtPhiPz || lepParam_==kEtPhiPz)
+    throw edm::Exception( edm::errors::Configuration, "The parametrisation EtPhiPz is only supported for the MET" );
+  if(metParam_==kEtPhiPz){
+    // the neutrino is massless by construction and its pz has to be fixed by a mass constraint
+    if(std::find(constrList_.begin(), constrList_.end(), kNeutrinoMass)!=constrList_.end())
+      throw edm::Exception( edm::errors::Configuration, "The neutrino mass constraint cannot be used with the MET parametrisation EtPhiPz" );
+    if(std::find(constrList_.begin(), constrList_.end(), kWLepMass     )==constrList_.end() &&
+       std::find(constrList_.begin(), constrList_.end(), kTopLepMass   )==constrList_.end() &&
+       std::find(constrList_.begin(), constrList_.end(), kEqualTopMasses)==constrList_.end())
+      throw edm::Exception( edm::errors::Configuration, "The MET parametrisation EtPhiPz requires a leptonic W-mass, leptonic t-mass or equal t-masses constraint" );
+  }
+
   setupJets();
   setupLeptons();
   setupConstraints();
@@ -164,8 +222,12 @@ void TtSemiLepKinFitter::setupFitter()
   fitter_->addMeasParticle(hadP_);
   fitter_->addMeasParticle(hadQ_);
   fitter_->addMeasParticle(lepB_);
-  fitter_->addMeasParticle(lepton_);
+  if(!fixLepton_)
+    fitter_->addMeasParticle(lepton_);
   fitter_->addMeasParticle(neutrino_);
+  // add unmeasured particles
+  if(neutrinoPz_)
+    fitter_->addUnmeasParticle(neutrinoPz_);
 
   // add constraints
   for(unsigned int i=0; i<constrList_.size(); i++){
@@ -212,27 +274,41 @@ int TtSemiLepKinFitter::fit(const TLorentzVector& p4HadP, const TLorentzVector&
   hadQ_->setIni4Vec( &p4HadQ );
   hadB_->setIni4Vec( &p4HadB );
   lepB_->setIni4Vec( &p4LepB );
-  lepton_->setIni4Vec( &p4Lepton );
+  if(!fixLepton_)
+    lepton_->setIni4Vec( &p4Lepton );
+  // the neutrino pz has to be set before the Et/phi part, which needs it for the energy
+  if(neutrinoPz_)
+    neutrinoPz_->setIni4Vec( &p4Neutrino );
   neutrino_->setIni4Vec( &p4Neutrino );
 
   hadP_->setCovMatrix( &covHadP );
   hadQ_->setCovMatrix( &covHadQ );
   hadB_->setCovMatrix( &covHadB );
   lepB_->setCovMatrix( &covLepB );
-  lepton_  ->setCovMatrix( &covLepton   );
+  if(!fixLepton_)
+    lepton_->setCovMatrix( &covLepton );
+  else{
+    // pass the lepton as fixed 4-vector to the leptonic mass constraints
+    static_cast<TFitConstraintMFixed*>(massConstr_[kWLepMass      ])->setFixed1( p4Lepton );
+    static_cast<TFitConstraintMFixed*>(massConstr_[kTopLepMass    ])->setFixed1( p4Lepton );
+    static_cast<TFitConstraintMFixed*>(massConstr_[kEqualTopMasses])->setFixed2( p4Lepton );
+  }
   neutrino_->setCovMatrix( &covNeutrino );
 
   if(constrainSumPt_){
     // setup Px and Py constraint for curent event configuration so that sum Pt will be conserved
-    sumPxConstr_->setConstraint( p4HadP.Px() + p4HadQ.Px() + p4HadB.Px() + p4LepB.Px() + p4Lepton.Px() + p4Neutrino.Px() );
-    sumPyConstr_->setConstraint( p4HadP.Py() + p4HadQ.Py() + p4HadB.Py() + p4LepB.Py() + p4Lepton.Py() + p4Neutrino.Py() );
+    // (a fixed lepton does not enter the sum, as its momentum cannot change)
+    const double lepPx = (fixLepton_ ? 0. : p4Lepton.Px());
+    const double lepPy = (fixLepton_ ? 0. : p4Lepton.Py());
+    sumPxConstr_->setConstraint( p4HadP.Px() + p4HadQ.Px() + p4HadB.Px() + p4LepB.Px() + lepPx + p4Neutrino.Px() );
+    sumPyConstr_->setConstraint( p4HadP.Py() + p4HadQ.Py() + p4HadB.Py() + p4LepB.Py() + lepPy + p4Neutrino.Py() );
   }
 
   // now do the fit
-  fitter_->fit();
+  runFit();
 
-  // read back the resulting particles if the fit converged
-  if(fitter_->getStatus()==0){
+  // read back the resulting particles if the fit yields a result
+  if(hasFitResult()){
     // read back jet kinematics
     fittedHadP_= pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(hadP_->getCurr4Vec()->X(),
 			       hadP_->getCurr4Vec()->Y(), hadP_->getCurr4Vec()->Z(), hadP_->getCurr4Vec()->E()), math::XYZPoint()));
@@ -243,18 +319,37 @@ int TtSemiLepKinFitter::fit(const TLorentzVector& p4HadP, const TLorentzVector&
     fittedLepB_= pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(lepB_->getCurr4Vec()->X(),
 			       lepB_->getCurr4Vec()->Y(), lepB_->getCurr4Vec()->Z(), lepB_->getCurr4Vec()->E()), math::XYZPoint()));
 
-    // read back lepton kinematics
-    fittedLepton_= pat::Particle(reco::LeafCandidate(leptonCharge, math::XYZTLorentzVector(lepton_->getCurr4Vec()->X(),
-				 lepton_->getCurr4Vec()->Y(), lepton_->getCurr4Vec()->Z(), lepton_->getCurr4Vec()->E()), math::XYZPoint()));
+    // read back lepton kinematics (unchanged input if the lepton is kept fixed)
+    const TLorentzVector& p4FitLepton = (fixLepton_ ? p4Lepton : *lepton_->getCurr4Vec());
+    fittedLepton_= pat::Particle(reco::LeafCandidate(leptonCharge, math::XYZTLorentzVector(p4FitLepton.X(),
+				 p4FitLepton.Y(), p4FitLepton.Z(), p4FitLepton.E()), math::XYZPoint()));
 
-    // read back the MET kinematics
-    fittedNeutrino_= pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(neutrino_->getCurr4Vec()->X(),
-				   neutrino_->getCurr4Vec()->Y(), neutrino_->getCurr4Vec()->Z(), neutrino_->getCurr4Vec()->E()), math::XYZPoint()));
+    // read back the MET kinematics (adding the fitted pz for the EtPhiPz parametrisation)
+    TLorentzVector p4FitNeutrino(*neutrino_->getCurr4Vec());
+    if(neutrinoPz_){
+      p4FitNeutrino.SetPz(neutrinoPz_->getCurr4Vec()->Z());
+      p4FitNeutrino.SetE (p4FitNeutrino.P());
+    }
+    fittedNeutrino_= pat::Particle(reco::LeafCandidate(0, math::XYZTLorentzVector(p4FitNeutrino.X(),
+				   p4FitNeutrino.Y(), p4FitNeutrino.Z(), p4FitNeutrino.E()), math::XYZPoint()));
 
   }
   return fitter_->getStatus();
 }
 
+void TtSemiLepKinFitter::embedFitResolutions()
+{
+  if(!hasFitResult()) return;
+  embedCovMatrixFit(fittedHadP_, hadP_, jetParam_, true);
+  embedCovMatrixFit(fittedHadQ_, hadQ_, jetParam_, true);
+  embedCovMatrixFit(fittedHadB_, hadB_, jetParam_, true);
+  embedCovMatrixFit(fittedLepB_, lepB_, jetParam_, true);
+  // a fixed lepton has not been fitted
+  if(!fixLepton_)
+    embedCovMatrixFit(fittedLepton_, lepton_, lepParam_, false);
+  embedCovMatrixFit(fittedNeutrino_, neutrino_, metParam_, false);
+}
+
 TtSemiEvtSolution TtSemiLepKinFitter::addKinFitInfo(TtSemiEvtSolution* asol) 
 {
 
@@ -0,0 +1,12 @@
+#include "DataFormats/Common/interface/Wrapper.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitResults.h"
+#include "TopQuarkAnalysis/TopKinFitter/interface/TopKinFitPulls.h"
+
+namespace {
+  struct dictionary {
+    TopKinFitResults results;
+    edm::Wrapper<TopKinFitResults> w_results;
+    TopKinFitPulls pulls;
+    edm::Wrapper<TopKinFitPulls> w_pulls;
+  };
+}
@@ -0,0 +1,227 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <set>
+#include <vector>
+#include <algorithm>
+
+#include "TopQuarkAnalysis/TopKinFitter/interface/JetCombinationGenerator.h"
+
+/*
+  Unit test of the JetCombinationGenerator: the assignments have to come in the order of the
+  former next_combination/next_permutation loop with the symmetry cuts applied, the linear
+  index has to give the same assignments with and without the tabulated jet subsets, and the
+  b-tagging has to select the same assignments as filtering them afterwards.
+*/
+
+class testJetCombinationGenerator : public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE(testJetCombinationGenerator);
+  CPPUNIT_TEST(testOrder);
+  CPPUNIT_TEST(testIndex);
+  CPPUNIT_TEST(testBTagging);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){};
+  void tearDown(){};
+
+  /// same sequence as the loop over jet subsets and their permutations
+  void testOrder();
+  /// next() agrees with combination(i) for all i, also beyond the tabulated jet counts
+  void testIndex();
+  /// restricting by the b-tagging gives the assignments that pass accept()
+  void testBTagging();
+
+ private:
+  template <class Topology>
+  void checkOrder(const std::vector<int>& jets);
+  template <class Topology>
+  void checkIndex(const std::vector<int>& jets);
+  template <class Topology>
+  void checkBTagging(const std::vector<int>& jets, const std::vector<bool>& bTagged, const std::vector<bool>& light, const unsigned int minTaggedB);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(testJetCombinationGenerator);
+
+namespace {
+
+  /// jet indices 0..n-1, or with every third index left out (the generator takes any increasing indices)
+  std::vector<int> jetIndices(const unsigned int n, const bool gaps)
+  {
+    std::vector<int> jets;
+    for(int i=0; jets.size()<n; ++i)
+      if(!gaps || i%3!=2) jets.push_back(i);
+    return jets;
+  }
+
+  /// advance to the next subset of the jets in lexicographical order (as stdcomb::next_combination)
+  bool nextSubset(const unsigned int n, std::vector<unsigned int>& positions)
+  {
+    const unsigned int k = positions.size();
+    int i = k-1;
+    while(i>=0 && positions[i]==n-k+i) --i;
+    if(i<0) return false;
+    ++positions[i];
+    for(unsigned int j=i+1; j<k; ++j)
+      positions[j] = positions[j-1]+1;
+    return true;
+  }
+
+  /// the former enumeration: jet subsets in lexicographical order, each with all
+  /// its permutations, skipping those with a swapped pair of indistinguishable partons
+  template <class Topology>
+  std::vector<std::vector<int> > formerLoop(const std::vector<int>& jets)
+  {
+    std::vector<std::vector<int> > result;
+    if(jets.size()<Topology::nPartons) return result;
+    std::vector<unsigned int> positions(Topology::nPartons);
+    for(unsigned int i=0; i<positions.size(); ++i)
+      positions[i] = i;
+    do{
+      std::vector<int> combi;
+      for(unsigned int i=0; i<positions.size(); ++i)
+	combi.push_back(jets[positions[i]]);
+      do{
+	bool swapped = false;
+	for(unsigned int i=0; i<Topology::nSymmetries; ++i)
+	  if(combi[Topology::symmetry(i,0)]>combi[Topology::symmetry(i,1)]) swapped = true;
+	if(!swapped) result.push_back(combi);
+      }
+      while(std::next_permutation(combi.begin(), combi.end()));
+    }
+    while(nextSubset(jets.size(), positions));
+    return result;
+  }
+
+  /// all assignments from next()
+  template <class Generator>
+  std::vector<std::vector<int> > generate(Generator& generator)
+  {
+    std::vector<std::vector<int> > result;
+    std::vector<int> combi;
+    while(generator.next(combi)) result.push_back(combi);
+    return result;
+  }
+
+  /// reproducible b-tagging flags: each jet is b-tagged, light, both or neither
+  void flags(const unsigned int n, const unsigned int seed, std::vector<bool>& bTagged, std::vector<bool>& light)
+  {
+    bTagged.clear();
+    light.clear();
+    unsigned int state = seed+1;
+    for(unsigned int i=0; i<n; ++i){
+      state = 1103515245*state+12345;
+      const unsigned int type = (state>>16)%4;
+      bTagged.push_back(type==0 || type==2);
+      light  .push_back(type==1 || type==2);
+    }
+  }
+}
+
+template <class Topology>
+void
+testJetCombinationGenerator::checkOrder(const std::vector<int>& jets)
+{
+  JetCombinationGenerator<Topology> generator(jets);
+  const std::vector<std::vector<int> > expected = formerLoop<Topology>(jets);
+  CPPUNIT_ASSERT(generate(generator)==expected);
+  CPPUNIT_ASSERT(generator.size()==expected.size());
+}
+
+template <class Topology>
+void
+testJetCombinationGenerator::checkIndex(const std::vector<int>& jets)
+{
+  // the default generator uses the tables up to 12 jets, the second one unranks the
+  // jet subsets beyond 4 jets; both have to give the same sequence as next()
+  JetCombinationGenerator<Topology> tabulated(jets);
+  JetCombinationGenerator<Topology, 4> unranked(jets);
+  const std::vector<std::vector<int> > sequence = generate(tabulated);
+  CPPUNIT_ASSERT(sequence.size()==tabulated.size());
+  CPPUNIT_ASSERT(unranked.size()==tabulated.size());
+  CPPUNIT_ASSERT(generate(unranked)==sequence);
+  std::vector<int> combi;
+  for(unsigned long i=0; i<tabulated.size(); ++i){
+    CPPUNIT_ASSERT(tabulated.combination(i, combi));
+    CPPUNIT_ASSERT(combi==sequence[i]);
+    CPPUNIT_ASSERT(unranked.combination(i, combi));
+    CPPUNIT_ASSERT(combi==sequence[i]);
+  }
+}
+
+template <class Topology>
+void
+testJetCombinationGenerator::checkBTagging(const std::vector<int>& jets, const std::vector<bool>& bTagged, const std::vector<bool>& light, const unsigned int minTaggedB)
+{
+  JetCombinationGenerator<Topology> all(jets);
+  JetCombinationGenerator<Topology> tagged(jets);
+  JetCombinationGenerator<Topology, 4> unranked(jets);
+  tagged  .setBTagging(bTagged, light, minTaggedB);
+  unranked.setBTagging(bTagged, light, minTaggedB);
+
+  // next() skips the infeasible jet subsets as a whole, which must not change the result
+  std::vector<std::vector<int> > expected;
+  std::vector<int> combi;
+  while(all.next(combi))
+    if(tagged.accept(combi)) expected.push_back(combi);
+  CPPUNIT_ASSERT(generate(tagged)==expected);
+  CPPUNIT_ASSERT(generate(unranked)==expected);
+
+  // combination(i) flags the same assignments as compatible
+  std::vector<std::vector<int> > indexed;
+  for(unsigned long i=0; i<tagged.size(); ++i)
+    if(tagged.combination(i, combi)) indexed.push_back(combi);
+  CPPUNIT_ASSERT(indexed==expected);
+
+  // and the beam search without truncation finds the same set
+  std::vector<std::vector<int> > beam;
+  struct Flat { double operator()(const std::vector<int>&) const { return 0.; } };
+  CPPUNIT_ASSERT(tagged.beamSearch(all.size()+1, Flat(), beam));
+  CPPUNIT_ASSERT(std::set<std::vector<int> >(beam.begin(), beam.end())==std::set<std::vector<int> >(expected.begin(), expected.end()));
+}
+
+void
+testJetCombinationGenerator::testOrder()
+{
+  for(unsigned int gaps=0; gaps<2; ++gaps){
+    for(unsigned int n=0; n<=10; ++n){
+      checkOrder<TtSemiLepTopology>(jetIndices(n, gaps));
+      checkOrder<TtFullLepTopology>(jetIndices(n, gaps));
+    }
+    for(unsigned int n=0; n<=9; ++n)
+      checkOrder<TtFullHadTopology>(jetIndices(n, gaps));
+  }
+}
+
+void
+testJetCombinationGenerator::testIndex()
+{
+  for(unsigned int gaps=0; gaps<2; ++gaps){
+    for(unsigned int n=0; n<=14; ++n){
+      checkIndex<TtSemiLepTopology>(jetIndices(n, gaps));
+      checkIndex<TtFullLepTopology>(jetIndices(n, gaps));
+    }
+    for(unsigned int n=0; n<=9; ++n)
+      checkIndex<TtFullHadTopology>(jetIndices(n, gaps));
+  }
+}
+
+void
+testJetCombinationGenerator::testBTagging()
+{
+  std::vector<bool> bTagged, light;
+  for(unsigned int seed=0; seed<20; ++seed){
+    for(unsigned int minTaggedB=0; minTaggedB<=2; ++minTaggedB){
+      for(unsigned int n=0; n<=9; ++n){
+	const std::vector<int> jets = jetIndices(n, seed%2);
+	// the flags are indexed by the jet index
+	flags(jets.empty() ? 0 : jets.back()+1, seed, bTagged, light);
+	checkBTagging<TtSemiLepTopology>(jets, bTagged, light, minTaggedB);
+	checkBTagging<TtFullLepTopology>(jets, bTagged, light, minTaggedB);
+	if(n<=8) checkBTagging<TtFullHadTopology>(jets, bTagged, light, minTaggedB);
+      }
+    }
+  }
+}
+
+#include "Utilities/Testing/interface/CppUnit_testdriver.icpp"